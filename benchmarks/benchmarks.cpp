@@ -0,0 +1,365 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include "../lib/b_tree_list.hpp"
+#include "perf_counters.hpp"
+#include "position_generator.hpp"
+
+// All benchmarks use the same seed, so positions do not change between runs.
+constexpr uint64_t benchmark_seed = 20261019;
+
+// Set by --perf_counters flag.
+bool perf_counters_flag = false;
+
+// Trivially copyable element of Size bytes.
+template <size_t Size>
+struct Element {
+  std::array<char, Size> bytes;
+};
+
+enum class Operation {
+  GET,
+  SET,
+  INSERT,
+  EXTRACT,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Containers                                                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+// List is kept in anonymous memory, so file system does not take part.
+template <typename ElementType, size_t T>
+std::unique_ptr<BTreeList<ElementType, T>> MakeContainer(
+    size_t size,
+    BTreeList<ElementType, T>*
+) {
+  auto list = std::make_unique<BTreeList<ElementType, T>>(
+      "benchmark", StorageBackend::ANONYMOUS_MEMORY);
+  for (size_t i = 0; i < size; ++i) {
+    list->PushBack(ElementType{});
+  }
+  return list;
+}
+
+template <typename SequenceType>
+std::unique_ptr<SequenceType> MakeContainer(size_t size, SequenceType*) {
+  return std::make_unique<SequenceType>(size);
+}
+
+template <typename ElementType, size_t T>
+void InsertAt(BTreeList<ElementType, T> &list, size_t pos,
+              const ElementType &e) {
+  list.Insert(pos, e);
+}
+
+template <typename SequenceType>
+void InsertAt(SequenceType &sequence, size_t pos,
+              const typename SequenceType::value_type &e) {
+  sequence.insert(sequence.begin() + pos, e);
+}
+
+template <typename ElementType, size_t T>
+void ExtractAt(BTreeList<ElementType, T> &list, size_t pos) {
+  benchmark::DoNotOptimize(list.Extract(pos));
+}
+
+template <typename SequenceType>
+void ExtractAt(SequenceType &sequence, size_t pos) {
+  sequence.erase(sequence.begin() + pos);
+}
+
+template <typename ContainerType>
+size_t SizeOf(const ContainerType &container) {
+  if constexpr (requires { container.Size(); }) {
+    return container.Size();
+  } else {
+    return container.size();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Latencies                                                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Adds percentiles of per operation latencies to benchmark counters. Each
+ * operation is timed separately, so about 20ns of clock reading are included
+ * in every latency.
+ */
+
+void ReportLatencies(benchmark::State &state, std::vector<double> &latencies) {
+  if (latencies.empty()) {
+    return;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&latencies](double p) {
+    auto index = static_cast<size_t>(p * static_cast<double>(latencies.size()));
+    return latencies[std::min(index, latencies.size() - 1)];
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p999_ns"] = percentile(0.999);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Hardware counters                                                          //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Adds average per operation values of available counters. Counters are
+ * read outside of timed part, so reading does not change latencies, but
+ * counted values include clock reading.
+ */
+
+void ReportPerfValues(benchmark::State &state,
+                      const PerfCounters &perf_counters,
+                      const PerfValues &totals) {
+  for (size_t i = 0; i < perf_counters_cnt; ++i) {
+    if (perf_counters.IsAvailable(static_cast<PerfCounter>(i))) {
+      state.counters[perf_counter_names[i]] = benchmark::Counter(
+          static_cast<double>(totals[i]), benchmark::Counter::kAvgIterations);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark                                                                  //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Arguments: list size and position distribution. Insert is paired with
+ * untimed extract (and the other way round), so list size stays the same.
+ */
+
+template <typename ContainerType, Operation operation>
+void BM_Operation(benchmark::State &state) {
+  using ElementType = std::remove_cvref_t<
+      decltype(std::declval<ContainerType&>()[0])>;
+  auto size = static_cast<size_t>(state.range(0));
+  auto distribution = static_cast<PositionDistribution>(state.range(1));
+  auto container = MakeContainer(size, static_cast<ContainerType*>(nullptr));
+  PositionGenerator positions(distribution, benchmark_seed, size);
+  PositionGenerator restore_positions(PositionDistribution::UNIFORM,
+                                      benchmark_seed + 1, size);
+  std::vector<double> latencies;
+  ElementType element{};
+  std::unique_ptr<PerfCounters> perf_counters;
+  if (perf_counters_flag) {
+    perf_counters = std::make_unique<PerfCounters>();
+  }
+  PerfValues perf_totals{};
+  PerfValues perf_start{};
+
+  for (auto _: state) {
+    size_t pos = positions.Next(SizeOf(*container));
+    if (perf_counters != nullptr) {
+      perf_start = perf_counters->Read();
+    }
+    auto start = std::chrono::steady_clock::now();
+    switch (operation) {
+      case Operation::GET:
+        benchmark::DoNotOptimize(element = (*container)[pos]);
+        break;
+      case Operation::SET:
+        (*container)[pos] = element;
+        break;
+      case Operation::INSERT:
+        InsertAt(*container, pos, element);
+        break;
+      case Operation::EXTRACT:
+        ExtractAt(*container, pos);
+        break;
+    }
+    auto finish = std::chrono::steady_clock::now();
+    if (perf_counters != nullptr) {
+      PerfValues perf_finish = perf_counters->Read();
+      for (size_t i = 0; i < perf_counters_cnt; ++i) {
+        perf_totals[i] += perf_finish[i] - perf_start[i];
+      }
+    }
+    double latency =
+        std::chrono::duration<double, std::nano>(finish - start).count();
+    latencies.push_back(latency);
+    state.SetIterationTime(latency * 1e-9);
+
+    if (operation == Operation::INSERT) {
+      ExtractAt(*container,
+                restore_positions.Next(SizeOf(*container)));
+    } else if (operation == Operation::EXTRACT) {
+      InsertAt(*container,
+               restore_positions.Next(SizeOf(*container) + 1), element);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  ReportLatencies(state, latencies);
+  if (perf_counters != nullptr) {
+    ReportPerfValues(state, *perf_counters, perf_totals);
+  }
+}
+
+/*
+ * Arguments: list size and flag of GetMany use. Each iteration looks up
+ * lookups_cnt uniform positions either by one GetMany call or by a loop over
+ * operator[].
+ */
+
+template <typename ListType, bool get_many_flag>
+void BM_Lookups(benchmark::State &state) {
+  constexpr size_t lookups_cnt = 1 << 12;
+  using ElementType = std::remove_cvref_t<
+      decltype(std::declval<ListType&>()[0])>;
+  auto size = static_cast<size_t>(state.range(0));
+  auto list = MakeContainer(size, static_cast<ListType*>(nullptr));
+  PositionGenerator positions(PositionDistribution::UNIFORM, benchmark_seed,
+                              size);
+  std::vector<size_t> indexes(lookups_cnt);
+  std::vector<ElementType> results(lookups_cnt);
+
+  for (auto _: state) {
+    state.PauseTiming();
+    for (size_t &index: indexes) {
+      index = positions.Next(size);
+    }
+    state.ResumeTiming();
+    if constexpr (get_many_flag) {
+      list->GetMany(indexes, results.begin());
+    } else {
+      for (size_t i = 0; i < lookups_cnt; ++i) {
+        results[i] = (*list)[indexes[i]];
+      }
+    }
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<int64_t>(lookups_cnt));
+}
+
+/*
+ * Arguments: count of appended elements and flag of PushBack use. Each
+ * iteration fills an empty list either by PushBack or by Insert(Size(), e).
+ */
+
+template <typename ListType, bool push_back_flag>
+void BM_Append(benchmark::State &state) {
+  using ElementType = std::remove_cvref_t<
+      decltype(std::declval<ListType&>()[0])>;
+  auto size = static_cast<size_t>(state.range(0));
+  ElementType element{};
+
+  for (auto _: state) {
+    state.PauseTiming();
+    auto list = MakeContainer(0, static_cast<ListType*>(nullptr));
+    state.ResumeTiming();
+    for (size_t i = 0; i < size; ++i) {
+      if constexpr (push_back_flag) {
+        list->PushBack(element);
+      } else {
+        list->Insert(list->Size(), element);
+      }
+    }
+    benchmark::DoNotOptimize(list->Size());
+    state.PauseTiming();
+    list.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(size));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Registration                                                               //
+////////////////////////////////////////////////////////////////////////////////
+
+void ListArguments(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"size", "distribution"});
+  benchmark->ArgsProduct({
+      {1 << 10, 1 << 16, 1 << 20},
+      {static_cast<int64_t>(PositionDistribution::UNIFORM),
+       static_cast<int64_t>(PositionDistribution::ZIPFIAN),
+       static_cast<int64_t>(PositionDistribution::SEQUENTIAL)}
+  });
+  benchmark->UseManualTime();
+}
+
+#define REGISTER_ALL_OPERATIONS(...)                                           \
+  BENCHMARK_TEMPLATE(BM_Operation, __VA_ARGS__, Operation::GET)                \
+      ->Apply(ListArguments);                                                  \
+  BENCHMARK_TEMPLATE(BM_Operation, __VA_ARGS__, Operation::SET)                \
+      ->Apply(ListArguments);                                                  \
+  BENCHMARK_TEMPLATE(BM_Operation, __VA_ARGS__, Operation::INSERT)             \
+      ->Apply(ListArguments);                                                  \
+  BENCHMARK_TEMPLATE(BM_Operation, __VA_ARGS__, Operation::EXTRACT)            \
+      ->Apply(ListArguments)
+
+// Node size.
+REGISTER_ALL_OPERATIONS(BTreeList<Element<8>, 16>);
+REGISTER_ALL_OPERATIONS(BTreeList<Element<8>, 64>);
+REGISTER_ALL_OPERATIONS(BTreeList<Element<8>, 200>);
+// Element size.
+REGISTER_ALL_OPERATIONS(BTreeList<Element<64>, 200>);
+REGISTER_ALL_OPERATIONS(BTreeList<Element<256>, 200>);
+// Baselines.
+REGISTER_ALL_OPERATIONS(std::vector<Element<8>>);
+REGISTER_ALL_OPERATIONS(std::deque<Element<8>>);
+REGISTER_ALL_OPERATIONS(std::vector<Element<64>>);
+REGISTER_ALL_OPERATIONS(std::deque<Element<64>>);
+
+// Batched lookups.
+BENCHMARK_TEMPLATE(BM_Lookups, BTreeList<Element<8>, 200>, false)
+    ->ArgName("size")->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 24);
+BENCHMARK_TEMPLATE(BM_Lookups, BTreeList<Element<8>, 200>, true)
+    ->ArgName("size")->Arg(1 << 16)->Arg(1 << 20)->Arg(1 << 24);
+// Appends.
+BENCHMARK_TEMPLATE(BM_Append, BTreeList<Element<8>, 200>, true)
+    ->ArgName("size")->Arg(1 << 16)->Arg(1 << 20)->Arg(5'000'000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Append, BTreeList<Element<8>, 200>, false)
+    ->ArgName("size")->Arg(1 << 16)->Arg(1 << 20)->Arg(5'000'000)
+    ->Unit(benchmark::kMillisecond);
+
+/*
+ * --perf_counters is taken out of arguments, the rest are Google Benchmark
+ * flags. Results with counters are exported by --benchmark_out=PATH
+ * --benchmark_out_format=json (or csv).
+ */
+
+int main(int argc, char** argv) {
+  std::vector<char*> args;
+  for (int i = 0; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--perf_counters") == 0 ||
+        std::strcmp(argv[i], "--perf_counters=1") == 0) {
+      perf_counters_flag = true;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  auto args_cnt = static_cast<int>(args.size());
+  args.push_back(nullptr);
+  benchmark::Initialize(&args_cnt, args.data());
+  if (benchmark::ReportUnrecognizedArguments(args_cnt, args.data())) {
+    return 1;
+  }
+  if (perf_counters_flag) {
+    PerfCounters probe;
+    for (size_t i = 0; i < perf_counters_cnt; ++i) {
+      if (!probe.IsAvailable(static_cast<PerfCounter>(i))) {
+        std::cerr << "perf counter " << perf_counter_names[i]
+                  << " is not available and is not reported\n";
+      }
+    }
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,173 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_BENCHMARKS__PERF_COUNTERS_HPP_
+#define B_TREE_LIST_BENCHMARKS__PERF_COUNTERS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum class PerfCounter {
+  CYCLES,
+  INSTRUCTIONS,
+  LLC_MISSES,
+  DTLB_MISSES,
+  PAGE_FAULTS,
+};
+
+constexpr size_t perf_counters_cnt = 5;
+
+const std::array<const char*, perf_counters_cnt> perf_counter_names{
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "page_faults"
+};
+
+using PerfValues = std::array<uint64_t, perf_counters_cnt>;
+
+// User space hardware and software counters of calling thread, opened as one
+// perf_event_open group, so all of them are read by one system call.
+// Counters which can not be opened (no PMU in virtual machine, restrictive
+// perf_event_paranoid, unknown event) are skipped and read as zero.
+class PerfCounters {
+ public:
+  PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  ~PerfCounters();
+
+  [[nodiscard]] bool IsAvailable(PerfCounter counter) const;
+
+  [[nodiscard]] bool IsAnyAvailable() const;
+
+  // Values counted since opening.
+  [[nodiscard]] PerfValues Read() const;
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Opens counter in group of _leader_fd (or as leader). Returns -1 on fail.
+  int _Open(uint32_t type, uint64_t config);
+
+  static uint64_t _CacheMissConfig(uint64_t cache);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  int _leader_fd;
+  std::array<int, perf_counters_cnt> _fds;
+  // Position of counter value in group read, for opened counters.
+  std::array<size_t, perf_counters_cnt> _group_indexes;
+  size_t _group_size;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Last level cache misses are taken from generic cache events, or from
+ * generic hardware cache misses if the former are not supported.
+ */
+
+inline PerfCounters::PerfCounters()
+    : _leader_fd(-1),
+      _group_indexes{},
+      _group_size(0) {
+  _fds.fill(-1);
+  _fds[static_cast<size_t>(PerfCounter::CYCLES)] =
+      _Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  _fds[static_cast<size_t>(PerfCounter::INSTRUCTIONS)] =
+      _Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  int llc_fd = _Open(PERF_TYPE_HW_CACHE,
+                     _CacheMissConfig(PERF_COUNT_HW_CACHE_LL));
+  if (llc_fd == -1) {
+    llc_fd = _Open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  }
+  _fds[static_cast<size_t>(PerfCounter::LLC_MISSES)] = llc_fd;
+  _fds[static_cast<size_t>(PerfCounter::DTLB_MISSES)] =
+      _Open(PERF_TYPE_HW_CACHE, _CacheMissConfig(PERF_COUNT_HW_CACHE_DTLB));
+  _fds[static_cast<size_t>(PerfCounter::PAGE_FAULTS)] =
+      _Open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+  size_t group_index = 0;
+  for (size_t i = 0; i < perf_counters_cnt; ++i) {
+    if (_fds[i] != -1) {
+      _group_indexes[i] = group_index++;
+    }
+  }
+}
+
+inline PerfCounters::~PerfCounters() {
+  for (int fd: _fds) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+inline bool PerfCounters::IsAvailable(PerfCounter counter) const {
+  return _fds[static_cast<size_t>(counter)] != -1;
+}
+
+inline bool PerfCounters::IsAnyAvailable() const {
+  return _leader_fd != -1;
+}
+
+/*
+ * Group read format is number of counters followed by their values in order
+ * of opening.
+ */
+
+inline PerfValues PerfCounters::Read() const {
+  PerfValues values{};
+  if (_leader_fd == -1) {
+    return values;
+  }
+  std::vector<uint64_t> buffer(_group_size + 1);
+  auto bytes_cnt = static_cast<ssize_t>(buffer.size() * sizeof(uint64_t));
+  if (read(_leader_fd, buffer.data(), bytes_cnt) != bytes_cnt) {
+    return values;
+  }
+  for (size_t i = 0; i < perf_counters_cnt; ++i) {
+    if (_fds[i] != -1) {
+      values[i] = buffer[_group_indexes[i] + 1];
+    }
+  }
+  return values;
+}
+
+inline int PerfCounters::_Open(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr{};
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1,
+                                     _leader_fd, 0));
+  if (fd == -1) {
+    return -1;
+  }
+  if (_leader_fd == -1) {
+    _leader_fd = fd;
+  }
+  ++_group_size;
+  return fd;
+}
+
+inline uint64_t PerfCounters::_CacheMissConfig(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+#endif //B_TREE_LIST_BENCHMARKS__PERF_COUNTERS_HPP_
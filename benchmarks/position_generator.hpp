@@ -0,0 +1,143 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_BENCHMARKS__POSITION_GENERATOR_HPP_
+#define B_TREE_LIST_BENCHMARKS__POSITION_GENERATOR_HPP_
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// How positions of operations are spread over the list.
+enum class PositionDistribution {
+  UNIFORM,     // Every position is equally likely.
+  ZIPFIAN,     // Few positions are hot, hot positions are scattered over list.
+  SEQUENTIAL,  // 0, 1, 2, ... wrapping around at list size.
+  HOT_HEAD,    // Zipfian by distance from the first position.
+  HOT_TAIL,    // Zipfian by distance from the last position.
+};
+
+// Generates positions of operations. The same seed gives the same sequence,
+// so runs of different builds are comparable.
+class PositionGenerator {
+ public:
+  // items_cnt is number of distinct ranks of zipfian distribution, usually
+  // initial list size.
+  PositionGenerator(PositionDistribution distribution,
+                    uint64_t seed,
+                    size_t items_cnt,
+                    double zipf_theta = 0.99);
+
+  // Next position in [0, size).
+  size_t Next(size_t size);
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Zipfian rank in [0, _items_cnt), 0 is the most popular.
+  size_t _NextZipfRank();
+
+  static double _Zeta(size_t items_cnt, double theta);
+
+  static uint64_t _Scramble(uint64_t value);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  PositionDistribution _distribution;
+  std::mt19937_64 _engine;
+  std::uniform_real_distribution<double> _uniform;
+  size_t _items_cnt;
+  size_t _sequential_pos;
+
+  // Constants of zipfian generator by Gray et al. "Quickly generating
+  // billion-record synthetic databases".
+  double _theta;
+  double _zeta_n;
+  double _alpha;
+  double _eta;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+inline PositionGenerator::PositionGenerator(PositionDistribution distribution,
+                                            uint64_t seed,
+                                            size_t items_cnt,
+                                            double zipf_theta)
+    : _distribution(distribution),
+      _engine(seed),
+      _uniform(0., 1.),
+      _items_cnt(items_cnt == 0 ? 1 : items_cnt),
+      _sequential_pos(0),
+      _theta(zipf_theta),
+      _zeta_n(0.),
+      _alpha(1. / (1. - zipf_theta)),
+      _eta(0.) {
+  if (_distribution == PositionDistribution::ZIPFIAN ||
+      _distribution == PositionDistribution::HOT_HEAD ||
+      _distribution == PositionDistribution::HOT_TAIL) {
+    _zeta_n = _Zeta(_items_cnt, _theta);
+    _eta = (1. - std::pow(2. / static_cast<double>(_items_cnt), 1. - _theta)) /
+           (1. - _Zeta(2, _theta) / _zeta_n);
+  }
+}
+
+inline size_t PositionGenerator::Next(size_t size) {
+  switch (_distribution) {
+    case PositionDistribution::UNIFORM:
+      return _engine() % size;
+    case PositionDistribution::ZIPFIAN:
+      return _Scramble(_NextZipfRank()) % size;
+    case PositionDistribution::SEQUENTIAL:
+      return _sequential_pos++ % size;
+    case PositionDistribution::HOT_HEAD:
+      return _NextZipfRank() % size;
+    case PositionDistribution::HOT_TAIL:
+      return size - 1 - _NextZipfRank() % size;
+  }
+  return 0;
+}
+
+inline size_t PositionGenerator::_NextZipfRank() {
+  double u = _uniform(_engine);
+  double uz = u * _zeta_n;
+  if (uz < 1.) {
+    return 0;
+  }
+  if (uz < 1. + std::pow(0.5, _theta)) {
+    return 1;
+  }
+  auto rank = static_cast<size_t>(static_cast<double>(_items_cnt) *
+                                  std::pow(_eta * u - _eta + 1., _alpha));
+  return rank < _items_cnt ? rank : _items_cnt - 1;
+}
+
+inline double PositionGenerator::_Zeta(size_t items_cnt, double theta) {
+  double sum = 0.;
+  for (size_t i = 1; i <= items_cnt; ++i) {
+    sum += 1. / std::pow(static_cast<double>(i), theta);
+  }
+  return sum;
+}
+
+/*
+ * FNV-1a of rank, so hot ranks do not form one contiguous block of positions.
+ */
+
+inline uint64_t PositionGenerator::_Scramble(uint64_t value) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; ++i) {
+    hash ^= value & 0xff;
+    hash *= 0x100000001b3ULL;
+    value >>= 8;
+  }
+  return hash;
+}
+
+#endif //B_TREE_LIST_BENCHMARKS__POSITION_GENERATOR_HPP_
@@ -0,0 +1,161 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include "../lib/b_tree_list.hpp"
+#include "../lib/trace_recorder.hpp"
+#include "../tools/list_type_dispatch.hpp"
+
+// Re-executes trace written by BTreeList::StartRecording at full speed.
+//
+// Usage: b_tree_list_trace_replay --trace=PATH [--key=value]...
+//   --file=PATH  replay against existing list file, the file is changed
+//   --size=N     initial size of list in anonymous memory (by default the
+//                smallest size for which every traced position is valid)
+//
+// Element values are not traced, inserted elements are zero. List type is
+// taken from trace header, supported element sizes are 1..256 bytes (powers
+// of two) and T is 3, 64 or 200.
+
+struct ReplayParams {
+  std::string trace;
+  std::string file;
+  bool size_set_flag = false;
+  size_t size = 0;
+};
+
+ReplayParams ParseParams(int argc, char** argv) {
+  ReplayParams params;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq_pos = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq_pos == std::string::npos) {
+      throw std::invalid_argument("expected --key=value, got " + arg);
+    }
+    std::string key = arg.substr(2, eq_pos - 2);
+    std::string value = arg.substr(eq_pos + 1);
+    if (key == "trace") {
+      params.trace = value;
+    } else if (key == "file") {
+      params.file = value;
+    } else if (key == "size") {
+      params.size = std::stoull(value);
+      params.size_set_flag = true;
+    } else {
+      throw std::invalid_argument("unknown parameter " + key);
+    }
+  }
+  if (params.trace.empty()) {
+    throw std::invalid_argument("--trace is required");
+  }
+  return params;
+}
+
+/*
+ * Smallest initial size, such that every operation of trace is inside list.
+ */
+
+size_t MinimalInitialSize(const std::string &trace_path) {
+  TraceReader reader(trace_path);
+  TraceRecord record{};
+  int64_t size_change = 0;
+  int64_t min_size = 0;
+  while (reader.Next(record)) {
+    auto last = static_cast<int64_t>(record.index + record.count);
+    if (record.operation == TraceOperation::INSERT) {
+      min_size = std::max(min_size, static_cast<int64_t>(record.index) -
+                                    size_change);
+      size_change += static_cast<int64_t>(record.count);
+    } else {
+      min_size = std::max(min_size, last - size_change);
+      if (record.operation == TraceOperation::EXTRACT) {
+        size_change -= static_cast<int64_t>(record.count);
+      }
+    }
+  }
+  return static_cast<size_t>(min_size);
+}
+
+template <typename ElementType, size_t T>
+void Replay(const ReplayParams &params) {
+  std::unique_ptr<BTreeList<ElementType, T>> list;
+  if (params.file.empty()) {
+    list = std::make_unique<BTreeList<ElementType, T>>(
+        "trace_replay", StorageBackend::ANONYMOUS_MEMORY);
+    size_t size = params.size_set_flag ? params.size
+                                       : MinimalInitialSize(params.trace);
+    for (size_t i = 0; i < size; ++i) {
+      list->PushBack(ElementType{});
+    }
+  } else {
+    list = std::make_unique<BTreeList<ElementType, T>>(params.file, false);
+  }
+
+  TraceReader reader(params.trace);
+  TraceRecord record{};
+  std::array<size_t, 4> operations_cnts{};
+  size_t skipped_cnt = 0;
+  ElementType element{};
+  auto start = std::chrono::steady_clock::now();
+  while (reader.Next(record)) {
+    size_t size = list->Size();
+    bool insert_flag = record.operation == TraceOperation::INSERT;
+    if (record.index + (insert_flag ? 0 : record.count) > size) {
+      ++skipped_cnt;
+      continue;
+    }
+    for (uint64_t i = 0; i < record.count; ++i) {
+      switch (record.operation) {
+        case TraceOperation::GET:
+          element = (*list)[record.index + i];
+          break;
+        case TraceOperation::SET:
+          list->Set(record.index + i, element);
+          break;
+        case TraceOperation::INSERT:
+          list->Insert(record.index + i, element);
+          break;
+        case TraceOperation::EXTRACT:
+          element = list->Extract(record.index);
+          break;
+      }
+    }
+    operations_cnts[static_cast<size_t>(record.operation)] += record.count;
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+
+  size_t total = 0;
+  const std::array<std::string, 4> names{"get", "set", "insert", "extract"};
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::cout << names[i] << "\t" << operations_cnts[i] << "\n";
+    total += operations_cnts[i];
+  }
+  std::cout << "skipped\t" << skipped_cnt << "\n"
+            << "seconds\t" << seconds << "\n"
+            << "ops_per_s\t" << static_cast<double>(total) / seconds << "\n";
+}
+
+int main(int argc, char** argv) {
+  ReplayParams params = ParseParams(argc, argv);
+  TraceHeader header = TraceReader(params.trace).Header();
+  bool replayed_flag = DispatchListType(
+      header.element_size, header.t,
+      [&params]<typename ListTypeT>(ListTypeT) {
+        Replay<typename ListTypeT::ElementType, ListTypeT::t>(params);
+      });
+  if (!replayed_flag) {
+    std::cerr << "unsupported list type: element size " << header.element_size
+              << ", T " << header.t << "\n";
+    return 1;
+  }
+  return 0;
+}
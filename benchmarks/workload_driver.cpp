@@ -0,0 +1,296 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../lib/b_tree_list.hpp"
+#include "position_generator.hpp"
+
+// Mixed workload over one list from several client threads. Reads and scans
+// take shared lock, changes take exclusive lock, so latencies include waiting
+// for other clients.
+//
+// Usage: b_tree_list_workload [--key=value]...
+//   --size=N          initial list size (1000000)
+//   --ops=N           operations per thread (1000000)
+//   --threads=N       client threads (1)
+//   --get=W --set=W --insert=W --extract=W --scan=W
+//                     operation weights (90 5 2 2 1)
+//   --scan_length=N   elements read by one scan (100)
+//   --distribution=uniform|zipfian|sequential|hot_head|hot_tail (zipfian)
+//   --theta=X         zipfian skew (0.99)
+//   --seed=N          seed of the first thread, others use seed + i (1)
+//   --file=PATH       keep list in file PATH instead of anonymous memory
+//   --window_ms=N     length of wall time window in report (1000)
+
+enum class ClientOperation {
+  GET,
+  SET,
+  INSERT,
+  EXTRACT,
+  SCAN,
+};
+
+constexpr size_t operations_cnt = 5;
+
+const std::array<std::string, operations_cnt> operation_names{
+    "get", "set", "insert", "extract", "scan"
+};
+
+struct WorkloadParams {
+  size_t size = 1000000;
+  size_t ops = 1000000;
+  size_t threads = 1;
+  std::array<double, operations_cnt> weights{90., 5., 2., 2., 1.};
+  size_t scan_length = 100;
+  PositionDistribution distribution = PositionDistribution::ZIPFIAN;
+  double theta = 0.99;
+  uint64_t seed = 1;
+  std::string file;
+  uint64_t window_ms = 1000;
+};
+
+// Finished operation as seen by client.
+struct OperationRecord {
+  ClientOperation operation;
+  uint64_t finish_ns;  // From workload start.
+  uint64_t latency_ns;
+};
+
+using List = BTreeList<uint64_t, 200>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Parameters                                                                 //
+////////////////////////////////////////////////////////////////////////////////
+
+PositionDistribution ParseDistribution(const std::string &name) {
+  const std::map<std::string, PositionDistribution> distributions{
+      {"uniform", PositionDistribution::UNIFORM},
+      {"zipfian", PositionDistribution::ZIPFIAN},
+      {"sequential", PositionDistribution::SEQUENTIAL},
+      {"hot_head", PositionDistribution::HOT_HEAD},
+      {"hot_tail", PositionDistribution::HOT_TAIL},
+  };
+  auto it = distributions.find(name);
+  if (it == distributions.end()) {
+    throw std::invalid_argument("unknown distribution " + name);
+  }
+  return it->second;
+}
+
+WorkloadParams ParseParams(int argc, char** argv) {
+  WorkloadParams params;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq_pos = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq_pos == std::string::npos) {
+      throw std::invalid_argument("expected --key=value, got " + arg);
+    }
+    std::string key = arg.substr(2, eq_pos - 2);
+    std::string value = arg.substr(eq_pos + 1);
+    auto weight_it = std::find(operation_names.begin(), operation_names.end(),
+                               key);
+    if (weight_it != operation_names.end()) {
+      params.weights[weight_it - operation_names.begin()] = std::stod(value);
+    } else if (key == "size") {
+      params.size = std::stoull(value);
+    } else if (key == "ops") {
+      params.ops = std::stoull(value);
+    } else if (key == "threads") {
+      params.threads = std::max<size_t>(1, std::stoull(value));
+    } else if (key == "scan_length") {
+      params.scan_length = std::stoull(value);
+    } else if (key == "distribution") {
+      params.distribution = ParseDistribution(value);
+    } else if (key == "theta") {
+      params.theta = std::stod(value);
+    } else if (key == "seed") {
+      params.seed = std::stoull(value);
+    } else if (key == "file") {
+      params.file = value;
+    } else if (key == "window_ms") {
+      params.window_ms = std::max<uint64_t>(1, std::stoull(value));
+    } else {
+      throw std::invalid_argument("unknown parameter " + key);
+    }
+  }
+  return params;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Clients                                                                    //
+////////////////////////////////////////////////////////////////////////////////
+
+void RunClient(List &list,
+               std::shared_mutex &list_mutex,
+               const WorkloadParams &params,
+               size_t client_index,
+               std::chrono::steady_clock::time_point workload_start,
+               std::vector<OperationRecord> &records) {
+  PositionGenerator positions(params.distribution,
+                              params.seed + client_index,
+                              params.size,
+                              params.theta);
+  std::mt19937_64 engine(params.seed + client_index);
+  std::discrete_distribution<size_t> operations(params.weights.begin(),
+                                                params.weights.end());
+  std::vector<size_t> scan_indexes(params.scan_length);
+  std::vector<uint64_t> scanned(params.scan_length);
+  records.reserve(params.ops);
+
+  for (size_t i = 0; i < params.ops; ++i) {
+    auto operation = static_cast<ClientOperation>(operations(engine));
+    auto start = std::chrono::steady_clock::now();
+    if (operation == ClientOperation::GET ||
+        operation == ClientOperation::SCAN) {
+      // Readers share lock, so they use only constant methods.
+      std::shared_lock lock(list_mutex);
+      const List &const_list = list;
+      size_t size = const_list.Size();
+      if (size != 0) {
+        size_t pos = positions.Next(size);
+        if (operation == ClientOperation::GET) {
+          volatile uint64_t element = const_list[pos];
+          (void)element;
+        } else {
+          size_t scan_length = std::min(params.scan_length, size - pos);
+          std::iota(scan_indexes.begin(),
+                    scan_indexes.begin() + scan_length, pos);
+          const_list.GetSorted(
+              std::span<const size_t>(scan_indexes.data(), scan_length),
+              scanned.begin());
+        }
+      }
+    } else {
+      std::unique_lock lock(list_mutex);
+      size_t size = list.Size();
+      if (operation == ClientOperation::INSERT) {
+        list.Insert(positions.Next(size + 1), i);
+      } else if (size != 0) {
+        size_t pos = positions.Next(size);
+        if (operation == ClientOperation::SET) {
+          list.Set(pos, i);
+        } else {
+          list.Extract(pos);
+        }
+      }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    records.push_back(OperationRecord{
+        operation,
+        static_cast<uint64_t>(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(finish - workload_start).count()),
+        static_cast<uint64_t>(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(finish - start).count())
+    });
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Report                                                                     //
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t Percentile(const std::vector<uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto index = static_cast<size_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void PrintLatencies(const std::string &name,
+                    std::vector<uint64_t> &latencies,
+                    double seconds) {
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << name << "\t" << latencies.size()
+            << "\t" << static_cast<double>(latencies.size()) / seconds
+            << "\t" << Percentile(latencies, 0.5)
+            << "\t" << Percentile(latencies, 0.99)
+            << "\t" << Percentile(latencies, 0.999) << "\n";
+}
+
+/*
+ * Prints totals per operation type and then throughput and latency
+ * percentiles of all operations finished in every wall time window.
+ */
+
+void PrintReport(const WorkloadParams &params,
+                 const std::vector<std::vector<OperationRecord>> &records,
+                 double seconds) {
+  std::array<std::vector<uint64_t>, operations_cnt> per_operation;
+  std::vector<std::vector<uint64_t>> per_window;
+  uint64_t window_ns = params.window_ms * 1000000;
+  for (const auto &client_records: records) {
+    for (const auto &record: client_records) {
+      per_operation[static_cast<size_t>(record.operation)].push_back(
+          record.latency_ns);
+      size_t window = record.finish_ns / window_ns;
+      if (per_window.size() <= window) {
+        per_window.resize(window + 1);
+      }
+      per_window[window].push_back(record.latency_ns);
+    }
+  }
+
+  std::cout << "operation\tcount\tops_per_s\tp50_ns\tp99_ns\tp999_ns\n";
+  std::vector<uint64_t> all;
+  for (size_t i = 0; i < operations_cnt; ++i) {
+    all.insert(all.end(), per_operation[i].begin(), per_operation[i].end());
+    if (!per_operation[i].empty()) {
+      PrintLatencies(operation_names[i], per_operation[i], seconds);
+    }
+  }
+  PrintLatencies("all", all, seconds);
+
+  std::cout << "\nwindow_start_ms\tcount\tops_per_s\tp50_ns\tp99_ns\tp999_ns\n";
+  double window_seconds = static_cast<double>(params.window_ms) / 1000.;
+  for (size_t i = 0; i < per_window.size(); ++i) {
+    PrintLatencies(std::to_string(i * params.window_ms), per_window[i],
+                   window_seconds);
+  }
+}
+
+int main(int argc, char** argv) {
+  WorkloadParams params = ParseParams(argc, argv);
+
+  std::unique_ptr<List> list;
+  if (params.file.empty()) {
+    list = std::make_unique<List>("workload", StorageBackend::ANONYMOUS_MEMORY);
+  } else {
+    list = std::make_unique<List>(params.file, StorageBackend::FILE);
+  }
+  for (size_t i = 0; i < params.size; ++i) {
+    list->PushBack(i);
+  }
+
+  std::shared_mutex list_mutex;
+  std::vector<std::vector<OperationRecord>> records(params.threads);
+  std::vector<std::thread> clients;
+  auto workload_start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < params.threads; ++i) {
+    clients.emplace_back(RunClient, std::ref(*list), std::ref(list_mutex),
+                         std::cref(params), i, workload_start,
+                         std::ref(records[i]));
+  }
+  for (auto &client: clients) {
+    client.join();
+  }
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - workload_start).count();
+
+  PrintReport(params, records, seconds);
+  return 0;
+}
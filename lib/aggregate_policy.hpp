@@ -0,0 +1,115 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__AGGREGATE_POLICY_HPP_
+#define B_TREE_LIST_LIB__AGGREGATE_POLICY_HPP_
+
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+// Aggregate policy is the last template parameter of BTreeList. It describes
+// a monoid over elements, which value is kept for every child subtree in
+// internal nodes next to children counts:
+//   ValueType                 aggregate value (trivially copyable),
+//   Identity()                value of empty range,
+//   FromElement(e)            value of one element,
+//   Combine(left, right)      value of two adjacent ranges, must be
+//                             associative.
+// Default policy keeps nothing and does not change file format.
+
+struct NoAggregatePolicy {
+  struct ValueType {};
+
+  static ValueType Identity() {
+    return {};
+  }
+
+  template <typename ElementType>
+  static ValueType FromElement(const ElementType &) {
+    return {};
+  }
+
+  static ValueType Combine(const ValueType &, const ValueType &) {
+    return {};
+  }
+};
+
+template <typename AggregatePolicy>
+constexpr bool is_aggregated_v =
+    !std::is_same_v<AggregatePolicy, NoAggregatePolicy>;
+
+// Sum of elements. SumType may be wider than ElementType to avoid overflow.
+template <typename ElementType, typename SumType = ElementType>
+struct SumAggregatePolicy {
+  using ValueType = SumType;
+
+  static ValueType Identity() {
+    return ValueType();
+  }
+
+  static ValueType FromElement(const ElementType &e) {
+    return static_cast<ValueType>(e);
+  }
+
+  static ValueType Combine(const ValueType &left, const ValueType &right) {
+    return left + right;
+  }
+};
+
+// Minimum of elements. Empty range has maximum value of ElementType.
+template <typename ElementType>
+struct MinAggregatePolicy {
+  using ValueType = ElementType;
+
+  static ValueType Identity() {
+    return std::numeric_limits<ElementType>::max();
+  }
+
+  static ValueType FromElement(const ElementType &e) {
+    return e;
+  }
+
+  static ValueType Combine(const ValueType &left, const ValueType &right) {
+    return right < left ? right : left;
+  }
+};
+
+// Maximum of elements. Empty range has lowest value of ElementType.
+template <typename ElementType>
+struct MaxAggregatePolicy {
+  using ValueType = ElementType;
+
+  static ValueType Identity() {
+    return std::numeric_limits<ElementType>::lowest();
+  }
+
+  static ValueType FromElement(const ElementType &e) {
+    return e;
+  }
+
+  static ValueType Combine(const ValueType &left, const ValueType &right) {
+    return left < right ? right : left;
+  }
+};
+
+// Number of elements for which default constructed Predicate returns true.
+template <typename ElementType, typename Predicate>
+struct CountIfAggregatePolicy {
+  using ValueType = size_t;
+
+  static ValueType Identity() {
+    return 0;
+  }
+
+  static ValueType FromElement(const ElementType &e) {
+    return Predicate()(e) ? 1 : 0;
+  }
+
+  static ValueType Combine(const ValueType &left, const ValueType &right) {
+    return left + right;
+  }
+};
+
+#endif //B_TREE_LIST_LIB__AGGREGATE_POLICY_HPP_
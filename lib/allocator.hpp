@@ -2,10 +2,17 @@
 // Created by gogagum on 16.07.2020.
 //
 
+#include <bit>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
+#include <stdexcept>
+#include <vector>
+#include <sys/mman.h>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include "data_info.hpp"
 #include "block_rw.hpp"
+#include "stats.hpp"
 
 #ifndef B_TREE_LIST_LIB__ALLOCATOR_HPP_
 #define B_TREE_LIST_LIB__ALLOCATOR_HPP_
@@ -38,8 +45,34 @@ class Allocator{
 
   [[nodiscard]] file_pos_t NewNode();
 
+  // Allocate free block closest to near_pos (parent or sibling block).
+  [[nodiscard]] file_pos_t NewNode(file_pos_t near_pos);
+
   void DeleteNode(file_pos_t pos);
 
+  // Return unused blocks to file system: cut the tail of the file and punch
+  // holes in place of free blocks inside it.
+  void ReleaseFreeBlocks();
+
+  // Write free blocks extents after the last used block for next opening.
+  void SaveFreeBlocks();
+
+  void _LoadFreeBlocks();
+
+  void _SetFree(file_pos_t pos, bool flag_to_set);
+
+  [[nodiscard]] bool _IsFree(file_pos_t pos) const;
+
+  [[nodiscard]] file_pos_t _FindFreeNear(file_pos_t near_pos);
+
+  [[nodiscard]] file_pos_t _FindLowestFree();
+
+  void _ShrinkIfSparse();
+
+  // Pass stored access advice to kernel. Mapping loses it on every reopening.
+  // Returns false if kernel rejected advice.
+  bool _ApplyAdvice();
+
   void _ChangeMaxNumOfNodes(int pages_to_add);
 
   ~Allocator();
@@ -56,22 +89,44 @@ class Allocator{
   size_t _block_size;
   size_t _file_size;
 
+  // Bit i is set if block i is free. Covers blocks before the free tail.
+  std::vector<uint64_t> _free_bitmap;
+  size_t _free_blocks_cnt;
+  size_t _lowest_free_word;  // No free blocks in words before it.
+
+  int _map_advice;  // One of MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL.
+  bool _huge_pages_flag;
+
+  AllocationCounters _counters;
+
   //////////////////////////////////////////////////////////////////////////////
   // Static fields                                                            //
   //////////////////////////////////////////////////////////////////////////////
 
   const static size_t data_info_size = sizeof(DataInfo);
 
+  // Number of bitmap words on each side of hint checked before giving up
+  // locality and taking the lowest free block.
+  const static size_t near_search_words = 4;
+
+  // Blocks added to the file at once and kept spare after shrinking.
+  const static int blocks_growth_step = 100;
+
   //////////////////////////////////////////////////////////////////////////////
   // Friend classes                                                           //
   //////////////////////////////////////////////////////////////////////////////
 
-  template <typename _ElementType, size_t T>
+  template <typename _ElementType, size_t T, typename _TracePolicy,
+            typename _AggregatePolicy>
   friend class FileSavingManager;
 };
 
 template <typename ElementType>
-Allocator<ElementType>::Allocator() {}
+Allocator<ElementType>::Allocator()
+  : _free_blocks_cnt(0),
+    _lowest_free_word(0),
+    _map_advice(MADV_NORMAL),
+    _huge_pages_flag(false) {}
 
 template <typename ElementType>
 Allocator<ElementType>::Allocator(
@@ -89,56 +144,265 @@ Allocator<ElementType>::Allocator(
         CeilDiv(data_info_size, GetFilePageSize()) * GetFilePageSize(),
         block_size
     ),
-    _data_info_ptr(data_info_ptr)
+    _data_info_ptr(data_info_ptr),
+    _free_blocks_cnt(0),
+    _lowest_free_word(0),
+    _map_advice(MADV_NORMAL),
+    _huge_pages_flag(false)
 {
   if (new_file_flag) {
     _data_info_ptr->_free_tail_start = 0;
     _data_info_ptr->_stack_head_pos = -1;
     _data_info_ptr->_max_blocks_cnt = 1;
     _data_info_ptr->_root_pos = 0;
+    _data_info_ptr->_free_extents_cnt = 0;
+    _data_info_ptr->_overflow_heap_head = 0;
     *_block_rw.GetDataInfoPtr() = *_data_info_ptr;
   } else {  // Get data info from existing file
     *_data_info_ptr = *_block_rw.GetDataInfoPtr();
   }
   _file_size = _mapped_file_ptr->size();
+  _LoadFreeBlocks();
 }
 
 template <typename ElementType>
 file_pos_t Allocator<ElementType>::NewNode() {
-  file_pos_t index_to_return;
-  if (_data_info_ptr->_stack_head_pos != -1) {
-    index_to_return = static_cast<file_pos_t>(_data_info_ptr->_stack_head_pos);
-    _data_info_ptr->_stack_head_pos = *_block_rw.GetBlockPtr<signed_file_pos_t>(
-                                          _data_info_ptr->_stack_head_pos
-                                      );
-  } else {
-    index_to_return = _data_info_ptr->_free_tail_start;
-    ++_data_info_ptr->_free_tail_start;
-    if (_data_info_ptr->_free_tail_start >= _data_info_ptr->_max_blocks_cnt) {
-      this->_ChangeMaxNumOfNodes(100);
-    }
+  ++_counters.allocations;
+  if (_free_blocks_cnt != 0) {
+    ++_counters.free_block_hits;
+    file_pos_t pos = _FindLowestFree();
+    _SetFree(pos, false);
+    return pos;
+  }
+  file_pos_t index_to_return = _data_info_ptr->_free_tail_start;
+  ++_data_info_ptr->_free_tail_start;
+  if (_free_bitmap.size() * 64 < _data_info_ptr->_free_tail_start) {
+    _free_bitmap.push_back(0);
+  }
+  if (_data_info_ptr->_free_tail_start >= _data_info_ptr->_max_blocks_cnt) {
+    this->_ChangeMaxNumOfNodes(blocks_growth_step);
   }
   return index_to_return;
 }
 
+template <typename ElementType>
+file_pos_t Allocator<ElementType>::NewNode(file_pos_t near_pos) {
+  if (_free_blocks_cnt != 0) {
+    ++_counters.allocations;
+    ++_counters.free_block_hits;
+    file_pos_t pos = _FindFreeNear(near_pos);
+    _SetFree(pos, false);
+    return pos;
+  }
+  return NewNode();
+}
+
 template <typename ElementType>
 void Allocator<ElementType>::DeleteNode(file_pos_t pos) {
+  ++_counters.deletions;
   if (pos == _data_info_ptr->_free_tail_start - 1) {
     --_data_info_ptr->_free_tail_start;
+    // Free blocks just before the tail join it.
+    while (_data_info_ptr->_free_tail_start != 0 &&
+           _IsFree(_data_info_ptr->_free_tail_start - 1)) {
+      --_data_info_ptr->_free_tail_start;
+      _SetFree(_data_info_ptr->_free_tail_start, false);
+    }
+    _ShrinkIfSparse();
   } else {
-    _block_rw.WriteBlock(pos, _data_info_ptr->_stack_head_pos);
-    _data_info_ptr->_stack_head_pos = pos;
+    _SetFree(pos, true);
+  }
+}
+
+template <typename ElementType>
+void Allocator<ElementType>::ReleaseFreeBlocks() {
+  _ShrinkIfSparse();
+  file_pos_t run_start = 0;
+  while (run_start < _data_info_ptr->_max_blocks_cnt) {
+    while (run_start < _data_info_ptr->_free_tail_start &&
+           !_IsFree(run_start)) {
+      ++run_start;
+    }
+    file_pos_t run_end = run_start;
+    while (run_end < _data_info_ptr->_free_tail_start && _IsFree(run_end)) {
+      ++run_end;
+    }
+    if (run_end == _data_info_ptr->_free_tail_start) {
+      run_end = _data_info_ptr->_max_blocks_cnt;
+    }
+    if (run_end > run_start &&
+        madvise(_block_rw.GetBlockPtr<char>(run_start),
+                (run_end - run_start) * _block_size,
+                MADV_REMOVE) != 0) {
+      throw std::filesystem::filesystem_error(
+          "madvise(MADV_REMOVE) failed", _file_params_ptr->path,
+          std::error_code(errno, std::generic_category()));
+    }
+    run_start = run_end;
   }
 }
 
+template <typename ElementType>
+void Allocator<ElementType>::SaveFreeBlocks() {
+  std::vector<file_pos_t> extents;
+  for (file_pos_t pos = 0; pos < _data_info_ptr->_free_tail_start; ++pos) {
+    if (_IsFree(pos)) {
+      if (!extents.empty() && extents[extents.size() - 2] +
+                              extents.back() == pos) {
+        ++extents.back();
+      } else {
+        extents.push_back(pos);
+        extents.push_back(1);
+      }
+    }
+  }
+  size_t bytes_cnt = extents.size() * sizeof(file_pos_t);
+  size_t blocks_cnt = (bytes_cnt + _block_size - 1) / _block_size;
+  file_pos_t extents_end = _data_info_ptr->_free_tail_start + blocks_cnt;
+  if (extents_end >= _data_info_ptr->_max_blocks_cnt) {
+    _ChangeMaxNumOfNodes(extents_end - _data_info_ptr->_max_blocks_cnt + 1);
+  }
+  if (bytes_cnt != 0) {
+    std::memcpy(_block_rw.GetBlockPtr<char>(_data_info_ptr->_free_tail_start),
+                extents.data(), bytes_cnt);
+  }
+  _data_info_ptr->_free_extents_cnt = extents.size() / 2;
+}
+
+/*
+ * Builds free blocks bitmap from extents saved after the free tail and from
+ * free blocks stack of files written by older versions.
+ */
+
+template <typename ElementType>
+void Allocator<ElementType>::_LoadFreeBlocks() {
+  _free_bitmap.assign((_data_info_ptr->_free_tail_start + 63) / 64, 0);
+  const auto* extents = _block_rw.GetBlockPtr<file_pos_t>(
+      _data_info_ptr->_free_tail_start
+  );
+  for (file_pos_t i = 0; i < _data_info_ptr->_free_extents_cnt; ++i) {
+    for (file_pos_t pos = extents[2 * i];
+         pos < extents[2 * i] + extents[2 * i + 1]; ++pos) {
+      _SetFree(pos, true);
+    }
+  }
+  while (_data_info_ptr->_stack_head_pos != -1) {
+    _SetFree(_data_info_ptr->_stack_head_pos, true);
+    _data_info_ptr->_stack_head_pos = *_block_rw.GetBlockPtr<signed_file_pos_t>(
+        _data_info_ptr->_stack_head_pos
+    );
+  }
+  _data_info_ptr->_free_extents_cnt = 0;
+}
+
+template <typename ElementType>
+void Allocator<ElementType>::_SetFree(file_pos_t pos, bool flag_to_set) {
+  uint64_t mask = uint64_t{1} << (pos % 64);
+  if (flag_to_set) {
+    _free_bitmap[pos / 64] |= mask;
+    ++_free_blocks_cnt;
+    _lowest_free_word = std::min<size_t>(_lowest_free_word, pos / 64);
+  } else {
+    _free_bitmap[pos / 64] &= ~mask;
+    --_free_blocks_cnt;
+  }
+}
+
+template <typename ElementType>
+bool Allocator<ElementType>::_IsFree(file_pos_t pos) const {
+  return (_free_bitmap[pos / 64] >> (pos % 64)) & 1;
+}
+
+/*
+ * Looks for the free block nearest to near_pos in a few bitmap words around
+ * it. Falls back to the lowest free block, which keeps used blocks dense at
+ * the beginning of file. Requires at least one free block.
+ */
+
+template <typename ElementType>
+file_pos_t Allocator<ElementType>::_FindFreeNear(file_pos_t near_pos) {
+  size_t center = std::min<size_t>(near_pos / 64, _free_bitmap.size() - 1);
+  unsigned near_bit = near_pos / 64 == center ? near_pos % 64 : 63;
+  uint64_t word = _free_bitmap[center];
+  if (word != 0) {
+    uint64_t upper = word & (~uint64_t{0} << near_bit);
+    uint64_t lower = word & ~(~uint64_t{0} << near_bit);
+    unsigned upper_bit = upper != 0 ? std::countr_zero(upper) : 128;
+    unsigned lower_bit = lower != 0 ? 63 - std::countl_zero(lower) : 0;
+    bool take_upper =
+        upper != 0 && (lower == 0 || upper_bit - near_bit < near_bit - lower_bit);
+    return center * 64 + (take_upper ? upper_bit : lower_bit);
+  }
+  for (size_t distance = 1; distance <= near_search_words; ++distance) {
+    if (distance <= center && _free_bitmap[center - distance] != 0) {
+      return (center - distance) * 64 + 63 -
+             std::countl_zero(_free_bitmap[center - distance]);
+    }
+    if (center + distance < _free_bitmap.size() &&
+        _free_bitmap[center + distance] != 0) {
+      return (center + distance) * 64 +
+             std::countr_zero(_free_bitmap[center + distance]);
+    }
+  }
+  return _FindLowestFree();
+}
+
+template <typename ElementType>
+file_pos_t Allocator<ElementType>::_FindLowestFree() {
+  while (_free_bitmap[_lowest_free_word] == 0) {
+    ++_lowest_free_word;
+  }
+  return _lowest_free_word * 64 +
+         std::countr_zero(_free_bitmap[_lowest_free_word]);
+}
+
+/*
+ * Cuts file if more than half of its blocks are after the free tail.
+ */
+
+template <typename ElementType>
+void Allocator<ElementType>::_ShrinkIfSparse() {
+  file_pos_t needed_blocks_cnt =
+      _data_info_ptr->_free_tail_start + blocks_growth_step;
+  if (_data_info_ptr->_max_blocks_cnt > 2 * needed_blocks_cnt) {
+    _ChangeMaxNumOfNodes(static_cast<int>(needed_blocks_cnt) -
+                         static_cast<int>(_data_info_ptr->_max_blocks_cnt));
+  }
+}
+
+/*
+ * Read-around on page faults fills page cache with pages of windows, which are
+ * not used and so are never dropped. Mapping under memory budget is always
+ * advised as random for this reason.
+ */
+
+template <typename ElementType>
+bool Allocator<ElementType>::_ApplyAdvice() {
+  int advice = _block_rw._windows_ptr != nullptr ? MADV_RANDOM : _map_advice;
+  bool success_flag = madvise(_mapped_file_ptr->data(),
+                              _mapped_file_ptr->size(), advice) == 0;
+  if (_huge_pages_flag) {
+    success_flag = madvise(_mapped_file_ptr->data(), _mapped_file_ptr->size(),
+                           MADV_HUGEPAGE) == 0 && success_flag;
+  }
+  return success_flag;
+}
+
 template <typename ElementType>
 void Allocator<ElementType>::_ChangeMaxNumOfNodes(int blocks_to_add) {
+  if (_file_params_ptr->flags ==
+      boost::iostreams::mapped_file::mapmode::priv) {
+    throw std::logic_error("list file is opened read-only");
+  }
+  ++_counters.remaps;
   _mapped_file_ptr->close();
   _file_size += blocks_to_add * _block_size;
   std::filesystem::resize_file(_file_params_ptr->path, _file_size);
   _file_params_ptr->length = _file_size;
   _file_params_ptr->new_file_size = 0;
   _mapped_file_ptr->open(*_file_params_ptr);
+  // The same advice was accepted for the old mapping of this file.
+  static_cast<void>(_ApplyAdvice());
   _data_info_ptr->_max_blocks_cnt += blocks_to_add;
 }
 
@@ -1,27 +1,87 @@
+#include <algorithm>
+#include <atomic>
 #include <fcntl.h>
 #include <string>
 #include <cstring>
+#include <functional>
 #include <unistd.h>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include "node.hpp"
 #include "file_saving_manager.hpp"
+#include "integrity_report.hpp"
 #include "data_info.hpp"
 #include "block_rw.hpp"
+#include "residency.hpp"
+#include "stats.hpp"
+#include "structure_report.hpp"
+#include "trace_policy.hpp"
+#include "trace_recorder.hpp"
 
 #ifndef B_TREE_LIST_LIBRARY_H
 #define B_TREE_LIST_LIBRARY_H
 
-template <typename ElementType, size_t T = 200>
+// Order in which nodes are placed into the file on rebuild.
+enum class RebuildLayout {
+  BFS,            // Level by level starting with root.
+  VAN_EMDE_BOAS,  // Top half of levels first, then each bottom subtree
+                  // recursively, so one root-to-leaf path is clustered.
+};
+
+// Expected access pattern, passed to kernel as advice for file mapping.
+enum class AccessAdvice {
+  NORMAL,      // Default readahead.
+  RANDOM,      // Point lookups: no readahead.
+  SEQUENTIAL,  // Scans: aggressive readahead, pages dropped after reading.
+};
+
+template <typename ElementType, size_t T = 200,
+          typename TracePolicy = NoTracePolicy,
+          typename AggregatePolicy = NoAggregatePolicy>
 class BTreeList{
  public:
+  // Value kept for every subtree by AggregatePolicy.
+  typedef typename AggregatePolicy::ValueType AggregateType;
+
+  // Positional operation for ApplyBatch. Index refers to the list after all
+  // previous operations of batch.
+  struct BatchOperation{
+    enum Type{
+      INSERT,
+      EXTRACT,
+      SET,
+    };
+
+    Type type;
+    size_t index;
+    ElementType element;  // Not used by extract.
+  };
 
   // Simple constructor.
   // If file with filename name exists, tries open it as data file.
   // If not exists creates new empty file.
   explicit BTreeList(const std::string &filename, bool rebuild_flag = true);
 
+  // Creates empty list in storage backend. For ANONYMOUS_MEMORY name is only
+  // a label and data is lost when list is destroyed. For FILE existing file is
+  // truncated. List is not rebuilt on destruction.
+  BTreeList(const std::string &name, StorageBackend backend);
+
+  // Opens existing list file. In READ_ONLY mode file is never changed:
+  // modifications stay in memory and operations which need to grow the file
+  // throw logic_error. List is not rebuilt on destruction.
+  BTreeList(const std::string &filename, OpenMode mode);
+
   // Creates file for tree of size size
   // If file with such name exists truncates it
   template <typename SizeType>
@@ -44,24 +104,205 @@ class BTreeList{
             bool rebuild_flag = true);
 
   // Insert element to index position.
-  void Insert(unsigned index, const ElementType& e);
+  void Insert(size_t index, const ElementType& e);
 
   // Insert elements from iterators range starting with index position.
   template <typename IteratorType>
-  void Insert(unsigned index, IteratorType begin, IteratorType end);
+  void Insert(size_t index, IteratorType begin, IteratorType end);
 
   // Extract element from index position
-  ElementType Extract(unsigned index);
-
-  // Access to element by index
-  ElementType& operator[](unsigned index);
-
-  // Access to element by index
-  ElementType operator[](unsigned index) const;
+  ElementType Extract(size_t index);
+
+  // Add element after the last one. Paths to the first and the last leaves
+  // are kept between calls, so usually no descent from root is needed.
+  void PushBack(const ElementType &e);
+
+  // Add element before the first one.
+  void PushFront(const ElementType &e);
+
+  // Extract the last element. Throws out_of_range if list is empty.
+  ElementType PopBack();
+
+  // Extract the first element. Throws out_of_range if list is empty.
+  ElementType PopFront();
+
+  // Access to element by index. Not available if subtrees are aggregated,
+  // because aggregates can not follow writes by reference; use Set.
+  ElementType& operator[](size_t index)
+      requires (!is_aggregated_v<AggregatePolicy>);
+
+  // Access to element by index. Throws out_of_range if index is not less
+  // than Size().
+  ElementType operator[](size_t index) const;
+
+  // Set element on index position.
+  void Set(size_t index, const ElementType &e);
+
+  // Get elements by many unrelated indexes and write them to out in the same
+  // order. Several lookups go down the tree at once, so memory loads of one
+  // lookup overlap with work on others. Throws out_of_range before any
+  // lookup if some index is not less than Size().
+  template <typename OutputIteratorType>
+  OutputIteratorType GetMany(std::span<const size_t> indexes,
+                             OutputIteratorType out);
+
+  // Get elements by sorted indexes and write them to out in the same order.
+  // Tree is walked once, every touched node is read once.
+  template <typename OutputIteratorType>
+  OutputIteratorType GetSorted(std::span<const size_t> indexes,
+                               OutputIteratorType out) const;
+
+  // Set elements by sorted indexes to values taken one by one from values
+  // iterator. Tree is walked once, every touched node is read once.
+  template <typename InputIteratorType>
+  void SetSorted(std::span<const size_t> indexes, InputIteratorType values);
+
+  // Apply operations one after another. All operations which fall into one
+  // leaf are applied with one read and write of it, and children counts of
+  // its ancestors are corrected once.
+  void ApplyBatch(std::span<const BatchOperation> operations);
+
+  // Sorted mode. List must be sorted by compare, which is a strict weak
+  // order like in std::sort. Every search is one descent by separators of
+  // internal nodes, position is counted by children counts on the way.
+
+  // The first index where element is not less than value, or Size().
+  template <typename CompareType = std::less<ElementType>>
+  [[nodiscard]] size_t LowerBound(const ElementType &value,
+                                  CompareType compare = CompareType()) const;
+
+  // The first index where element is greater than value, or Size().
+  template <typename CompareType = std::less<ElementType>>
+  [[nodiscard]] size_t UpperBound(const ElementType &value,
+                                  CompareType compare = CompareType()) const;
+
+  // LowerBound and UpperBound together. Descent is common while both bounds
+  // are in the same subtree.
+  template <typename CompareType = std::less<ElementType>>
+  [[nodiscard]] std::pair<size_t, size_t> EqualRange(
+      const ElementType &value,
+      CompareType compare = CompareType()) const;
+
+  // Insert element after all elements not greater than it, so list stays
+  // sorted. Leaf is found by value without descent by index. Returns index
+  // of inserted element.
+  template <typename CompareType = std::less<ElementType>>
+  size_t InsertSorted(const ElementType &e,
+                      CompareType compare = CompareType());
 
   // Get size of structure
   [[nodiscard]] size_t Size() const;
 
+  // Aggregate of elements from first to last (not including). Subtrees
+  // which lie inside the range are taken from stored aggregates, so only
+  // two paths from root are walked.
+  [[nodiscard]] AggregateType RangeAggregate(size_t first, size_t last) const
+      requires is_aggregated_v<AggregatePolicy>;
+
+  // The first index for which predicate returns true on aggregate of
+  // elements from the beginning to this index (including). Predicate must
+  // be monotone: once true, true for all longer prefixes. Returns Size() if
+  // there is no such index.
+  template <typename PredicateType>
+  [[nodiscard]] size_t FindPrefix(PredicateType predicate) const
+      requires is_aggregated_v<AggregatePolicy>;
+
+  // The first index where aggregate of prefix is not less than value, for
+  // example the first index where prefix sum reaches value.
+  [[nodiscard]] size_t FindPrefixReaching(const AggregateType &value) const
+      requires is_aggregated_v<AggregatePolicy>;
+
+  // Set nodes order used by rebuild in destructor
+  void SetRebuildLayout(RebuildLayout layout);
+
+  // Return space of deleted nodes to file system. Throws filesystem_error if
+  // file system can not punch holes in file.
+  void ReleaseFreeSpace();
+
+  // Tell kernel how file is going to be accessed. Returns false if kernel
+  // rejected advice.
+  bool Advise(AccessAdvice advice);
+
+  // Ask kernel to back file mapping with transparent huge pages where
+  // available (tmpfs or file systems with THP support for page cache).
+  // Returns false if kernel rejected advice.
+  bool SetHugePages(bool flag_to_set);
+
+  // Start writing every positional operation to binary trace file at
+  // trace_path. Trace can be replayed by b_tree_list_trace_replay. Element
+  // access by non-constant operator[] is recorded as GET, use Set for writes
+  // to be recorded as SET. Throws std::runtime_error if file can not be
+  // created.
+  void StartRecording(const std::string &trace_path);
+
+  // Stop writing trace and flush it to file. Throws std::runtime_error if
+  // some write to trace file failed, recording is stopped anyway.
+  void StopRecording();
+
+  // Remember path to the last accessed element, so next access by close index
+  // starts from the lowest common subtree instead of root. Used by element
+  // access, Set, Insert and Extract.
+  void SetFingerSearch(bool flag_to_set);
+
+  // Counters of node copies, allocations and rebalancing since creation or
+  // the last ResetStats(), and latency histograms if they are enabled.
+  [[nodiscard]] ListStats Stats() const;
+
+  void ResetStats();
+
+  // Measure latency of every public operation. Costs two clock reads per
+  // operation, so it is off by default.
+  void EnableLatencyHistograms(bool flag_to_set);
+
+  // Keep nodes of levels upper levels in memory instead of file mapping, so
+  // operations reach file only on lower levels. Memory is locked if
+  // lock_flag is set. Zero levels unpins everything. Returns false if
+  // lock_flag is set, but mlock failed (e.g. because of RLIMIT_MEMLOCK);
+  // nodes are pinned anyway, they just can be swapped out.
+  bool PinUpperLevels(unsigned levels, bool lock_flag = false);
+
+  // Keep at most budget_bytes of file mapping in memory. Mapping is split
+  // into windows of window_bytes and the least recently used windows are
+  // written back and dropped from mapping and page cache, to be read again
+  // from disk (memory file of ANONYMOUS_MEMORY stays in page cache). While
+  // budget is set, mapping is advised as RANDOM whatever Advise asked. Zero
+  // budget removes the limit. Changes of READ_ONLY list are lost with
+  // dropped pages, so set budget for such list only if it is not changed.
+  void SetMemoryBudget(size_t budget_bytes,
+                       size_t window_bytes = default_window_bytes);
+
+  // Write all changes to file and wait till they are on disk
+  void Sync();
+
+  // Start reading leaves with elements from first to last (not including)
+  // in background. Returns false if kernel rejected advice.
+  bool Prefetch(size_t first, size_t last);
+
+  // Share of node pages which are in page cache for every tree level and for
+  // leaves of ranges_cnt equal index ranges, and file extents on disk.
+  // Residency is taken before the tree is walked, so the walk does not
+  // change the result. Check pages_flag of result: it is false if kernel
+  // did not report residency, resident pages counts are zero then.
+  [[nodiscard]] ResidencyMap Residency(size_t ranges_cnt = 16) const;
+
+  // Write all elements leaf by leaf to new packed tree in target_path file.
+  // Nodes get fill_factor part of maximum elements count (bounded by B-tree
+  // node size limits). Current file is only read, so list stays usable.
+  // Throws invalid_argument if target_path is the current file (by any
+  // path).
+  void Rebuild(const std::string &target_path, double fill_factor = 1.) const;
+
+  // Height, nodes of every level, node fill, fragmentation of file and its
+  // projected size after rebuild. Walks whole tree.
+  [[nodiscard]] StructureReport AnalyzeStructure() const;
+
+  // Check file: links point to used blocks which are not free and are
+  // reached once, node sizes and flags are right, leaves are on one level,
+  // children counts and list size match elements in subtrees. Subtrees are
+  // checked by threads_cnt threads (all cores if zero). List must not be
+  // changed meanwhile.
+  [[nodiscard]] IntegrityReport Verify(unsigned threads_cnt = 0) const;
+
   ~BTreeList();
 
  private:
@@ -71,10 +312,110 @@ class BTreeList{
 
   std::shared_ptr<DataInfo> _data_info_ptr;
 
-  FileSavingManager<ElementType, T> _file_manager;
+  FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy> _file_manager;
 
   bool _rebuild_flag;
 
+  RebuildLayout _rebuild_layout;
+
+  unsigned _pinned_levels;
+  bool _pinned_lock_flag;
+
+  // Subtrees on the path to the last accessed element. Is cleared on every
+  // change of tree structure.
+  struct _FingerLevel;
+  std::vector<_FingerLevel> _finger;
+  bool _finger_flag;
+
+  std::unique_ptr<TraceRecorder> _recorder;  // Null if not recording.
+
+  StructureCounters _structure_counters;
+  std::unique_ptr<LatencyRecorder> _latencies;  // Null if not measured.
+
+  // Paths from root to the last and to the first leaves. Empty if unknown.
+  std::vector<file_pos_t> _back_path;
+  std::vector<file_pos_t> _front_path;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Static fields                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Number of lookups going down at once in GetMany
+  constexpr static size_t lookups_group_size = 16;
+
+  // Subtrees per thread checked by Verify, so threads finish close in time.
+  constexpr static unsigned verify_tasks_per_thread = 8;
+
+  constexpr static unsigned max_verify_split_level = 16;
+
+  constexpr static size_t default_window_bytes = 1 << 20;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Private classes                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Which children of node are refreshed by _RefreshSubtreeAggregates.
+  enum class _RefreshSide {
+    RANGES,       // Touching ranges, with or without nearest neighbours.
+    LEFT_SPINE,   // The first child, recursively.
+    RIGHT_SPINE,  // The last child, recursively.
+  };
+
+  // Subtree on finger path and range of indexes of its elements
+  struct _FingerLevel{
+    file_pos_t _file_pos;
+    size_t _first;
+    size_t _size;
+    unsigned _parent_index;  // Index of link to subtree in parent node.
+  };
+
+  // Batch operation moved to coordinates of the list before batch.
+  struct _BatchEdit{
+    size_t _orig_pos;  // Element index or, for inserted, index of next one.
+    bool _inserted_flag;
+    bool _extracted_flag;
+    bool _set_flag;
+    ElementType _element;
+  };
+
+  // State shared by threads of Verify.
+  struct _VerifyContext{
+    file_pos_t _blocks_cnt;  // Blocks links may point to.
+    std::vector<std::atomic<bool>> _visited;
+    std::atomic<unsigned> _leaf_level;
+    // Subtrees with roots on _split_level are checked in parallel first,
+    // their sizes are used when upper levels are checked.
+    unsigned _split_level;
+    std::unordered_map<file_pos_t, size_t> _split_sizes;
+  };
+
+  // Reads elements one by one in index order keeping only the path to the
+  // current element.
+  class _ElementsReader{
+   public:
+    explicit _ElementsReader(
+        const FileSavingManager<ElementType, T, TracePolicy,
+                                AggregatePolicy> &manager,
+        file_pos_t root_pos);
+
+    ElementType Next();
+
+   private:
+    void _GoDownLeft(file_pos_t pos);
+
+    // Visited node content (links are empty for leaf) and index of next
+    // element to read from it.
+    struct _PathEntry{
+      std::vector<ElementType> _elements;
+      std::vector<file_pos_t> _links;
+      unsigned _next_index;
+    };
+
+    const FileSavingManager<ElementType, T, TracePolicy,
+                            AggregatePolicy> &_file_manager;
+    std::vector<_PathEntry> _path;
+  };
+
   //////////////////////////////////////////////////////////////////////////////
   // Private methods                                                          //
   //////////////////////////////////////////////////////////////////////////////
@@ -84,28 +425,134 @@ class BTreeList{
   void _ResizeFromEmpty(size_t size, const ElementType &element_to_fill);
 
   template <typename IteratorType>
-  void _Insert(unsigned &index, IteratorType &begin, IteratorType &end);
+  void _Insert(size_t &index, IteratorType &begin, IteratorType &end);
 
   void _AllocateBackElements(size_t &cnt,
                              const ElementType& element_to_fill,
                              bool need_to_set_flag);
 
-  unsigned _FindInNodeIndex(const Node<ElementType, T> &node,
-                            int64_t &elements_to_skip);
-
-  Node<ElementType, T> _FindElement(unsigned index,
-                                    file_pos_t &file_pos,
-                                    unsigned &index_to_operate);
-
-  void _FindPathToLeafByIndex(unsigned index,
+  // Goes down from file_pos reading nodes in place, so nodes of pinned
+  // levels are not copied.
+  void _FindElement(size_t index,
+                    file_pos_t &file_pos,
+                    unsigned &index_to_operate);
+
+  bool _DescendInMappedNode(file_pos_t &file_pos,
+                            size_t &elements_to_skip,
+                            unsigned &in_node_index);
+
+  void _PrefetchNode(file_pos_t file_pos) const;
+
+  static void _AddBatchOperation(const BatchOperation &operation,
+                                 std::vector<_BatchEdit> &edits);
+
+  size_t _ApplyEditsToLeaf(const std::vector<_BatchEdit> &edits,
+                           size_t edits_end);
+
+  // FileManagerType is constant or mutable file manager of list, visitor
+  // gets element reference of the same constness. Visited nodes of mutable
+  // one are reported as written.
+  template <typename FileManagerType, typename VisitorType>
+  static void _VisitSorted(FileManagerType &file_manager,
+                           file_pos_t subtree_root_pos,
+                           std::span<const size_t> indexes,
+                           size_t subtree_first,
+                           VisitorType &visitor);
+
+  // Recompute stored aggregates after change of elements with sorted
+  // touched_ranges indexes (closed ranges). If neighbours_flag is set, tree
+  // structure also changed, so nodes next to changed ones on every level
+  // are refreshed too. Does nothing if subtrees are not aggregated.
+  void _RefreshAggregates(
+      std::span<const std::pair<size_t, size_t>> touched_ranges,
+      bool neighbours_flag);
+
+  void _RefreshAggregates(size_t first, size_t last, bool neighbours_flag);
+
+  AggregateType _RefreshSubtreeAggregates(
+      file_pos_t subtree_root_pos,
+      size_t subtree_first,
+      std::span<const std::pair<size_t, size_t>> touched_ranges,
+      _RefreshSide side,
+      bool neighbours_flag);
+
+  AggregateType _SubtreeRangeAggregate(file_pos_t subtree_root_pos,
+                                       size_t subtree_first,
+                                       size_t first,
+                                       size_t last) const;
+
+  void _DropCachedPaths();
+
+  void _RecordIndexes(TraceOperation operation,
+                      std::span<const size_t> indexes) const;
+
+  const std::vector<file_pos_t>& _GetEndPath(bool back_flag);
+
+  void _ChangeEndCnts(const std::vector<file_pos_t> &end_path,
+                      bool back_flag,
+                      int change);
+
+  void _FindElementByFinger(size_t index,
+                            file_pos_t &file_pos,
+                            unsigned &index_to_operate);
+
+  // Drops finger levels which have no element with index. If end_flag is
+  // set, index right after subtree is kept too, as position to insert to.
+  // Root level is added to empty finger.
+  void _TrimFinger(size_t index, bool end_flag);
+
+  // Fills paths with root, or with finger levels if finger search is on.
+  // Returns index relative to the last node of file_pos_path.
+  size_t _StartPathByFinger(size_t index,
+                            bool end_flag,
+                            std::vector<file_pos_t> &file_pos_path,
+                            std::vector<unsigned> &indexes_path);
+
+  // Keeps finger after change of size by size_change without change of
+  // structure. Levels of finger must all have changed element.
+  void _RestoreFinger(std::vector<_FingerLevel> &&finger, int size_change);
+
+  // Index in node of the first element not less than (greater than if
+  // upper_flag is set) value, which is also index of child to go down to.
+  template <typename CompareType>
+  static unsigned _BoundInNodeIndex(const ElementType* elements,
+                                    unsigned elements_cnt,
+                                    const ElementType &value,
+                                    CompareType &compare,
+                                    bool upper_flag);
+
+  // Index in list of bound of value in subtree, subtree_first is index of
+  // the first element of subtree.
+  template <typename CompareType>
+  size_t _BoundInSubtree(file_pos_t subtree_root_pos,
+                         size_t subtree_first,
+                         const ElementType &value,
+                         CompareType &compare,
+                         bool upper_flag) const;
+
+  // Path to leaf where element equal to value is inserted after equal ones.
+  // Returns index of inserted element.
+  template <typename CompareType>
+  size_t _FindPathToLeafByValue(const ElementType &value,
+                                CompareType &compare,
+                                std::vector<file_pos_t> &file_pos_path,
+                                std::vector<unsigned> &indexes_path);
+
+  // Insert element to leaf at the end of path and split overflowed nodes
+  // up the path.
+  void _InsertByPath(std::vector<file_pos_t> &file_pos_path,
+                     std::vector<unsigned> &indexes_path,
+                     const ElementType &e);
+
+  // Both read nodes in place and extend finger if finger search is on, so
+  // callers changing structure drop it after.
+  void _FindPathToLeafByIndex(size_t index,
                               std::vector<file_pos_t> &file_pos_path,
                               std::vector<unsigned> &indexes_path);
 
-  Node<ElementType, T> _FindPathByIndex(
-      unsigned index,
-      std::vector<file_pos_t> &file_pos_path,
-      std::vector<unsigned> &indexes_path
-  );
+  void _FindPathByIndex(size_t index,
+                        std::vector<file_pos_t> &file_pos_path,
+                        std::vector<unsigned> &indexes_path);
 
   void _FindAppropriateInLeafElement(
       std::vector<file_pos_t > &file_pos_path,
@@ -116,21 +563,21 @@ class BTreeList{
                                std::vector<unsigned> &indexes_path);
 
   void _MoveElementFromLeftNeighbour(
-      Node<ElementType, T> &node,
-      Node<ElementType, T> &neighbour_node,
-      Node<ElementType, T> &parent_node,
+      Node<ElementType, T, AggregatePolicy> &node,
+      Node<ElementType, T, AggregatePolicy> &neighbour_node,
+      Node<ElementType, T, AggregatePolicy> &parent_node,
       unsigned &in_parent_index
   );
 
   void _MoveElementFromRightNeighbour(
-      Node<ElementType, T> &node,
-      Node<ElementType, T> &neighbour_node,
-      Node<ElementType, T> &parent_node,
+      Node<ElementType, T, AggregatePolicy> &node,
+      Node<ElementType, T, AggregatePolicy> &neighbour_node,
+      Node<ElementType, T, AggregatePolicy> &parent_node,
       unsigned &in_parent_index
   );
 
-  bool _CorrectNodeOnExtract(Node<ElementType, T> &node,
-                             Node<ElementType, T> &parent_node,
+  bool _CorrectNodeOnExtract(Node<ElementType, T, AggregatePolicy> &node,
+                             Node<ElementType, T, AggregatePolicy> &parent_node,
                              file_pos_t file_pos,
                              file_pos_t parent_file_pos,
                              unsigned in_parent_index);
@@ -139,116 +586,221 @@ class BTreeList{
                             std::vector<unsigned> &in_node_indexes_path,
                             int to_change);
 
+  unsigned _Height();
+
+  void _BFSOrder(std::vector<file_pos_t> &order);
+
+  void _VanEmdeBoasOrder(file_pos_t subtree_root_pos,
+                         unsigned height,
+                         std::vector<file_pos_t> &order);
+
   void _Rebuild();
+
+  // Returns false if pinned memory was not locked while lock was asked.
+  bool _RepinUpperLevels();
+
+  void _AddSubtreeResidency(file_pos_t subtree_root_pos,
+                            unsigned level,
+                            size_t subtree_first,
+                            const std::vector<unsigned char> &pages_residency,
+                            ResidencyMap &residency_map) const;
+
+  void _AddSubtreeStructure(file_pos_t subtree_root_pos,
+                            unsigned level,
+                            StructureReport &report,
+                            size_t &distances_sum) const;
+
+  // Roots of subtrees to check in parallel, ordered by block. Split level is
+  // the first one with enough subtrees or with a leaf.
+  void _CollectVerifySplit(unsigned tasks_cnt,
+                           _VerifyContext &context,
+                           std::vector<file_pos_t> &split_roots) const;
+
+  // Check subtree and return number of its elements.
+  size_t _VerifySubtree(file_pos_t subtree_root_pos,
+                        unsigned level,
+                        _VerifyContext &context,
+                        IntegrityReport &report) const;
+
+  void _CollectLeavesInRange(file_pos_t subtree_root_pos,
+                             size_t first,
+                             size_t last,
+                             std::vector<file_pos_t> &leaves_positions);
+
+  static size_t _SubtreeCapacity(unsigned height, size_t node_size);
+
+  static size_t _MinSubtreeSize(unsigned height);
+
+  // Height of packed tree with elements_cnt elements in nodes of node_size.
+  static unsigned _PackedHeight(size_t elements_cnt, size_t node_size);
+
+  // Children of packed subtree root.
+  static size_t _PackedChildrenCnt(size_t elements_cnt,
+                                   unsigned height,
+                                   size_t node_size,
+                                   bool is_root);
+
+  // Nodes _WritePacked writes for such subtree.
+  static size_t _PackedNodesCnt(size_t elements_cnt,
+                                unsigned height,
+                                size_t node_size,
+                                bool is_root);
+
+  file_pos_t _WritePacked(
+      FileSavingManager<ElementType, T, TracePolicy,
+                        AggregatePolicy> &new_file_manager,
+      _ElementsReader &reader,
+      size_t elements_cnt,
+      unsigned height,
+      size_t node_size,
+      bool is_root,
+      AggregateType &aggregate) const;
+
+  // Blocks of the same file which are not tree nodes.
+  file_pos_t _NewRawBlock();
+
+  void _DeleteRawBlock(file_pos_t pos);
+
+  char* _GetRawBlockPtr(file_pos_t pos);
+
+  [[nodiscard]] size_t _RawBlockSize() const;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Friend classes                                                           //
+  //////////////////////////////////////////////////////////////////////////////
+
+  template <size_t _InlineSize, size_t _T>
+  friend class BytesList;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation                                                             //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-BTreeList<ElementType, T>::BTreeList(const std::string &filename,
-                                     bool rebuild_flag)
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &filename,
+                                      bool rebuild_flag)
     : _data_info_ptr(std::make_shared<DataInfo>()),
       _file_manager(filename, _data_info_ptr, false),
-      _rebuild_flag(rebuild_flag) {}
-
-template <typename ElementType, size_t T>
+      _rebuild_flag(rebuild_flag),
+      _rebuild_layout(RebuildLayout::BFS),
+      _pinned_levels(0),
+      _pinned_lock_flag(false),
+      _finger_flag(false) {}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &filename,
+                                      OpenMode mode)
+    : _data_info_ptr(std::make_shared<DataInfo>()),
+      _file_manager(filename, _data_info_ptr, mode),
+      _rebuild_flag(false),
+      _rebuild_layout(RebuildLayout::BFS),
+      _pinned_levels(0),
+      _pinned_lock_flag(false),
+      _finger_flag(false) {}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &name,
+                                      StorageBackend backend)
+    : _data_info_ptr(std::make_shared<DataInfo>()),
+      _file_manager(name, _data_info_ptr, backend),
+      _rebuild_flag(false),
+      _rebuild_layout(RebuildLayout::BFS),
+      _pinned_levels(0),
+      _pinned_lock_flag(false),
+      _finger_flag(false) {}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
 template <typename SizeType>
-BTreeList<ElementType, T>::BTreeList(const std::string &filename,
-                                     SizeType size,
-                                     bool rebuild_flag)
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &filename,
+                                      SizeType size,
+                                      bool rebuild_flag)
   : _data_info_ptr(std::make_shared<DataInfo>()),
     _file_manager(filename, _data_info_ptr, true),
-    _rebuild_flag(rebuild_flag) {
+    _rebuild_flag(rebuild_flag),
+    _rebuild_layout(RebuildLayout::BFS),
+    _pinned_levels(0),
+    _pinned_lock_flag(false),
+    _finger_flag(false) {
   _ResizeFromEmpty(size);
 }
 
-template <typename ElementType, size_t T>
-BTreeList<ElementType, T>::BTreeList(const std::string &filename,
-                                     size_t size,
-                                     const ElementType& element,
-                                     bool rebuild_flag)
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &filename,
+                                      size_t size,
+                                      const ElementType& element,
+                                      bool rebuild_flag)
     : _data_info_ptr(std::make_shared<DataInfo>()),
       _file_manager(filename, _data_info_ptr, true),
-      _rebuild_flag(rebuild_flag) {
+      _rebuild_flag(rebuild_flag),
+      _rebuild_layout(RebuildLayout::BFS),
+      _pinned_levels(0),
+      _pinned_lock_flag(false),
+      _finger_flag(false) {
   _ResizeFromEmpty(size, element);
 }
 
-template <typename ElementType, size_t T>
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
 template <typename IteratorType>
-BTreeList<ElementType, T>::BTreeList(const std::string &filename,
-                                     IteratorType begin,
-                                     IteratorType end,
-                                     bool rebuild_flag)
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::BTreeList(const std::string &filename,
+                                      IteratorType begin,
+                                      IteratorType end,
+                                      bool rebuild_flag)
   : _data_info_ptr(std::make_shared<DataInfo>()),
     _file_manager(filename, _data_info_ptr, true),
-    _rebuild_flag(rebuild_flag) {
+    _rebuild_flag(rebuild_flag),
+    _rebuild_layout(RebuildLayout::BFS),
+    _pinned_levels(0),
+    _pinned_lock_flag(false),
+    _finger_flag(false) {
   Insert(0, begin, end);
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::Insert(unsigned index, const ElementType &e) {
-  ++_data_info_ptr->_size;
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Insert(
+    size_t index,
+    const ElementType &e
+) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::INSERT, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::INSERT);
   std::vector<file_pos_t> file_pos_path;
   std::vector<unsigned> indexes_path;
   _FindPathToLeafByIndex(index, file_pos_path, indexes_path);
-
-  ElementType element_to_insert = e;
-  file_pos_t link_after_inserted = 0;
-  file_pos_t link_before_inserted = 0;
-  size_t cc_after_inserted = 0;
-  size_t cc_before_inserted = 0;
-
-  do {
-    file_pos_t curr_file_pos = file_pos_path.back();
-    unsigned curr_innode_index = indexes_path.back();
-    file_pos_path.pop_back();
-    indexes_path.pop_back();
-
-    Node<ElementType, T> curr_node = _file_manager.GetNode(curr_file_pos);
-
-    curr_node.Insert(curr_innode_index, element_to_insert);
-    curr_node.SetLinks(curr_innode_index,
-                       link_before_inserted, link_after_inserted);
-    curr_node.SetChildrenCnts(curr_innode_index,
-                              cc_before_inserted, cc_after_inserted);
-
-    if (curr_node.Size() >= T * 2 - 1) {
-      element_to_insert = curr_node.GetMiddleElement();
-      // Prepare halves
-      Node<ElementType, T> first_half_node = curr_node.NodeFromFirstHalf();
-      Node<ElementType, T> second_half_node = curr_node.NodeFromSecondHalf();
-      // Prepare links
-      link_before_inserted = curr_file_pos;
-      link_after_inserted = _file_manager.NewNode();
-      // Prepare children cnts
-      cc_before_inserted = first_half_node.GetAllChildrenCnt();
-      cc_after_inserted = second_half_node.GetAllChildrenCnt();
-      // Set halves
-      _file_manager.SetNode(link_before_inserted, first_half_node);
-      _file_manager.SetNode(link_after_inserted, second_half_node);
-      if (file_pos_path.empty()) { // Separated root
-        Node<ElementType, T> new_root(
-            std::vector<ElementType>{element_to_insert},
-            std::vector<file_pos_t>{link_before_inserted, link_after_inserted},
-            std::vector<size_t>{cc_before_inserted, cc_after_inserted},
-            Node<ElementType, T>::_Flags::ROOT
-        );
-        _data_info_ptr->_root_pos = _file_manager.NewNode(new_root);
-      }
-    } else {  // Just inserted
-      _file_manager.SetNode(curr_file_pos, curr_node);
-      _CorrectChildrenCnts(file_pos_path, indexes_path, 1);
-    }
-  } while (!file_pos_path.empty());
+  std::vector<_FingerLevel> finger = std::move(_finger);
+  uint64_t splits_cnt = _structure_counters.splits;
+  _DropCachedPaths();
+  ++_data_info_ptr->_size;
+  _InsertByPath(file_pos_path, indexes_path, e);
+  if (_structure_counters.splits == splits_cnt) {
+    _RestoreFinger(std::move(finger), 1);
+  }
+  _RefreshAggregates(index, index, true);
 }
 
-template<typename ElementType, size_t T>
+template<typename ElementType, size_t T, typename TracePolicy,
+         typename AggregatePolicy>
 template<typename IteratorType>
-void BTreeList<ElementType, T>::Insert(unsigned index,
-                                       IteratorType begin,
-                                       IteratorType end) {
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Insert(
+    size_t index,
+    IteratorType begin,
+    IteratorType end
+) {
+  size_t size_before = Size();
+  TraceScope trace_scope(_recorder.get(), TraceOperation::INSERT, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::BATCH);
   while (begin != end) {
     _Insert(index, begin, end);
     if (begin != end) {
@@ -257,31 +809,339 @@ void BTreeList<ElementType, T>::Insert(unsigned index,
       ++index;
     }
   }
+  trace_scope.SetCount(Size() - size_before);
 }
 
-template <typename ElementType, size_t T>
-ElementType& BTreeList<ElementType, T>::operator[](unsigned index) {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType&
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::operator[](size_t index)
+    requires (!is_aggregated_v<AggregatePolicy>) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::GET, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
   file_pos_t file_pos = _data_info_ptr->_root_pos;
   unsigned in_node_index;
 
-  _FindElement(index, file_pos, in_node_index);
+  if (_finger_flag) {
+    _FindElementByFinger(index, file_pos, in_node_index);
+  } else {
+    _FindElement(index, file_pos, in_node_index);
+  }
   return *_file_manager._block_rw.template GetNodeElementPtr<ElementType, T>(
       file_pos,
       in_node_index
   );
 };
 
-template <typename ElementType, size_t T>
-ElementType BTreeList<ElementType, T>::operator[](unsigned index) const {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::operator[](
+    size_t index
+) const {
+  if (index >= Size()) {
+    throw std::out_of_range("list index out of range");
+  }
+  TraceScope trace_scope(_recorder.get(), TraceOperation::GET, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
+  const BlockRW &block_rw = _file_manager._block_rw;
+  file_pos_t file_pos = _data_info_ptr->_root_pos;
+  size_t elements_to_skip = index;
+  while (true) {
+    TracePolicy::OnNodeRead(file_pos);
+    size_t elements_cnt =
+        block_rw.GetNodeInfoPtr<ElementType, T>(file_pos)->_elements_cnt;
+    const auto* children_cnts = reinterpret_cast<const size_t*>(
+        block_rw.GetNodeCCBegPtr<ElementType, T>(file_pos)
+    );
+    unsigned in_node_index = 0;
+    while (in_node_index < elements_cnt &&
+           elements_to_skip > children_cnts[in_node_index]) {
+      elements_to_skip -= children_cnts[in_node_index] + 1;
+      ++in_node_index;
+    }
+    if (in_node_index < elements_cnt &&
+        elements_to_skip == children_cnts[in_node_index]) {
+      return reinterpret_cast<const ElementType*>(
+          block_rw.GetNodeElementsBegPtr<ElementType, T>(file_pos)
+      )[in_node_index];
+    }
+    file_pos = reinterpret_cast<const file_pos_t*>(
+        block_rw.GetNodeLinksBegPtr<ElementType, T>(file_pos))[in_node_index];
+  }
+};
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Set(
+    size_t index,
+    const ElementType &e
+) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::SET, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
   file_pos_t file_pos = _data_info_ptr->_root_pos;
   unsigned in_node_index;
 
-  _FindElement(index, file_pos, in_node_index);
-  return *_file_manager._block_rw.template GetNodeElementPtr<ElementType,T>(
+  if (_finger_flag) {
+    _FindElementByFinger(index, file_pos, in_node_index);
+  } else {
+    _FindElement(index, file_pos, in_node_index);
+  }
+  *_file_manager._block_rw.template GetNodeElementPtr<ElementType, T>(
       file_pos,
       in_node_index
-  );
-};
+  ) = e;
+  _file_manager.MarkNodeWritten(file_pos, sizeof(ElementType));
+  _RefreshAggregates(index, index, false);
+}
+
+/*
+ * Lookups are processed in groups. Every round moves each unfinished lookup
+ * of group one level down and prefetches its next node, so by the time the
+ * round comes back to the lookup, the node is likely to be in cache.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename OutputIteratorType>
+OutputIteratorType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::GetMany(
+    std::span<const size_t> indexes,
+    OutputIteratorType out
+) {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::BATCH);
+  size_t size = Size();
+  if (std::any_of(indexes.begin(), indexes.end(),
+                  [size](size_t index) { return index >= size; })) {
+    throw std::out_of_range("list index out of range");
+  }
+  _RecordIndexes(TraceOperation::GET, indexes);
+  file_pos_t file_positions[lookups_group_size];
+  size_t elements_to_skip[lookups_group_size];
+  bool found[lookups_group_size];
+  ElementType results[lookups_group_size];
+
+  for (size_t group_start = 0; group_start < indexes.size();
+       group_start += lookups_group_size) {
+    size_t group_size =
+        std::min(lookups_group_size, indexes.size() - group_start);
+    for (size_t i = 0; i < group_size; ++i) {
+      file_positions[i] = _data_info_ptr->_root_pos;
+      elements_to_skip[i] = indexes[group_start + i];
+      found[i] = false;
+    }
+    size_t unfinished_cnt = group_size;
+    while (unfinished_cnt != 0) {
+      for (size_t i = 0; i < group_size; ++i) {
+        unsigned in_node_index;
+        if (!found[i] && _DescendInMappedNode(file_positions[i],
+                                              elements_to_skip[i],
+                                              in_node_index)) {
+          results[i] = *_file_manager._block_rw.template GetNodeElementPtr<
+              ElementType, T>(file_positions[i], in_node_index);
+          found[i] = true;
+          --unfinished_cnt;
+        }
+      }
+    }
+    for (size_t i = 0; i < group_size; ++i) {
+      *out = results[i];
+      ++out;
+    }
+  }
+  return out;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename OutputIteratorType>
+OutputIteratorType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::GetSorted(
+    std::span<const size_t> indexes,
+    OutputIteratorType out
+) const {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::BATCH);
+  _RecordIndexes(TraceOperation::GET, indexes);
+  auto visitor = [&out](const ElementType &element) {
+    *out = element;
+    ++out;
+  };
+  _VisitSorted(_file_manager, _data_info_ptr->_root_pos, indexes, 0, visitor);
+  return out;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename InputIteratorType>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::SetSorted(
+    std::span<const size_t> indexes,
+    InputIteratorType values
+) {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::BATCH);
+  _RecordIndexes(TraceOperation::SET, indexes);
+  auto visitor = [&values](ElementType &element) {
+    element = *values;
+    ++values;
+  };
+  _VisitSorted(_file_manager, _data_info_ptr->_root_pos, indexes, 0, visitor);
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    std::vector<std::pair<size_t, size_t>> touched_ranges;
+    for (size_t index: indexes) {
+      if (!touched_ranges.empty() &&
+          touched_ranges.back().second + 1 >= index) {
+        touched_ranges.back().second = index;
+      } else {
+        touched_ranges.emplace_back(index, index);
+      }
+    }
+    _RefreshAggregates(touched_ranges, false);
+  }
+}
+
+/*
+ * Operations are first moved to coordinates of the list before batch. Then
+ * edits are applied from right to left: an edit never shifts elements before
+ * it, so original index of every next edit is also its current index.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::ApplyBatch(
+    std::span<const BatchOperation> operations
+) {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::BATCH);
+  if (_recorder != nullptr && !_recorder->InsideOperation()) {
+    for (const BatchOperation &operation: operations) {
+      _recorder->Record(operation.type == BatchOperation::INSERT ?
+                            TraceOperation::INSERT :
+                        operation.type == BatchOperation::EXTRACT ?
+                            TraceOperation::EXTRACT :
+                            TraceOperation::SET,
+                        operation.index);
+    }
+  }
+  // Already recorded operation by operation.
+  TraceScope trace_scope(_recorder.get(), TraceOperation::SET, 0, 0);
+  std::vector<_BatchEdit> edits;
+  for (const BatchOperation &operation: operations) {
+    _AddBatchOperation(operation, edits);
+  }
+  size_t edits_end = edits.size();
+  while (edits_end != 0) {
+    size_t applied_cnt = _ApplyEditsToLeaf(edits, edits_end);
+    if (applied_cnt == 0) {  // Needs rebalancing or is in internal node
+      const _BatchEdit &edit = edits[edits_end - 1];
+      if (edit._inserted_flag) {
+        Insert(edit._orig_pos, edit._element);
+      } else if (edit._extracted_flag) {
+        Extract(edit._orig_pos);
+      } else {
+        Set(edit._orig_pos, edit._element);
+      }
+      applied_cnt = 1;
+    }
+    edits_end -= applied_cnt;
+  }
+}
+
+/*
+ * Bound in node is searched by binary search over its elements. Child
+ * with the same index holds elements between previous separator and this
+ * one, so the bound in whole subtree is either in this child or is the
+ * separator itself, which is the next index after the child.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::LowerBound(
+    const ElementType &value,
+    CompareType compare
+) const {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
+  return _BoundInSubtree(_data_info_ptr->_root_pos, 0, value, compare, false);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::UpperBound(
+    const ElementType &value,
+    CompareType compare
+) const {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
+  return _BoundInSubtree(_data_info_ptr->_root_pos, 0, value, compare, true);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+std::pair<size_t, size_t>
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::EqualRange(
+    const ElementType &value,
+    CompareType compare
+) const {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::ACCESS);
+  const BlockRW &block_rw = _file_manager._block_rw;
+  file_pos_t pos = _data_info_ptr->_root_pos;
+  size_t subtree_first = 0;
+  while (true) {
+    TracePolicy::OnNodeRead(pos);
+    auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+    const auto* elements = reinterpret_cast<const ElementType*>(
+        block_rw.GetNodeElementsBegPtr<ElementType, T>(pos)
+    );
+    unsigned lower_index = _BoundInNodeIndex(elements, info._elements_cnt,
+                                             value, compare, false);
+    unsigned upper_index = _BoundInNodeIndex(elements, info._elements_cnt,
+                                             value, compare, true);
+    if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+      return {subtree_first + lower_index, subtree_first + upper_index};
+    }
+    const auto* links = reinterpret_cast<const file_pos_t*>(
+        block_rw.GetNodeLinksBegPtr<ElementType, T>(pos)
+    );
+    const auto* children_cnts = reinterpret_cast<const size_t*>(
+        block_rw.GetNodeCCBegPtr<ElementType, T>(pos)
+    );
+    size_t lower_first = subtree_first + lower_index;
+    for (unsigned i = 0; i < lower_index; ++i) {
+      lower_first += children_cnts[i];
+    }
+    if (lower_index != upper_index) {  // Bounds split here
+      size_t upper_first = lower_first + (upper_index - lower_index);
+      for (unsigned i = lower_index; i < upper_index; ++i) {
+        upper_first += children_cnts[i];
+      }
+      return {_BoundInSubtree(links[lower_index], lower_first, value, compare,
+                              false),
+              _BoundInSubtree(links[upper_index], upper_first, value, compare,
+                              true)};
+    }
+    pos = links[lower_index];
+    subtree_first = lower_first;
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::InsertSorted(
+    const ElementType &e,
+    CompareType compare
+) {
+  LatencyScope latency_scope(_latencies.get(), ListOperation::INSERT);
+  _DropCachedPaths();
+  std::vector<file_pos_t> file_pos_path;
+  std::vector<unsigned> indexes_path;
+  size_t index = _FindPathToLeafByValue(e, compare, file_pos_path,
+                                        indexes_path);
+  TraceScope trace_scope(_recorder.get(), TraceOperation::INSERT, index);
+  ++_data_info_ptr->_size;
+  _InsertByPath(file_pos_path, indexes_path, e);
+  _RefreshAggregates(index, index, true);
+  return index;
+}
 
 //template <typename ElementType, size_t T>
 //ElementType BTreeList<ElementType, T>::Get(unsigned index) {
@@ -292,40 +1152,579 @@ ElementType BTreeList<ElementType, T>::operator[](unsigned index) const {
 //  return node._elements[in_node_index];
 //}
 
-template<typename ElementType, size_t T>
-ElementType BTreeList<ElementType, T>::Extract(unsigned index) {
-  --_data_info_ptr->_size;
+template<typename ElementType, size_t T, typename TracePolicy,
+         typename AggregatePolicy>
+ElementType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Extract(size_t index) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::EXTRACT, index);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::EXTRACT);
   std::vector<file_pos_t> file_pos_path;
   std::vector<unsigned> indexes_path;
 
   _FindPathByIndex(index, file_pos_path, indexes_path);
-  Node<ElementType, T> node_with_element =
+  std::vector<_FingerLevel> finger = std::move(_finger);
+  _DropCachedPaths();
+  --_data_info_ptr->_size;
+  Node<ElementType, T, AggregatePolicy> node_with_element =
       _file_manager.GetNode(file_pos_path.back());
 
   ElementType element_to_extract;
   if (node_with_element.GetIsLeaf()) {
+    uint64_t rebalances_cnt =
+        _structure_counters.merges + _structure_counters.borrows;
     element_to_extract = _ExtractFromLeaf(file_pos_path, indexes_path);
+    if (_structure_counters.merges + _structure_counters.borrows ==
+        rebalances_cnt) {
+      _RestoreFinger(std::move(finger), -1);
+    }
   } else {
     element_to_extract = node_with_element.Element(indexes_path.back());
     _FindAppropriateInLeafElement(file_pos_path, indexes_path);
     ElementType element_from_leaf = _ExtractFromLeaf(file_pos_path,
                                                      indexes_path);
-    (*this)[index] = element_from_leaf;
+    Set(index, element_from_leaf);
   }
+  _RefreshAggregates(index == 0 ? 0 : index - 1, index + 1, true);
   return element_to_extract;
 }
 
-template <typename ElementType, size_t T>
-size_t BTreeList<ElementType, T>::Size() const {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Size() const {
   return _data_info_ptr->_size;
 }
 
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::RangeAggregate(
+    size_t first,
+    size_t last
+) const requires is_aggregated_v<AggregatePolicy> {
+  if (first >= last) {
+    return AggregatePolicy::Identity();
+  }
+  return _SubtreeRangeAggregate(_data_info_ptr->_root_pos, 0, first, last);
+}
+
+/*
+ * Goes down from root keeping aggregate of everything before current
+ * subtree. Child is entered as soon as prefix with its aggregate satisfies
+ * predicate, so one node is read on every level.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename PredicateType>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::FindPrefix(
+    PredicateType predicate
+) const requires is_aggregated_v<AggregatePolicy> {
+  const BlockRW &block_rw = _file_manager._block_rw;
+  file_pos_t pos = _data_info_ptr->_root_pos;
+  size_t subtree_first = 0;
+  AggregateType prefix = AggregatePolicy::Identity();
+  while (true) {
+    auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+    const auto* elements = reinterpret_cast<const ElementType*>(
+        block_rw.GetNodeElementsBegPtr<ElementType, T>(pos)
+    );
+    if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+      for (unsigned i = 0; i < info._elements_cnt; ++i) {
+        prefix = AggregatePolicy::Combine(
+            prefix, AggregatePolicy::FromElement(elements[i]));
+        if (predicate(prefix)) {
+          return subtree_first + i;
+        }
+      }
+      return Size();
+    }
+    const auto* links = reinterpret_cast<const file_pos_t*>(
+        block_rw.GetNodeLinksBegPtr<ElementType, T>(pos)
+    );
+    const auto* children_cnts = reinterpret_cast<const size_t*>(
+        block_rw.GetNodeCCBegPtr<ElementType, T>(pos)
+    );
+    const AggregateType* aggregates = block_rw.template
+        GetNodeAggregatesBegPtr<ElementType, T, AggregatePolicy>(pos);
+    size_t child_first = subtree_first;
+    bool descended_flag = false;
+    for (unsigned i = 0; i <= info._elements_cnt && !descended_flag; ++i) {
+      AggregateType with_child =
+          AggregatePolicy::Combine(prefix, aggregates[i]);
+      if (predicate(with_child)) {
+        pos = links[i];
+        subtree_first = child_first;
+        descended_flag = true;
+      } else {
+        prefix = with_child;
+        child_first += children_cnts[i];
+        if (i < info._elements_cnt) {
+          prefix = AggregatePolicy::Combine(
+              prefix, AggregatePolicy::FromElement(elements[i]));
+          if (predicate(prefix)) {
+            return child_first;
+          }
+          ++child_first;
+        }
+      }
+    }
+    if (!descended_flag) {
+      return Size();
+    }
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::FindPrefixReaching(
+    const AggregateType &value
+) const requires is_aggregated_v<AggregatePolicy> {
+  return FindPrefix([&value](const AggregateType &prefix) {
+    return !(prefix < value);
+  });
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::SetRebuildLayout(
+    RebuildLayout layout
+) {
+  _rebuild_layout = layout;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::ReleaseFreeSpace() {
+  _file_manager.ReleaseFreeBlocks();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::Advise(AccessAdvice advice) {
+  switch (advice) {
+    case AccessAdvice::RANDOM:
+      return _file_manager.Advise(MADV_RANDOM);
+    case AccessAdvice::SEQUENTIAL:
+      return _file_manager.Advise(MADV_SEQUENTIAL);
+    default:
+      return _file_manager.Advise(MADV_NORMAL);
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::SetHugePages(bool flag_to_set) {
+  return _file_manager.SetHugePages(flag_to_set);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::PushBack(const ElementType &e) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::INSERT, Size());
+  LatencyScope latency_scope(_latencies.get(), ListOperation::INSERT);
+  const std::vector<file_pos_t> &back_path = _GetEndPath(true);
+  BlockRW &block_rw = _file_manager._block_rw;
+  auto* leaf_info = block_rw.GetNodeInfoPtr<ElementType, T>(back_path.back());
+  size_t leaf_size = leaf_info->_elements_cnt;
+  if (leaf_size + 1 >= 2 * T - 1) {
+    Insert(Size(), e);
+    return;
+  }
+  _finger.clear();
+  *block_rw.GetNodeElementPtr<ElementType, T>(back_path.back(),
+                                              leaf_size) = e;
+  *block_rw.GetNodeLinkPtr<ElementType, T>(back_path.back(),
+                                           leaf_size + 1) = 0;
+  *block_rw.GetNodeCCPtr<ElementType, T>(back_path.back(), leaf_size + 1) = 0;
+  ++leaf_info->_elements_cnt;
+  _file_manager.MarkNodeWritten(
+      back_path.back(),
+      sizeof(ElementType) + sizeof(file_pos_t) + sizeof(size_t));
+  ++_data_info_ptr->_size;
+  _ChangeEndCnts(back_path, true, 1);
+  _RefreshAggregates(Size() - 1, Size() - 1, false);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::PushFront(const ElementType &e) {
+  TraceScope trace_scope(_recorder.get(), TraceOperation::INSERT, 0);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::INSERT);
+  const std::vector<file_pos_t> &front_path = _GetEndPath(false);
+  BlockRW &block_rw = _file_manager._block_rw;
+  auto* leaf_info = block_rw.GetNodeInfoPtr<ElementType, T>(front_path.back());
+  size_t leaf_size = leaf_info->_elements_cnt;
+  if (leaf_size + 1 >= 2 * T - 1) {
+    Insert(0, e);
+    return;
+  }
+  _finger.clear();
+  ElementType* elements =
+      block_rw.GetNodeElementPtr<ElementType, T>(front_path.back(), 0);
+  std::memmove(elements + 1, elements, sizeof(ElementType) * leaf_size);
+  elements[0] = e;
+  *block_rw.GetNodeLinkPtr<ElementType, T>(front_path.back(),
+                                           leaf_size + 1) = 0;
+  *block_rw.GetNodeCCPtr<ElementType, T>(front_path.back(), leaf_size + 1) = 0;
+  ++leaf_info->_elements_cnt;
+  _file_manager.MarkNodeWritten(
+      front_path.back(),
+      sizeof(ElementType) * (leaf_size + 1) + sizeof(file_pos_t) +
+          sizeof(size_t));
+  ++_data_info_ptr->_size;
+  _ChangeEndCnts(front_path, false, 1);
+  _RefreshAggregates(0, 0, false);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::PopBack() {
+  if (Size() == 0) {
+    throw std::out_of_range("list index out of range");
+  }
+  TraceScope trace_scope(_recorder.get(), TraceOperation::EXTRACT, Size() - 1);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::EXTRACT);
+  const std::vector<file_pos_t> &back_path = _GetEndPath(true);
+  BlockRW &block_rw = _file_manager._block_rw;
+  auto* leaf_info = block_rw.GetNodeInfoPtr<ElementType, T>(back_path.back());
+  size_t leaf_size = leaf_info->_elements_cnt;
+  if (leaf_size <= (back_path.size() == 1 ? 0 : T - 1)) {
+    return Extract(Size() - 1);
+  }
+  _finger.clear();
+  --leaf_info->_elements_cnt;
+  _file_manager.MarkNodeWritten(back_path.back(),
+                                sizeof(leaf_info->_elements_cnt));
+  --_data_info_ptr->_size;
+  _ChangeEndCnts(back_path, true, -1);
+  _RefreshAggregates(Size() - 1, Size() - 1, false);
+  return *block_rw.GetNodeElementPtr<ElementType, T>(back_path.back(),
+                                                     leaf_size - 1);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::PopFront() {
+  if (Size() == 0) {
+    throw std::out_of_range("list index out of range");
+  }
+  TraceScope trace_scope(_recorder.get(), TraceOperation::EXTRACT, 0);
+  LatencyScope latency_scope(_latencies.get(), ListOperation::EXTRACT);
+  const std::vector<file_pos_t> &front_path = _GetEndPath(false);
+  BlockRW &block_rw = _file_manager._block_rw;
+  auto* leaf_info = block_rw.GetNodeInfoPtr<ElementType, T>(front_path.back());
+  size_t leaf_size = leaf_info->_elements_cnt;
+  if (leaf_size <= (front_path.size() == 1 ? 0 : T - 1)) {
+    return Extract(0);
+  }
+  _finger.clear();
+  ElementType* elements =
+      block_rw.GetNodeElementPtr<ElementType, T>(front_path.back(), 0);
+  ElementType element_to_return = elements[0];
+  std::memmove(elements, elements + 1, sizeof(ElementType) * (leaf_size - 1));
+  --leaf_info->_elements_cnt;
+  _file_manager.MarkNodeWritten(
+      front_path.back(),
+      sizeof(ElementType) * (leaf_size - 1) +
+          sizeof(leaf_info->_elements_cnt));
+  --_data_info_ptr->_size;
+  _ChangeEndCnts(front_path, false, -1);
+  _RefreshAggregates(0, 0, false);
+  return element_to_return;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::StartRecording(
+    const std::string &trace_path
+) {
+  _recorder = std::make_unique<TraceRecorder>(trace_path, sizeof(ElementType),
+                                              T);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::StopRecording() {
+  std::unique_ptr<TraceRecorder> recorder = std::move(_recorder);
+  if (recorder != nullptr) {
+    recorder->Flush();
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::SetFingerSearch(bool flag_to_set) {
+  _finger_flag = flag_to_set;
+  _finger.clear();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ListStats
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Stats() const {
+  ListStats stats;
+  _file_manager.GetCounters(stats.storage, stats.allocation);
+  stats.structure = _structure_counters;
+  if (_latencies != nullptr) {
+    std::lock_guard lock(_latencies->mutex);
+    stats.latencies = _latencies->histograms;
+  }
+  return stats;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::ResetStats() {
+  _file_manager.ResetCounters();
+  _structure_counters = StructureCounters();
+  if (_latencies != nullptr) {
+    std::lock_guard lock(_latencies->mutex);
+    for (LatencyHistogram &histogram: _latencies->histograms) {
+      histogram.Reset();
+    }
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::EnableLatencyHistograms(
+    bool flag_to_set
+) {
+  if (!flag_to_set) {
+    _latencies = nullptr;
+  } else if (_latencies == nullptr) {
+    _latencies = std::make_unique<LatencyRecorder>();
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::PinUpperLevels(unsigned levels,
+                                           bool lock_flag) {
+  _file_manager.UnpinAllBlocks();
+  _pinned_levels = levels;
+  _pinned_lock_flag = lock_flag;
+  return _RepinUpperLevels();
+}
+
+/*
+ * Window holds whole blocks, so block never lies in two windows.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::SetMemoryBudget(
+    size_t budget_bytes,
+    size_t window_bytes
+) {
+  if (budget_bytes == 0) {
+    _file_manager.SetMappingWindows(0, 0);
+    return;
+  }
+  size_t block_size = _file_manager._block_rw._block_size;
+  size_t blocks_per_window = std::max<size_t>(window_bytes / block_size, 1);
+  _file_manager.SetMappingWindows(
+      std::max<size_t>(budget_bytes / (blocks_per_window * block_size), 1),
+      blocks_per_window
+  );
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Sync() {
+  _file_manager.Sync();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Prefetch(
+    size_t first,
+    size_t last
+) {
+  last = std::min(last, Size());
+  if (first >= last) {
+    return true;
+  }
+  std::vector<file_pos_t> leaves_positions;
+  _CollectLeavesInRange(_data_info_ptr->_root_pos, first, last,
+                        leaves_positions);
+  return _file_manager.WillNeedBlocks(std::move(leaves_positions));
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ResidencyMap BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Residency(
+    size_t ranges_cnt
+) const {
+  const auto &mapped_file = *_file_manager._mapped_file_ptr;
+  std::vector<unsigned char> pages_residency;
+  ResidencyMap residency_map;
+  residency_map.pages_flag = GetPagesResidency(
+      mapped_file.const_data(), mapped_file.size(), pages_residency);
+  residency_map.file_pages_cnt =
+      (mapped_file.size() + GetFilePageSize() - 1) / GetFilePageSize();
+  for (unsigned char page_residency: pages_residency) {
+    residency_map.file_resident_pages_cnt += page_residency & 1;
+  }
+  ranges_cnt = std::max<size_t>(ranges_cnt, 1);
+  for (size_t i = 0; i < ranges_cnt; ++i) {
+    RangeResidency range;
+    range.first = Size() * i / ranges_cnt;
+    range.last = Size() * (i + 1) / ranges_cnt;
+    residency_map.ranges.push_back(range);
+  }
+  _AddSubtreeResidency(_data_info_ptr->_root_pos, 0, 0, pages_residency,
+                       residency_map);
+  residency_map.extents_flag = GetFileExtents(
+      _file_manager._file_params_ptr->path,
+      residency_map.extents
+  );
+  return residency_map;
+}
+
+/*
+ * Leftover of the last bitmap word and spare blocks are not free blocks of
+ * allocator, so everything after the free tail start counts as dead tail.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+StructureReport
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::AnalyzeStructure(
+) const {
+  StructureReport report;
+  report.size = Size();
+  size_t distances_sum = 0;
+  _AddSubtreeStructure(_data_info_ptr->_root_pos, 0, report, distances_sum);
+  report.height = report.levels.size();
+
+  size_t non_root_nodes_cnt = report.nodes_cnt - 1;
+  size_t non_root_elements_cnt = report.size - report.levels[0].elements_cnt;
+  if (non_root_nodes_cnt != 0) {
+    report.average_fill = static_cast<double>(non_root_elements_cnt) /
+        static_cast<double>(non_root_nodes_cnt * (2 * T - 2));
+    report.average_parent_child_distance =
+        static_cast<double>(distances_sum) /
+        static_cast<double>(non_root_nodes_cnt);
+  }
+
+  report.blocks = _file_manager.GetBlocksUsage();
+  report.raw_blocks_cnt = report.blocks.free_tail_start -
+                          report.blocks.free_blocks_cnt - report.nodes_cnt;
+  report.tail_blocks_cnt = report.blocks.blocks_cnt -
+                           report.blocks.free_tail_start;
+
+  size_t first_node_offset = _file_manager._block_rw._first_node_offset;
+  report.rebuild_blocks_cnt = report.nodes_cnt;
+  report.rebuild_file_size = first_node_offset +
+                             report.rebuild_blocks_cnt *
+                             report.blocks.block_size;
+  report.packed_blocks_cnt = _PackedNodesCnt(
+      report.size, _PackedHeight(report.size, 2 * T - 2), 2 * T - 2, true
+  );
+  report.packed_file_size = first_node_offset +
+                            report.packed_blocks_cnt *
+                            report.blocks.block_size;
+  return report;
+}
+
+/*
+ * Nodes are read straight from mapping, not by GetNode, so threads do not
+ * touch counters of file manager. Upper levels are checked after subtrees
+ * under them, when sizes of those subtrees are known.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+IntegrityReport BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Verify(
+    unsigned threads_cnt
+) const {
+  if (threads_cnt == 0) {
+    threads_cnt = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  IntegrityReport report;
+  const BlockRW &block_rw = _file_manager._block_rw;
+  size_t page_size = GetFilePageSize();
+  size_t mapped_size = (_file_manager._mapped_file_ptr->size() + page_size - 1)
+                       / page_size * page_size;
+  file_pos_t file_blocks_cnt =
+      (mapped_size - block_rw._first_node_offset) / block_rw._block_size;
+  _VerifyContext context;
+  context._blocks_cnt = _data_info_ptr->_free_tail_start;
+  if (context._blocks_cnt > file_blocks_cnt) {
+    AddIntegrityError(report, IntegrityError{IntegrityErrorKind::DATA_INFO,
+                                             0, context._blocks_cnt,
+                                             file_blocks_cnt});
+    context._blocks_cnt = file_blocks_cnt;
+  }
+  context._visited = std::vector<std::atomic<bool>>(context._blocks_cnt);
+  context._leaf_level = std::numeric_limits<unsigned>::max();
+
+  std::vector<file_pos_t> split_roots;
+  _CollectVerifySplit(threads_cnt * verify_tasks_per_thread, context,
+                      split_roots);
+  std::vector<size_t> split_sizes(split_roots.size());
+  std::vector<IntegrityReport> thread_reports(threads_cnt);
+  std::atomic<size_t> next_task(0);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < threads_cnt; ++i) {
+    threads.emplace_back([&, i]() {
+      for (size_t task = next_task++; task < split_roots.size();
+           task = next_task++) {
+        split_sizes[task] = _VerifySubtree(split_roots[task],
+                                           context._split_level, context,
+                                           thread_reports[i]);
+      }
+    });
+  }
+  for (auto &thread: threads) {
+    thread.join();
+  }
+  for (const IntegrityReport &thread_report: thread_reports) {
+    MergeIntegrityReports(report, thread_report);
+  }
+  for (size_t i = 0; i < split_roots.size(); ++i) {
+    context._split_sizes.emplace(split_roots[i], split_sizes[i]);
+  }
+
+  size_t elements_cnt = context._split_level == 0
+      ? context._split_sizes[_data_info_ptr->_root_pos]
+      : _VerifySubtree(_data_info_ptr->_root_pos, 0, context, report);
+  if (elements_cnt != _data_info_ptr->_size) {
+    AddIntegrityError(report, IntegrityError{IntegrityErrorKind::LIST_SIZE,
+                                             _data_info_ptr->_root_pos,
+                                             _data_info_ptr->_size,
+                                             elements_cnt});
+  }
+  return report;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Private methods                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_ResizeFromEmpty(size_t size) {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_ResizeFromEmpty(size_t size) {
   while (size != 0) {
     _AllocateBackElements(size, 0, false);
     if (size != 0) {
@@ -335,8 +1734,9 @@ void BTreeList<ElementType, T>::_ResizeFromEmpty(size_t size) {
   }
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_ResizeFromEmpty(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_ResizeFromEmpty(
     size_t size,
     const ElementType &element_to_fill
 ) {
@@ -349,16 +1749,18 @@ void BTreeList<ElementType, T>::_ResizeFromEmpty(
   }
 }
 
-template <typename ElementType, size_t T>
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
 template <typename IteratorType>
-void BTreeList<ElementType, T>::_Insert(
-    unsigned &index,
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_Insert(
+    size_t &index,
     IteratorType &begin,
     IteratorType &end
 ) {
   std::vector<file_pos_t> file_pos_path;
   std::vector<unsigned> indexes_path;
   _FindPathToLeafByIndex(index, file_pos_path, indexes_path);
+  _DropCachedPaths();
 
   file_pos_t leaf_file_pos = file_pos_path.back();
   file_pos_path.pop_back();
@@ -378,10 +1780,15 @@ void BTreeList<ElementType, T>::_Insert(
   index += elements_to_insert;
   _data_info_ptr->_size += elements_to_insert;
   _CorrectChildrenCnts(file_pos_path, indexes_path, elements_to_insert);
+  if (elements_to_insert != 0) {
+    _RefreshAggregates(index - elements_to_insert, index - 1, false);
+  }
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_AllocateBackElements(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_AllocateBackElements(
     size_t &cnt,
     const ElementType &element_to_fill,
     bool need_to_set_flag
@@ -389,6 +1796,7 @@ void BTreeList<ElementType, T>::_AllocateBackElements(
   std::vector<file_pos_t> file_pos_path;
   std::vector<unsigned> indexes_path;
   _FindPathToLeafByIndex(Size(), file_pos_path, indexes_path);
+  _DropCachedPaths();
 
   file_pos_t leaf_file_pos = file_pos_path.back();
   file_pos_path.pop_back();
@@ -401,50 +1809,692 @@ void BTreeList<ElementType, T>::_AllocateBackElements(
   } else {
     leaf_node.Resize(leaf_node.Size() + elements_to_allocate);
   }
-  _file_manager.SetNode(leaf_file_pos, leaf_node);
-  cnt -= elements_to_allocate;
-  _data_info_ptr->_size += elements_to_allocate;
-  _CorrectChildrenCnts(file_pos_path, indexes_path, elements_to_allocate);
+  _file_manager.SetNode(leaf_file_pos, leaf_node);
+  cnt -= elements_to_allocate;
+  _data_info_ptr->_size += elements_to_allocate;
+  _CorrectChildrenCnts(file_pos_path, indexes_path, elements_to_allocate);
+  if (elements_to_allocate != 0) {
+    _RefreshAggregates(Size() - elements_to_allocate, Size() - 1, false);
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_InsertByPath(
+    std::vector<file_pos_t> &file_pos_path,
+    std::vector<unsigned> &indexes_path,
+    const ElementType &e
+) {
+  ElementType element_to_insert = e;
+  file_pos_t link_after_inserted = 0;
+  file_pos_t link_before_inserted = 0;
+  size_t cc_after_inserted = 0;
+  size_t cc_before_inserted = 0;
+
+  do {
+    file_pos_t curr_file_pos = file_pos_path.back();
+    unsigned curr_innode_index = indexes_path.back();
+    file_pos_path.pop_back();
+    indexes_path.pop_back();
+
+    Node<ElementType, T, AggregatePolicy> curr_node =
+        _file_manager.GetNode(curr_file_pos);
+
+    curr_node.Insert(curr_innode_index, element_to_insert);
+    curr_node.SetLinks(curr_innode_index,
+                       link_before_inserted, link_after_inserted);
+    curr_node.SetChildrenCnts(curr_innode_index,
+                              cc_before_inserted, cc_after_inserted);
+
+    if (curr_node.Size() >= T * 2 - 1) {
+      ++_structure_counters.splits;
+      TracePolicy::OnSplit(curr_file_pos);
+      element_to_insert = curr_node.GetMiddleElement();
+      // Prepare halves
+      Node<ElementType, T, AggregatePolicy> first_half_node =
+          curr_node.NodeFromFirstHalf();
+      Node<ElementType, T, AggregatePolicy> second_half_node =
+          curr_node.NodeFromSecondHalf();
+      // Prepare links
+      link_before_inserted = curr_file_pos;
+      link_after_inserted = _file_manager.NewNode(curr_file_pos);
+      // Prepare children cnts
+      cc_before_inserted = first_half_node.GetAllChildrenCnt();
+      cc_after_inserted = second_half_node.GetAllChildrenCnt();
+      // Set halves
+      _file_manager.SetNode(link_before_inserted, first_half_node);
+      _file_manager.SetNode(link_after_inserted, second_half_node);
+      if (file_pos_path.size() < _pinned_levels) {
+        // Block not locked is still pinned, so nothing is to be undone.
+        static_cast<void>(
+            _file_manager.PinBlock(link_after_inserted, _pinned_lock_flag));
+      }
+      if (file_pos_path.empty()) { // Separated root
+        Node<ElementType, T, AggregatePolicy> new_root(
+            std::vector<ElementType>{element_to_insert},
+            std::vector<file_pos_t>{link_before_inserted, link_after_inserted},
+            std::vector<size_t>{cc_before_inserted, cc_after_inserted},
+            Node<ElementType, T>::_Flags::ROOT
+        );
+        _data_info_ptr->_root_pos = _file_manager.NewNode(new_root,
+                                                          curr_file_pos);
+        static_cast<void>(_RepinUpperLevels());
+      }
+    } else {  // Just inserted
+      _file_manager.SetNode(curr_file_pos, curr_node);
+      _CorrectChildrenCnts(file_pos_path, indexes_path, 1);
+    }
+  } while (!file_pos_path.empty());
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_FindElement(
+    size_t index,
+    file_pos_t &file_pos,
+    unsigned &index_to_operate
+) {
+  size_t elements_to_skip = index;
+  while (!_DescendInMappedNode(file_pos, elements_to_skip, index_to_operate)) {
+  }
+}
+
+/*
+ * One step of _FindElement. Reads node right from mapping (or pinned copy)
+ * without copying. Returns true if element is in node on file_pos, otherwise
+ * moves file_pos to child and prefetches it.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_DescendInMappedNode(
+    file_pos_t &file_pos,
+    size_t &elements_to_skip,
+    unsigned &in_node_index
+) {
+  TracePolicy::OnNodeRead(file_pos);
+  BlockRW &block_rw = _file_manager._block_rw;
+  size_t elements_cnt =
+      block_rw.GetNodeInfoPtr<ElementType, T>(file_pos)->_elements_cnt;
+  const size_t* children_cnts = block_rw.GetNodeCCPtr<ElementType, T>(file_pos,
+                                                                      0);
+  in_node_index = 0;
+  while (in_node_index < elements_cnt &&
+         elements_to_skip > children_cnts[in_node_index]) {
+    elements_to_skip -= children_cnts[in_node_index] + 1;
+    ++in_node_index;
+  }
+  if (in_node_index < elements_cnt &&
+      elements_to_skip == children_cnts[in_node_index]) {
+    return true;
+  }
+  file_pos = *block_rw.GetNodeLinkPtr<ElementType, T>(file_pos, in_node_index);
+  _PrefetchNode(file_pos);
+  return false;
+}
+
+/*
+ * Calls visitor for elements of subtree by sorted indexes in index order.
+ * subtree_first is index of the first element of subtree. Node is read in
+ * place in mapping, indexes are split between children by children counts.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename FileManagerType, typename VisitorType>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_VisitSorted(
+    FileManagerType &file_manager,
+    file_pos_t subtree_root_pos,
+    std::span<const size_t> indexes,
+    size_t subtree_first,
+    VisitorType &visitor
+) {
+  TracePolicy::OnNodeRead(subtree_root_pos);
+  auto &block_rw = file_manager._block_rw;
+  const auto* node_info =
+      block_rw.template GetNodeInfoPtr<ElementType, T>(subtree_root_pos);
+  size_t elements_cnt = node_info->_elements_cnt;
+  bool is_leaf = node_info->_flags & Node<ElementType, T>::_Flags::LEAF;
+  const size_t* children_cnts =
+      block_rw.template GetNodeCCPtr<ElementType, T>(subtree_root_pos, 0);
+  size_t child_first = subtree_first;
+  size_t curr = 0;
+  size_t visited_cnt = 0;  // Elements of this node.
+  for (unsigned i = 0; i <= elements_cnt && curr < indexes.size(); ++i) {
+    size_t child_last = child_first + (is_leaf ? 0 : children_cnts[i]);
+    size_t child_end = curr;
+    while (child_end < indexes.size() && indexes[child_end] < child_last) {
+      ++child_end;
+    }
+    if (child_end != curr) {
+      _VisitSorted(
+          file_manager,
+          *block_rw.template GetNodeLinkPtr<ElementType, T>(subtree_root_pos,
+                                                            i),
+          indexes.subspan(curr, child_end - curr),
+          child_first,
+          visitor
+      );
+      curr = child_end;
+    }
+    // Element after child is on child_last index
+    while (i < elements_cnt && curr < indexes.size() &&
+           indexes[curr] == child_last) {
+      visitor(*block_rw.template GetNodeElementPtr<ElementType, T>(
+          subtree_root_pos, i));
+      ++curr;
+      ++visited_cnt;
+    }
+    child_first = child_last + 1;
+  }
+  if constexpr (!std::is_const_v<FileManagerType>) {
+    if (visited_cnt != 0) {
+      file_manager.MarkNodeWritten(subtree_root_pos,
+                                   visited_cnt * sizeof(ElementType));
+    }
+  }
+}
+
+/*
+ * Adds operation to edits kept in list order. Position of operation is found
+ * by going through edits and counting inserted and extracted elements before
+ * it. Element inserted and then extracted in the same batch is forgotten.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_AddBatchOperation(
+    const BatchOperation &operation,
+    std::vector<_BatchEdit> &edits
+) {
+  // Current index minus original index for elements between edits
+  int64_t shift = 0;
+  size_t edit_index = 0;
+  bool found = false;
+  while (edit_index < edits.size() && !found) {
+    const _BatchEdit &edit = edits[edit_index];
+    size_t curr_index = edit._orig_pos + shift;
+    if (curr_index > operation.index) {
+      break;  // Untouched original element before edit
+    }
+    if (edit._inserted_flag || !edit._extracted_flag) {
+      if (curr_index == operation.index) {
+        found = true;
+      } else {
+        shift += edit._inserted_flag ? 1 : 0;
+        ++edit_index;
+      }
+    } else {
+      --shift;
+      ++edit_index;
+    }
+  }
+  size_t orig_pos = found ? edits[edit_index]._orig_pos
+                          : operation.index - shift;
+  if (operation.type == BatchOperation::INSERT) {
+    edits.insert(edits.begin() + edit_index,
+                 _BatchEdit{orig_pos, true, false, false, operation.element});
+    return;
+  }
+  if (!found) {
+    edits.insert(edits.begin() + edit_index,
+                 _BatchEdit{orig_pos, false, false, false, operation.element});
+  }
+  _BatchEdit &edit = edits[edit_index];
+  if (operation.type == BatchOperation::SET) {
+    edit._set_flag = true;
+    edit._element = operation.element;
+  } else if (edit._inserted_flag) {
+    edits.erase(edits.begin() + edit_index);
+  } else {
+    edit._extracted_flag = true;
+  }
+}
+
+/*
+ * Applies edits before edits_end from right to left while they fall into the
+ * leaf of the last one and the leaf stays in size bounds. Returns number of
+ * applied edits.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_ApplyEditsToLeaf(
+    const std::vector<_BatchEdit> &edits,
+    size_t edits_end
+) {
+  std::vector<file_pos_t> file_pos_path;
+  std::vector<unsigned> indexes_path;
+  _FindPathToLeafByIndex(edits[edits_end - 1]._orig_pos,
+                         file_pos_path, indexes_path);
+  _DropCachedPaths();
+  file_pos_t leaf_file_pos = file_pos_path.back();
+  file_pos_path.pop_back();
+  size_t leaf_first = edits[edits_end - 1]._orig_pos - indexes_path.back();
+  indexes_path.pop_back();
+
+  Node<ElementType, T, AggregatePolicy> leaf_node =
+      _file_manager.GetNode(leaf_file_pos);
+  size_t leaf_size_before = leaf_node.Size();
+  size_t applied_cnt = 0;
+  bool fits = true;
+  while (applied_cnt < edits_end && fits) {
+    const _BatchEdit &edit = edits[edits_end - 1 - applied_cnt];
+    fits = edit._orig_pos >= leaf_first;
+    unsigned in_leaf_index = edit._orig_pos - leaf_first;
+    if (edit._inserted_flag) {
+      fits = fits && leaf_node.Size() < 2 * T - 2;
+      if (fits) {
+        leaf_node.Insert(in_leaf_index, edit._element);
+      }
+    } else if (edit._extracted_flag) {
+      fits = fits && in_leaf_index < leaf_node.Size() &&
+             (leaf_node.Size() > T - 1 || leaf_node.GetIsRoot());
+      if (fits) {
+        leaf_node.Extract(in_leaf_index);
+        leaf_node.ExtractLinkBefore(in_leaf_index);
+        leaf_node.ExtractChildrenCntBefore(in_leaf_index);
+        leaf_node.ExtractAggregateBefore(in_leaf_index);
+      }
+    } else {
+      fits = fits && in_leaf_index < leaf_node.Size();
+      if (fits) {
+        leaf_node.Element(in_leaf_index) = edit._element;
+      }
+    }
+    applied_cnt += fits ? 1 : 0;
+  }
+  if (applied_cnt != 0) {
+    _file_manager.SetNode(leaf_file_pos, leaf_node);
+    int size_change = static_cast<int>(leaf_node.Size()) -
+                      static_cast<int>(leaf_size_before);
+    _data_info_ptr->_size += size_change;
+    _CorrectChildrenCnts(file_pos_path, indexes_path, size_change);
+    _RefreshAggregates(leaf_first, leaf_first + leaf_node.Size(), false);
+  }
+  return applied_cnt;
+}
+
+/*
+ * Prefetches node info and beginning of children counts, which are read
+ * first on the way down.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_PrefetchNode(
+    file_pos_t file_pos
+) const {
+  const char* block_ptr =
+      _file_manager._block_rw.template GetBlockPtr<char>(file_pos);
+  __builtin_prefetch(block_ptr);
+  for (size_t offset = 0; offset < 4 * 64; offset += 64) {
+    __builtin_prefetch(block_ptr + Node<ElementType, T>::cc_offset + offset);
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RefreshAggregates(
+    std::span<const std::pair<size_t, size_t>> touched_ranges,
+    bool neighbours_flag
+) {
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    if (!touched_ranges.empty()) {
+      _RefreshSubtreeAggregates(_data_info_ptr->_root_pos, 0, touched_ranges,
+                                _RefreshSide::RANGES, neighbours_flag);
+    }
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RefreshAggregates(
+    size_t first,
+    size_t last,
+    bool neighbours_flag
+) {
+  std::pair<size_t, size_t> touched_range(first, last);
+  _RefreshAggregates(std::span(&touched_range, 1), neighbours_flag);
+}
+
+/*
+ * Split, merge and moving of elements between neighbours only change nodes
+ * which contain touched elements and their neighbours on the same level.
+ * Neighbour on the same level is either neighbour child in the same parent
+ * or the outermost node of neighbour subtree, so neighbour children are
+ * refreshed along their spine facing touched ones. Aggregates are written
+ * in place in mapping.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_RefreshSubtreeAggregates(
+    file_pos_t subtree_root_pos,
+    size_t subtree_first,
+    std::span<const std::pair<size_t, size_t>> touched_ranges,
+    _RefreshSide side,
+    bool neighbours_flag
+) {
+  BlockRW &block_rw = _file_manager._block_rw;
+  auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(subtree_root_pos);
+  const ElementType* elements =
+      block_rw.GetNodeElementPtr<ElementType, T>(subtree_root_pos, 0);
+  AggregateType aggregate = AggregatePolicy::Identity();
+  if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+    for (unsigned i = 0; i < info._elements_cnt; ++i) {
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements[i]));
+    }
+    return aggregate;
+  }
+  const file_pos_t* links =
+      block_rw.GetNodeLinkPtr<ElementType, T>(subtree_root_pos, 0);
+  const size_t* children_cnts =
+      block_rw.GetNodeCCPtr<ElementType, T>(subtree_root_pos, 0);
+  AggregateType* aggregates = block_rw.template
+      GetNodeAggregatesBegPtr<ElementType, T, AggregatePolicy>(
+          subtree_root_pos);
+  // Whether any touched index is in [lo, hi).
+  auto is_touched = [&touched_ranges](size_t lo, size_t hi) {
+    auto range_it = std::lower_bound(
+        touched_ranges.begin(), touched_ranges.end(), lo,
+        [](const std::pair<size_t, size_t> &range, size_t index) {
+          return range.second < index;
+        });
+    return range_it != touched_ranges.end() && range_it->first < hi;
+  };
+  size_t child_first = subtree_first;
+  size_t refreshed_cnt = 0;
+  for (unsigned i = 0; i <= info._elements_cnt; ++i) {
+    size_t child_end = child_first + children_cnts[i];
+    bool refresh_flag = false;
+    _RefreshSide child_side = side;
+    if (side == _RefreshSide::LEFT_SPINE) {
+      refresh_flag = i == 0;
+    } else if (side == _RefreshSide::RIGHT_SPINE) {
+      refresh_flag = i == info._elements_cnt;
+    } else if (is_touched(child_first, child_end)) {
+      refresh_flag = true;
+    } else if (neighbours_flag) {
+      bool next_touched_flag =
+          i < info._elements_cnt &&
+          is_touched(child_end, child_end + 1 + children_cnts[i + 1]);
+      bool prev_touched_flag =
+          i > 0 && is_touched(child_first - 1 - children_cnts[i - 1],
+                              child_first);
+      refresh_flag = next_touched_flag || prev_touched_flag;
+      if (next_touched_flag && !prev_touched_flag) {
+        child_side = _RefreshSide::RIGHT_SPINE;
+      } else if (prev_touched_flag && !next_touched_flag) {
+        child_side = _RefreshSide::LEFT_SPINE;
+      }
+    }
+    if (refresh_flag) {
+      aggregates[i] = _RefreshSubtreeAggregates(links[i], child_first,
+                                                touched_ranges, child_side,
+                                                neighbours_flag);
+      ++refreshed_cnt;
+    }
+    aggregate = AggregatePolicy::Combine(aggregate, aggregates[i]);
+    if (i < info._elements_cnt) {
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements[i]));
+    }
+    child_first = child_end + 1;
+  }
+  if (refreshed_cnt != 0) {
+    _file_manager.MarkNodeWritten(subtree_root_pos,
+                                  sizeof(AggregateType) * refreshed_cnt);
+  }
+  return aggregate;
+}
+
+/*
+ * Children which lie inside [first, last) are taken from stored aggregates,
+ * only children crossing its bounds are entered.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_SubtreeRangeAggregate(
+    file_pos_t subtree_root_pos,
+    size_t subtree_first,
+    size_t first,
+    size_t last
+) const {
+  const BlockRW &block_rw = _file_manager._block_rw;
+  auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(subtree_root_pos);
+  const auto* elements = reinterpret_cast<const ElementType*>(
+      block_rw.GetNodeElementsBegPtr<ElementType, T>(subtree_root_pos)
+  );
+  AggregateType aggregate = AggregatePolicy::Identity();
+  if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+    size_t begin = std::max(first, subtree_first) - subtree_first;
+    size_t end = std::min<size_t>(last - subtree_first, info._elements_cnt);
+    for (size_t i = begin; i < end; ++i) {
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements[i]));
+    }
+    return aggregate;
+  }
+  const auto* links = reinterpret_cast<const file_pos_t*>(
+      block_rw.GetNodeLinksBegPtr<ElementType, T>(subtree_root_pos)
+  );
+  const auto* children_cnts = reinterpret_cast<const size_t*>(
+      block_rw.GetNodeCCBegPtr<ElementType, T>(subtree_root_pos)
+  );
+  const AggregateType* aggregates = block_rw.template
+      GetNodeAggregatesBegPtr<ElementType, T, AggregatePolicy>(
+          subtree_root_pos);
+  size_t child_first = subtree_first;
+  for (unsigned i = 0; i <= info._elements_cnt && child_first < last; ++i) {
+    size_t child_end = child_first + children_cnts[i];
+    if (first <= child_first && child_end <= last) {
+      aggregate = AggregatePolicy::Combine(aggregate, aggregates[i]);
+    } else if (first < child_end) {
+      aggregate = AggregatePolicy::Combine(
+          aggregate, _SubtreeRangeAggregate(links[i], child_first, first,
+                                            last));
+    }
+    if (i < info._elements_cnt && first <= child_end && child_end < last) {
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements[i]));
+    }
+    child_first = child_end + 1;
+  }
+  return aggregate;
+}
+
+/*
+ * Forgets all remembered paths. Must be called before any change of tree
+ * structure.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_DropCachedPaths() {
+  _finger.clear();
+  _back_path.clear();
+  _front_path.clear();
+}
+
+/*
+ * Writes indexes of multi-element operation to trace, runs of consecutive
+ * indexes as one record.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RecordIndexes(
+    TraceOperation operation,
+    std::span<const size_t> indexes
+) const {
+  if (_recorder == nullptr || _recorder->InsideOperation()) {
+    return;
+  }
+  size_t run_start = 0;
+  for (size_t i = 1; i <= indexes.size(); ++i) {
+    if (i == indexes.size() || indexes[i] != indexes[i - 1] + 1) {
+      _recorder->Record(operation, indexes[run_start], i - run_start);
+      run_start = i;
+    }
+  }
+}
+
+/*
+ * Returns path from root to the last (back_flag) or to the first leaf. Path
+ * is found once and then kept until tree structure changes.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+const std::vector<file_pos_t>&
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_GetEndPath(
+    bool back_flag
+) {
+  std::vector<file_pos_t> &end_path = back_flag ? _back_path : _front_path;
+  if (end_path.empty()) {
+    BlockRW &block_rw = _file_manager._block_rw;
+    file_pos_t file_pos = _data_info_ptr->_root_pos;
+    end_path.push_back(file_pos);
+    while (!(block_rw.GetNodeInfoPtr<ElementType, T>(file_pos)->_flags &
+             Node<ElementType, T>::_Flags::LEAF)) {
+      unsigned link_index = back_flag ?
+          block_rw.GetNodeInfoPtr<ElementType, T>(file_pos)->_elements_cnt : 0;
+      file_pos = *block_rw.GetNodeLinkPtr<ElementType, T>(file_pos, link_index);
+      end_path.push_back(file_pos);
+    }
+  }
+  return end_path;
 }
 
-template <typename ElementType, size_t T>
-unsigned  BTreeList<ElementType, T>::_FindInNodeIndex(
-    const Node<ElementType, T> &node,
-    int64_t &elements_to_skip
+/*
+ * Changes children counts of links to the last (back_flag) or to the first
+ * child along the path to end leaf. Only one counter of each node is written
+ * in place, nodes are not copied.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_ChangeEndCnts(
+    const std::vector<file_pos_t> &end_path,
+    bool back_flag,
+    int change
 ) {
-  unsigned in_node_index = 0;
-  while (
-      in_node_index < node.Size() &&
-      elements_to_skip -
-      static_cast<int>(node.ChildrenCntBefore(in_node_index)) - 1 >= 0
-  ) {
-    elements_to_skip -= node.ChildrenCntBefore(in_node_index) + 1;
-    ++in_node_index;
+  BlockRW &block_rw = _file_manager._block_rw;
+  for (size_t i = 0; i + 1 < end_path.size(); ++i) {
+    unsigned link_index = back_flag ?
+        block_rw.GetNodeInfoPtr<ElementType, T>(end_path[i])->_elements_cnt : 0;
+    *block_rw.GetNodeCCPtr<ElementType, T>(end_path[i], link_index) += change;
+    _file_manager.MarkNodeWritten(end_path[i], sizeof(size_t));
   }
-  return in_node_index;
 }
 
-template <typename ElementType, size_t T>
-Node<ElementType, T> BTreeList<ElementType, T>::_FindElement(
-    unsigned index,
+/*
+ * Same as _FindElement, but starts from the lowest subtree of finger path
+ * which has element with index, and updates finger path on the way down.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_FindElementByFinger(
+    size_t index,
     file_pos_t &file_pos,
     unsigned &index_to_operate
 ) {
-  bool found = false;
-  auto elements_to_skip = static_cast<int64_t>(index);
-  Node<ElementType, T> curr_node;
-  do {
-    curr_node = _file_manager.GetNode(file_pos);
-    unsigned in_node_index = _FindInNodeIndex(curr_node, elements_to_skip);
-    if (in_node_index < curr_node.Size() &&
-        elements_to_skip == curr_node.ChildrenCntBefore(in_node_index)) {
+  _TrimFinger(index, false);
+  file_pos = _finger.back()._file_pos;
+  size_t elements_to_skip = index - _finger.back()._first;
+  BlockRW &block_rw = _file_manager._block_rw;
+  while (true) {
+    TracePolicy::OnNodeRead(file_pos);
+    size_t elements_cnt =
+        block_rw.GetNodeInfoPtr<ElementType, T>(file_pos)->_elements_cnt;
+    const size_t* children_cnts =
+        block_rw.GetNodeCCPtr<ElementType, T>(file_pos, 0);
+    unsigned in_node_index = 0;
+    while (in_node_index < elements_cnt &&
+           elements_to_skip > children_cnts[in_node_index]) {
+      elements_to_skip -= children_cnts[in_node_index] + 1;
+      ++in_node_index;
+    }
+    if (in_node_index < elements_cnt &&
+        elements_to_skip == children_cnts[in_node_index]) {
       index_to_operate = in_node_index;
-      found = true;
-    } else {
-      file_pos = curr_node.LinkBefore(in_node_index);
+      return;
     }
-  } while (!found);
-  return curr_node;
+    size_t child_size = children_cnts[in_node_index];
+    file_pos = *block_rw.GetNodeLinkPtr<ElementType, T>(file_pos,
+                                                       in_node_index);
+    _finger.push_back(_FingerLevel{file_pos, index - elements_to_skip,
+                                   child_size, in_node_index});
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_TrimFinger(
+    size_t index,
+    bool end_flag
+) {
+  if (_finger.empty()) {
+    _finger.push_back(_FingerLevel{_data_info_ptr->_root_pos, 0, Size(), 0});
+  }
+  while (_finger.size() > 1 &&
+         (index < _finger.back()._first ||
+          index - _finger.back()._first >=
+              _finger.back()._size + (end_flag ? 1 : 0))) {
+    _finger.pop_back();
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_StartPathByFinger(
+    size_t index,
+    bool end_flag,
+    std::vector<file_pos_t> &file_pos_path,
+    std::vector<unsigned> &indexes_path
+) {
+  if (!_finger_flag) {
+    file_pos_path.push_back(_data_info_ptr->_root_pos);
+    return index;
+  }
+  _TrimFinger(index, end_flag);
+  for (size_t level = 0; level < _finger.size(); ++level) {
+    file_pos_path.push_back(_finger[level]._file_pos);
+    if (level != 0) {
+      indexes_path.push_back(_finger[level]._parent_index);
+    }
+  }
+  return index - _finger.back()._first;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RestoreFinger(
+    std::vector<_FingerLevel> &&finger,
+    int size_change
+) {
+  if (!_finger_flag) {
+    return;
+  }
+  _finger = std::move(finger);
+  for (_FingerLevel &level: _finger) {
+    level._size += size_change;
+  }
 }
 
 /*
@@ -462,27 +2512,145 @@ Node<ElementType, T> BTreeList<ElementType, T>::_FindElement(
  * element index from leaf which is out of range.
  */
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_FindPathToLeafByIndex(
-    unsigned index,
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_FindPathToLeafByIndex(
+    size_t index,
+    std::vector<file_pos_t> &file_pos_path,
+    std::vector<unsigned> &indexes_path
+) {
+  BlockRW &block_rw = _file_manager._block_rw;
+  size_t elements_to_skip = _StartPathByFinger(index, true, file_pos_path,
+                                               indexes_path);
+  while (true) {
+    file_pos_t curr_file_pos = file_pos_path.back();
+    TracePolicy::OnNodeRead(curr_file_pos);
+    auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(curr_file_pos);
+    const size_t* children_cnts =
+        block_rw.GetNodeCCPtr<ElementType, T>(curr_file_pos, 0);
+    unsigned in_node_index = 0;
+    while (in_node_index < info._elements_cnt &&
+           elements_to_skip > children_cnts[in_node_index]) {
+      elements_to_skip -= children_cnts[in_node_index] + 1;
+      ++in_node_index;
+    }
+    indexes_path.push_back(in_node_index);
+    if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+      return;
+    }
+    file_pos_path.push_back(
+        *block_rw.GetNodeLinkPtr<ElementType, T>(curr_file_pos, in_node_index));
+    if (_finger_flag) {
+      _finger.push_back(_FingerLevel{file_pos_path.back(),
+                                     index - elements_to_skip,
+                                     children_cnts[in_node_index],
+                                     in_node_index});
+    }
+  }
+}
+
+/*
+ * Binary search inside one node, elements of node are sorted by compare.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+unsigned
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_BoundInNodeIndex(
+    const ElementType* elements,
+    unsigned elements_cnt,
+    const ElementType &value,
+    CompareType &compare,
+    bool upper_flag
+) {
+  const ElementType* bound =
+      upper_flag ?
+      std::upper_bound(elements, elements + elements_cnt, value, compare) :
+      std::lower_bound(elements, elements + elements_cnt, value, compare);
+  return static_cast<unsigned>(bound - elements);
+}
+
+/*
+ * Descends from subtree_root_pos to leaf by bound in each node and sums
+ * skipped children counts. Returns index of bound in whole list, subtree_first
+ * is index of the first element of subtree.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_BoundInSubtree(
+    file_pos_t subtree_root_pos,
+    size_t subtree_first,
+    const ElementType &value,
+    CompareType &compare,
+    bool upper_flag
+) const {
+  const BlockRW &block_rw = _file_manager._block_rw;
+  file_pos_t pos = subtree_root_pos;
+  while (true) {
+    TracePolicy::OnNodeRead(pos);
+    auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+    const auto* elements = reinterpret_cast<const ElementType*>(
+        block_rw.GetNodeElementsBegPtr<ElementType, T>(pos)
+    );
+    unsigned in_node_index = _BoundInNodeIndex(elements, info._elements_cnt,
+                                               value, compare, upper_flag);
+    subtree_first += in_node_index;
+    if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+      return subtree_first;
+    }
+    const auto* children_cnts = reinterpret_cast<const size_t*>(
+        block_rw.GetNodeCCBegPtr<ElementType, T>(pos)
+    );
+    for (unsigned i = 0; i < in_node_index; ++i) {
+      subtree_first += children_cnts[i];
+    }
+    pos = reinterpret_cast<const file_pos_t*>(
+        block_rw.GetNodeLinksBegPtr<ElementType, T>(pos))[in_node_index];
+  }
+}
+
+/*
+ * Same descent as _BoundInSubtree by upper bound, but records the path for
+ * insertion like _FindPathToLeafByIndex.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+template <typename CompareType>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_FindPathToLeafByValue(
+    const ElementType &value,
+    CompareType &compare,
     std::vector<file_pos_t> &file_pos_path,
     std::vector<unsigned> &indexes_path
 ) {
+  BlockRW &block_rw = _file_manager._block_rw;
   file_pos_t curr_file_pos = _data_info_ptr->_root_pos;
-  file_pos_path.push_back(curr_file_pos);
-  bool found = false;
-  auto elements_to_skip = static_cast<int64_t>(index);
-  do {
-    Node<ElementType, T> curr_node = _file_manager.GetNode(curr_file_pos);
-    unsigned in_node_index = _FindInNodeIndex(curr_node, elements_to_skip);
+  size_t subtree_first = 0;
+  while (true) {
+    TracePolicy::OnNodeRead(curr_file_pos);
+    file_pos_path.push_back(curr_file_pos);
+    auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(curr_file_pos);
+    unsigned in_node_index = _BoundInNodeIndex(
+        block_rw.GetNodeElementPtr<ElementType, T>(curr_file_pos, 0),
+        info._elements_cnt, value, compare, true);
     indexes_path.push_back(in_node_index);
-    if (!curr_node.GetIsLeaf()) {
-      curr_file_pos = curr_node._links[in_node_index];
-      file_pos_path.push_back(curr_file_pos);
-    } else {  // Gained leaf
-      found = true;
+    subtree_first += in_node_index;
+    if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0) {
+      return subtree_first;
     }
-  } while (!found);
+    const size_t* children_cnts =
+        block_rw.GetNodeCCPtr<ElementType, T>(curr_file_pos, 0);
+    for (unsigned i = 0; i < in_node_index; ++i) {
+      subtree_first += children_cnts[i];
+    }
+    curr_file_pos = *block_rw.GetNodeLinkPtr<ElementType, T>(curr_file_pos,
+                                                            in_node_index);
+  }
 }
 
 /*
@@ -490,44 +2658,59 @@ void BTreeList<ElementType, T>::_FindPathToLeafByIndex(
  * Gets file pos as hint to start searching from it.
  */
 
-template <typename ElementType, size_t T>
-Node<ElementType, T> BTreeList<ElementType, T>::_FindPathByIndex(
-    unsigned index,
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_FindPathByIndex(
+    size_t index,
     std::vector<file_pos_t> &file_pos_path,
     std::vector<unsigned> &indexes_path
 ) {
-  file_pos_t curr_file_pos = _data_info_ptr->_root_pos;
-  file_pos_path.push_back(curr_file_pos);
-  bool found = false;
-  auto elements_to_skip = static_cast<int64_t>(index);
-  Node<ElementType, T> curr_node;
-  do {
-    curr_node = _file_manager.GetNode(curr_file_pos);
-    unsigned in_node_index = _FindInNodeIndex(curr_node, elements_to_skip);
+  BlockRW &block_rw = _file_manager._block_rw;
+  size_t elements_to_skip = _StartPathByFinger(index, false, file_pos_path,
+                                               indexes_path);
+  while (true) {
+    file_pos_t curr_file_pos = file_pos_path.back();
+    TracePolicy::OnNodeRead(curr_file_pos);
+    size_t elements_cnt =
+        block_rw.GetNodeInfoPtr<ElementType, T>(curr_file_pos)->_elements_cnt;
+    const size_t* children_cnts =
+        block_rw.GetNodeCCPtr<ElementType, T>(curr_file_pos, 0);
+    unsigned in_node_index = 0;
+    while (in_node_index < elements_cnt &&
+           elements_to_skip > children_cnts[in_node_index]) {
+      elements_to_skip -= children_cnts[in_node_index] + 1;
+      ++in_node_index;
+    }
     indexes_path.push_back(in_node_index);
-    if (
-        in_node_index < curr_node.Size() &&
-        elements_to_skip == curr_node.ChildrenCntBefore(in_node_index)
-    ) {
-      found = true;
-    } else {
-      curr_file_pos = curr_node.LinkBefore(in_node_index);
-      file_pos_path.push_back(curr_file_pos);
+    if (in_node_index < elements_cnt &&
+        elements_to_skip == children_cnts[in_node_index]) {
+      return;
     }
-  } while (!found);
-  return curr_node;
+    file_pos_path.push_back(
+        *block_rw.GetNodeLinkPtr<ElementType, T>(curr_file_pos, in_node_index));
+    if (_finger_flag) {
+      _finger.push_back(_FingerLevel{file_pos_path.back(),
+                                     index - elements_to_skip,
+                                     children_cnts[in_node_index],
+                                     in_node_index});
+    }
+  }
 }
 
 /*
  * Changes parameters to element to extract from leaf.
  */
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_FindAppropriateInLeafElement(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_FindAppropriateInLeafElement(
     std::vector<file_pos_t> &file_pos_path,
     std::vector<unsigned> &indexes_path
 ) {
-  Node<ElementType, T> curr_node = _file_manager.GetNode(file_pos_path.back());
+  Node<ElementType, T, AggregatePolicy> curr_node =
+      _file_manager.GetNode(file_pos_path.back());
   ++indexes_path.back();
   file_pos_path.push_back(curr_node.LinkBefore(indexes_path.back()));
   indexes_path.push_back(0);
@@ -539,8 +2722,10 @@ void BTreeList<ElementType, T>::_FindAppropriateInLeafElement(
   }
 }
 
-template <typename ElementType, size_t T>
-ElementType BTreeList<ElementType, T>::_ExtractFromLeaf(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_ExtractFromLeaf(
     std::vector<file_pos_t> &file_pos_path,
     std::vector<unsigned> &indexes_path
 ) {
@@ -549,14 +2734,16 @@ ElementType BTreeList<ElementType, T>::_ExtractFromLeaf(
   file_pos_path.pop_back();
   indexes_path.pop_back();
 
-  Node<ElementType, T> curr_node = _file_manager.GetNode(curr_file_pos);
+  Node<ElementType, T, AggregatePolicy> curr_node =
+      _file_manager.GetNode(curr_file_pos);
 
   ElementType element_to_return = curr_node.Extract(in_node_index);
   curr_node.ExtractLinkBefore(in_node_index);
   curr_node.ExtractChildrenCntBefore(in_node_index);
+  curr_node.ExtractAggregateBefore(in_node_index);
   _file_manager.SetNode(curr_file_pos, curr_node);
 
-  auto parent_node = Node<ElementType, T>();
+  auto parent_node = Node<ElementType, T, AggregatePolicy>();
 
   bool finished = false;
   while (!file_pos_path.empty() && !finished) {
@@ -571,13 +2758,15 @@ ElementType BTreeList<ElementType, T>::_ExtractFromLeaf(
     curr_node = parent_node;
   }
   _CorrectChildrenCnts(file_pos_path, indexes_path, -1);
-  Node<ElementType, T> root = _file_manager.GetNode(_data_info_ptr->_root_pos);
-  if (root.Size() == 0) {
+  Node<ElementType, T, AggregatePolicy> root =
+      _file_manager.GetNode(_data_info_ptr->_root_pos);
+  if (root.Size() == 0 && !root.GetIsLeaf()) {
     _file_manager.DeleteNode(_data_info_ptr->_root_pos);
     _data_info_ptr->_root_pos = root.LinkBefore(0);
     root =  _file_manager.GetNode(_data_info_ptr->_root_pos);
     root.SetIsRoot(true);
     _file_manager.SetNode(_data_info_ptr->_root_pos, root);
+    static_cast<void>(_RepinUpperLevels());
   }
   return element_to_return;
 }
@@ -589,10 +2778,12 @@ ElementType BTreeList<ElementType, T>::_ExtractFromLeaf(
  * Nodes are expected to be opened.
  */
 
-template <typename ElementType, size_t T>
-bool BTreeList<ElementType, T>::_CorrectNodeOnExtract(
-    Node<ElementType, T> &node,
-    Node<ElementType, T> &parent_node,
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_CorrectNodeOnExtract(
+    Node<ElementType, T, AggregatePolicy> &node,
+    Node<ElementType, T, AggregatePolicy> &parent_node,
     file_pos_t file_pos,
     file_pos_t parent_file_pos,
     unsigned in_parent_index
@@ -620,31 +2811,41 @@ bool BTreeList<ElementType, T>::_CorrectNodeOnExtract(
   // in_parent_index is now an index of element between
   // node and neighbour_node in parent
 
-  Node<ElementType, T> neighbour_node =
+  Node<ElementType, T, AggregatePolicy> neighbour_node =
       _file_manager.GetNode(neighbour_node_file_pos);
 
   if (neighbour_node.Size() == T - 1) {  // connect
-    Node<ElementType, T> connected_node;
+    ++_structure_counters.merges;
+    Node<ElementType, T, AggregatePolicy> connected_node;
     if (with_left) {
       connected_node =
           Connect(neighbour_node, node, parent_node.Extract(in_parent_index));
       parent_node.ExtractLinkBefore(in_parent_index);
       parent_node.ExtractChildrenCntBefore(in_parent_index);
+      parent_node.ExtractAggregateBefore(in_parent_index);
     } else {  // with right
       connected_node =
           Connect(node, neighbour_node, parent_node.Extract(in_parent_index));
       parent_node.ExtractLinkAfter(in_parent_index);
       parent_node.ExtractChildrenCntAfter(in_parent_index);
+      parent_node.ExtractAggregateAfter(in_parent_index);
     }
     parent_node.ChildrenCntBefore(in_parent_index) =
         connected_node.GetAllChildrenCnt();
-    _file_manager.DeleteNode(neighbour_node_file_pos);
-    _file_manager.SetNode(file_pos, connected_node);
+    // Keep connected node in the lower block, so blocks near the end of file
+    // become free and file can be cut.
+    file_pos_t connected_node_file_pos =
+        std::min(file_pos, neighbour_node_file_pos);
+    parent_node.LinkBefore(in_parent_index) = connected_node_file_pos;
+    TracePolicy::OnMerge(connected_node_file_pos);
+    _file_manager.DeleteNode(std::max(file_pos, neighbour_node_file_pos));
+    _file_manager.SetNode(connected_node_file_pos, connected_node);
     if (parent_node.Size() >= T - 1 || parent_node.GetIsRoot()) {
       _file_manager.SetNode(parent_file_pos, parent_node);
       finished = true;
     }
   } else {  // move element
+    ++_structure_counters.borrows;
     if (with_left) {
       _MoveElementFromLeftNeighbour(node, neighbour_node, parent_node, in_parent_index);
     } else {  // with right
@@ -658,16 +2859,21 @@ bool BTreeList<ElementType, T>::_CorrectNodeOnExtract(
   return finished;
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_MoveElementFromLeftNeighbour(
-    Node<ElementType, T> &node,
-    Node<ElementType, T> &neighbour_node,
-    Node<ElementType, T> &parent_node,
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_MoveElementFromLeftNeighbour(
+    Node<ElementType, T, AggregatePolicy> &node,
+    Node<ElementType, T, AggregatePolicy> &neighbour_node,
+    Node<ElementType, T, AggregatePolicy> &parent_node,
     unsigned &in_parent_index
 ) {
   ElementType element_from_neighbour = neighbour_node.ExtractBack();
   file_pos_t link_from_neighbour = neighbour_node.ExtractBackLink();
   size_t cc_from_neighbour = neighbour_node.ExtractBackChildrenCnt();
+  AggregateType aggregate_from_neighbour =
+      neighbour_node.ExtractBackAggregate();
   ElementType element_from_parent =
       parent_node.Element(in_parent_index);
   node.Insert(0, element_from_parent);
@@ -675,6 +2881,10 @@ void BTreeList<ElementType, T>::_MoveElementFromLeftNeighbour(
   node.LinkBefore(0) = link_from_neighbour;
   node.ChildrenCntAfter(0) = node.ChildrenCntBefore(0);
   node.ChildrenCntBefore(0) = cc_from_neighbour;
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    node.AggregateAfter(0) = node.AggregateBefore(0);
+    node.AggregateBefore(0) = aggregate_from_neighbour;
+  }
 
   parent_node.Element(in_parent_index) = element_from_neighbour;
   parent_node.SetChildrenCnts(in_parent_index,
@@ -682,20 +2892,28 @@ void BTreeList<ElementType, T>::_MoveElementFromLeftNeighbour(
                               node.GetAllChildrenCnt());
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_MoveElementFromRightNeighbour(
-    Node<ElementType, T> &node,
-    Node<ElementType, T> &neighbour_node,
-    Node<ElementType, T> &parent_node,
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_MoveElementFromRightNeighbour(
+    Node<ElementType, T, AggregatePolicy> &node,
+    Node<ElementType, T, AggregatePolicy> &neighbour_node,
+    Node<ElementType, T, AggregatePolicy> &parent_node,
     unsigned &in_parent_index
 ) {
   ElementType element_from_neighbour = neighbour_node.Extract(0);
   file_pos_t link_from_neighbour = neighbour_node.ExtractLinkBefore(0);
   size_t cc_from_neighbour = neighbour_node.ExtractChildrenCntBefore(0);
+  AggregateType aggregate_from_neighbour =
+      neighbour_node.ExtractAggregateBefore(0);
   ElementType element_from_parent = parent_node.Element(in_parent_index);
   node.PushBack(element_from_parent);
   node.LinkAfter(node.Size() - 1) = link_from_neighbour;
   node.ChildrenCntAfter(node.Size() - 1) = cc_from_neighbour;
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    node.AggregateAfter(node.Size() - 1) = aggregate_from_neighbour;
+  }
 
   parent_node.Element(in_parent_index) = element_from_neighbour;
   parent_node.SetChildrenCnts(in_parent_index,
@@ -703,14 +2921,16 @@ void BTreeList<ElementType, T>::_MoveElementFromRightNeighbour(
                               neighbour_node.GetAllChildrenCnt());
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_CorrectChildrenCnts(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_CorrectChildrenCnts(
     std::vector<file_pos_t> &file_pos_path,
     std::vector<unsigned> &in_node_indexes_path,
     int to_change
 ) {
   while (!file_pos_path.empty()) {
-    Node<ElementType, T> node_to_correct =
+    Node<ElementType, T, AggregatePolicy> node_to_correct =
         _file_manager.GetNode(file_pos_path.back());
     node_to_correct.ChildrenCntBefore(in_node_indexes_path.back()) +=
         to_change;
@@ -720,44 +2940,726 @@ void BTreeList<ElementType, T>::_CorrectChildrenCnts(
   }
 }
 
-template <typename ElementType, size_t T>
-void BTreeList<ElementType, T>::_Rebuild() {
-  std::string restored_name = _file_manager._file_params_ptr->path;
-  std::shared_ptr<DataInfo> new_data_info_ptr(std::make_shared<DataInfo>());
-  new_data_info_ptr->_root_pos = 0;
-  new_data_info_ptr->_size = _data_info_ptr->_size;
-  new_data_info_ptr->_stack_head_pos = -1;
-  new_data_info_ptr->_free_tail_start = _data_info_ptr->_size;
-  FileSavingManager<ElementType, T> new_file_manager("data_tmp", new_data_info_ptr);
-  file_pos_t last_added_node_pos = 0;
-  file_pos_t curr_pos = 0;
-  new_file_manager.SetNode(curr_pos, _file_manager.GetNode(_data_info_ptr->_root_pos));
-  do {
-    Node<ElementType, T> curr_node = new_file_manager.GetNode(curr_pos);
+/*
+ * Returns number of levels. All leaves are on the same level, so it is enough
+ * to go down by the leftmost links.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+unsigned BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_Height() {
+  unsigned height = 1;
+  Node<ElementType, T, AggregatePolicy> curr_node =
+      _file_manager.GetNode(_data_info_ptr->_root_pos);
+  while (!curr_node.GetIsLeaf()) {
+    curr_node = _file_manager.GetNode(curr_node.LinkBefore(0));
+    ++height;
+  }
+  return height;
+}
+
+/*
+ * Leaf is counted in range of its first element. Pages of a block are found
+ * by its offset in mapping, blocks are page aligned.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_AddSubtreeResidency(
+    file_pos_t subtree_root_pos,
+    unsigned level,
+    size_t subtree_first,
+    const std::vector<unsigned char> &pages_residency,
+    ResidencyMap &residency_map
+) const {
+  const BlockRW &block_rw = _file_manager._block_rw;
+  size_t page_size = GetFilePageSize();
+  size_t first_page = (block_rw._first_node_offset +
+                       subtree_root_pos * block_rw._block_size) / page_size;
+  size_t pages_cnt = block_rw._block_size / page_size;
+  size_t resident_pages_cnt = 0;
+  for (size_t page = first_page;
+       page < first_page + pages_cnt && page < pages_residency.size(); ++page) {
+    resident_pages_cnt += pages_residency[page] & 1;
+  }
+  if (residency_map.levels.size() <= level) {
+    residency_map.levels.resize(level + 1);
+  }
+  LevelResidency &level_residency = residency_map.levels[level];
+  ++level_residency.nodes_cnt;
+  level_residency.pages_cnt += pages_cnt;
+  level_residency.resident_pages_cnt += resident_pages_cnt;
+
+  Node<ElementType, T, AggregatePolicy> node =
+      _file_manager.GetNode(subtree_root_pos);
+  if (node.GetIsLeaf()) {
+    size_t ranges_cnt = residency_map.ranges.size();
+    size_t range_index = Size() == 0 ? 0 : subtree_first * ranges_cnt / Size();
+    RangeResidency &range = residency_map.ranges[range_index];
+    ++range.leaves_cnt;
+    range.pages_cnt += pages_cnt;
+    range.resident_pages_cnt += resident_pages_cnt;
+    return;
+  }
+  size_t child_first = subtree_first;
+  for (unsigned i = 0; i < node.Size() + 1; ++i) {
+    _AddSubtreeResidency(node.LinkBefore(i), level + 1, child_first,
+                         pages_residency, residency_map);
+    child_first += node.ChildrenCntBefore(i) + 1;
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_AddSubtreeStructure(
+    file_pos_t subtree_root_pos,
+    unsigned level,
+    StructureReport &report,
+    size_t &distances_sum
+) const {
+  Node<ElementType, T, AggregatePolicy> node =
+      _file_manager.GetNode(subtree_root_pos);
+  if (report.levels.size() <= level) {
+    report.levels.resize(level + 1);
+  }
+  ++report.levels[level].nodes_cnt;
+  report.levels[level].elements_cnt += node.Size();
+  ++report.nodes_cnt;
+  if (level != 0) {
+    if (node.Size() < T - 1) {
+      ++report.underfull_nodes_cnt;
+    } else if (node.Size() > 2 * T - 2) {
+      ++report.overfull_nodes_cnt;
+    } else {
+      ++report.fill_histogram[(node.Size() - (T - 1)) * fill_buckets_cnt / T];
+    }
+  }
+  if (node.GetIsLeaf()) {
+    return;
+  }
+  for (unsigned i = 0; i < node.Size() + 1; ++i) {
+    file_pos_t child_pos = node.LinkBefore(i);
+    distances_sum += child_pos > subtree_root_pos
+                     ? child_pos - subtree_root_pos
+                     : subtree_root_pos - child_pos;
+    _AddSubtreeStructure(child_pos, level + 1, report, distances_sum);
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_CollectVerifySplit(
+    unsigned tasks_cnt,
+    _VerifyContext &context,
+    std::vector<file_pos_t> &split_roots
+) const {
+  const BlockRW &block_rw = _file_manager._block_rw;
+  context._split_level = 0;
+  split_roots = {_data_info_ptr->_root_pos};
+  // Level limit stops on cycles of links.
+  bool stop_flag = false;
+  while (!stop_flag && split_roots.size() < tasks_cnt &&
+         context._split_level < max_verify_split_level) {
+    std::vector<file_pos_t> next_level;
+    for (file_pos_t pos: split_roots) {
+      if (pos >= context._blocks_cnt) {
+        stop_flag = true;  // Bad link is reported by subtree check.
+        break;
+      }
+      auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+      if ((info._flags & Node<ElementType, T>::_Flags::LEAF) != 0 ||
+          info._elements_cnt > 2 * T - 1) {
+        stop_flag = true;
+        break;
+      }
+      const auto* links = reinterpret_cast<const file_pos_t*>(
+          block_rw.GetNodeLinksBegPtr<ElementType, T>(pos)
+      );
+      next_level.insert(next_level.end(), links,
+                        links + info._elements_cnt + 1);
+    }
+    if (!stop_flag) {
+      split_roots = std::move(next_level);
+      ++context._split_level;
+    }
+  }
+  std::sort(split_roots.begin(), split_roots.end());
+}
+
+/*
+ * Children are checked in order of their blocks, so reads go forward in
+ * file. Parent sums real sizes of children, so one broken count does not
+ * make counts of all its ancestors wrong.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_VerifySubtree(
+    file_pos_t subtree_root_pos,
+    unsigned level,
+    _VerifyContext &context,
+    IntegrityReport &report
+) const {
+  if (subtree_root_pos >= context._blocks_cnt) {
+    AddIntegrityError(report, IntegrityError{IntegrityErrorKind::BAD_LINK,
+                                             subtree_root_pos,
+                                             subtree_root_pos,
+                                             context._blocks_cnt});
+    return 0;
+  }
+  if (_file_manager.IsFreeBlock(subtree_root_pos)) {
+    AddIntegrityError(report, IntegrityError{
+        IntegrityErrorKind::FREE_BLOCK_REACHABLE, subtree_root_pos, 1, 0
+    });
+    return 0;
+  }
+  if (context._visited[subtree_root_pos].exchange(true)) {
+    AddIntegrityError(report, IntegrityError{
+        IntegrityErrorKind::BLOCK_REACHED_TWICE, subtree_root_pos, 2, 1
+    });
+    return 0;
+  }
+  ++report.nodes_cnt;
+
+  const BlockRW &block_rw = _file_manager._block_rw;
+  auto info = *block_rw.GetNodeInfoPtr<ElementType, T>(subtree_root_pos);
+  bool is_root = level == 0;
+  bool is_leaf = (info._flags & Node<ElementType, T>::_Flags::LEAF) != 0;
+  if (((info._flags & Node<ElementType, T>::_Flags::ROOT) != 0) != is_root) {
+    AddIntegrityError(report, IntegrityError{IntegrityErrorKind::FLAGS,
+                                             subtree_root_pos, info._flags,
+                                             is_root});
+  }
+  size_t min_size = is_root ? (is_leaf ? 0 : 1) : T - 1;
+  if (info._elements_cnt < min_size || info._elements_cnt > 2 * T - 2) {
+    AddIntegrityError(report, IntegrityError{
+        IntegrityErrorKind::NODE_SIZE, subtree_root_pos, info._elements_cnt,
+        info._elements_cnt < min_size ? min_size : 2 * T - 2
+    });
+    // Links of such node can not be read.
+    if (info._elements_cnt > 2 * T - 1) {
+      return 0;
+    }
+  }
+  if (is_leaf) {
+    unsigned leaf_level = std::numeric_limits<unsigned>::max();
+    if (!context._leaf_level.compare_exchange_strong(leaf_level, level) &&
+        leaf_level != level) {
+      AddIntegrityError(report, IntegrityError{IntegrityErrorKind::LEAF_DEPTH,
+                                               subtree_root_pos, level,
+                                               leaf_level});
+    }
+    return info._elements_cnt;
+  }
+
+  const auto* links = reinterpret_cast<const file_pos_t*>(
+      block_rw.GetNodeLinksBegPtr<ElementType, T>(subtree_root_pos)
+  );
+  const auto* children_cnts = reinterpret_cast<const size_t*>(
+      block_rw.GetNodeCCBegPtr<ElementType, T>(subtree_root_pos)
+  );
+  std::vector<unsigned> order(info._elements_cnt + 1);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [links](unsigned lhs, unsigned rhs) {
+    return links[lhs] < links[rhs];
+  });
+  size_t subtree_size = info._elements_cnt;
+  for (unsigned i: order) {
+    size_t child_size;
+    auto split_it = context._split_sizes.find(links[i]);
+    if (level + 1 == context._split_level &&
+        split_it != context._split_sizes.end()) {
+      child_size = split_it->second;
+    } else {
+      child_size = _VerifySubtree(links[i], level + 1, context, report);
+    }
+    if (children_cnts[i] != child_size) {
+      AddIntegrityError(report, IntegrityError{
+          IntegrityErrorKind::CHILDREN_CNT, links[i], children_cnts[i],
+          child_size
+      });
+    }
+    subtree_size += child_size;
+  }
+  return subtree_size;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_BFSOrder(
+    std::vector<file_pos_t> &order
+) {
+  std::queue<file_pos_t> positions_queue;
+  positions_queue.push(_data_info_ptr->_root_pos);
+  while (!positions_queue.empty()) {
+    file_pos_t curr_pos = positions_queue.front();
+    positions_queue.pop();
+    order.push_back(curr_pos);
+    Node<ElementType, T, AggregatePolicy> curr_node =
+        _file_manager.GetNode(curr_pos);
     if (!curr_node.GetIsLeaf()) {
       for (unsigned i = 0; i < curr_node.Size() + 1; ++i) {
-        Node<ElementType, T> node_to_copy =
-            _file_manager.GetNode(curr_node.LinkBefore(i));
-        file_pos_t pos_to_set_node = new_file_manager.NewNode(node_to_copy);
-        ++last_added_node_pos;
-        curr_node.LinkBefore(i) = pos_to_set_node;
+        positions_queue.push(curr_node.LinkBefore(i));
+      }
+    }
+  }
+}
+
+/*
+ * Appends positions of subtree with height levels in van Emde Boas order:
+ * upper height / 2 levels are laid out recursively first, then every subtree
+ * hanging below them is laid out recursively one after another.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_VanEmdeBoasOrder(
+    file_pos_t subtree_root_pos,
+    unsigned height,
+    std::vector<file_pos_t> &order
+) {
+  if (height == 1) {
+    order.push_back(subtree_root_pos);
+    return;
+  }
+  unsigned top_height = height / 2;
+  _VanEmdeBoasOrder(subtree_root_pos, top_height, order);
+
+  std::vector<file_pos_t> bottom_roots{subtree_root_pos};
+  for (unsigned level = 0; level < top_height; ++level) {
+    std::vector<file_pos_t> next_level;
+    for (file_pos_t pos: bottom_roots) {
+      Node<ElementType, T, AggregatePolicy> curr_node =
+          _file_manager.GetNode(pos);
+      for (unsigned i = 0; i < curr_node.Size() + 1; ++i) {
+        next_level.push_back(curr_node.LinkBefore(i));
+      }
+    }
+    bottom_roots = std::move(next_level);
+  }
+  for (file_pos_t pos: bottom_roots) {
+    _VanEmdeBoasOrder(pos, height - top_height, order);
+  }
+}
+
+/*
+ * Copies all nodes to new file in order chosen by _rebuild_layout, so
+ * new file has no free blocks. Root is always placed first.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_Rebuild() {
+  std::vector<file_pos_t> order;
+  if (_rebuild_layout == RebuildLayout::VAN_EMDE_BOAS) {
+    _VanEmdeBoasOrder(_data_info_ptr->_root_pos, _Height(), order);
+  } else {
+    _BFSOrder(order);
+  }
+  std::unordered_map<file_pos_t, file_pos_t> new_positions;
+  for (file_pos_t i = 0; i < order.size(); ++i) {
+    new_positions[order[i]] = i;
+  }
+
+  std::string restored_name = _file_manager._file_params_ptr->path;
+  std::shared_ptr<DataInfo> new_data_info_ptr(std::make_shared<DataInfo>());
+  FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>
+      new_file_manager(restored_name + ".tmp", new_data_info_ptr, true);
+  // Root is created by manager on position 0.
+  for (file_pos_t i = 0; i < order.size(); ++i) {
+    Node<ElementType, T, AggregatePolicy> node_to_copy =
+        _file_manager.GetNode(order[i]);
+    if (!node_to_copy.GetIsLeaf()) {
+      for (unsigned j = 0; j < node_to_copy.Size() + 1; ++j) {
+        node_to_copy.LinkBefore(j) = new_positions[node_to_copy.LinkBefore(j)];
       }
-      new_file_manager.SetNode(curr_pos, curr_node);
     }
-    ++curr_pos;
-  } while (curr_pos < last_added_node_pos);
+    if (i == 0) {
+      new_file_manager.SetNode(new_data_info_ptr->_root_pos, node_to_copy);
+    } else {
+      new_file_manager.NewNode(node_to_copy);
+    }
+  }
+  new_data_info_ptr->_size = _data_info_ptr->_size;
   _file_manager = new_file_manager;
   std::filesystem::remove(restored_name);
   _file_manager.RenameMappedFile(restored_name);
   _data_info_ptr = new_data_info_ptr;
 }
 
-template <typename ElementType, size_t T>
-BTreeList<ElementType, T>::~BTreeList<ElementType, T>() {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::Rebuild(
+    const std::string &target_path,
+    double fill_factor
+) const {
+  // Manager of target file removes it first, that would unlink mapped file.
+  if (std::filesystem::exists(target_path) &&
+      std::filesystem::equivalent(target_path,
+                                  _file_manager._file_params_ptr->path)) {
+    throw std::invalid_argument("rebuild target is the list file: " +
+                                target_path);
+  }
+  auto node_size = static_cast<size_t>(fill_factor * (2 * T - 2) + 0.5);
+  node_size = std::clamp(node_size, T - 1, 2 * T - 2);
+  size_t elements_cnt = Size();
+  unsigned height = _PackedHeight(elements_cnt, node_size);
+
+  std::shared_ptr<DataInfo> new_data_info_ptr(std::make_shared<DataInfo>());
+  FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>
+      new_file_manager(target_path, new_data_info_ptr, true);
+  // Free the empty root made by manager, so nodes are written from the first
+  // block one after another.
+  new_file_manager.DeleteNode(new_data_info_ptr->_root_pos);
+  _ElementsReader reader(_file_manager, _data_info_ptr->_root_pos);
+  AggregateType aggregate;
+  new_data_info_ptr->_root_pos = _WritePacked(new_file_manager, reader,
+                                              elements_cnt, height,
+                                              node_size, true, aggregate);
+  new_data_info_ptr->_size = elements_cnt;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::~BTreeList() {
   if (_rebuild_flag) {
     _Rebuild();
   }
 }
 
 
+/*
+ * Pins nodes of _pinned_levels upper levels again. Is called when root
+ * changes, because then all nodes move one level down or up.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RepinUpperLevels() {
+  if (_pinned_levels == 0) {
+    return true;
+  }
+  _file_manager.UnpinAllBlocks();
+  bool locked_flag = true;
+  std::vector<file_pos_t> level_positions{_data_info_ptr->_root_pos};
+  for (unsigned level = 0; level < _pinned_levels; ++level) {
+    std::vector<file_pos_t> next_level_positions;
+    for (file_pos_t pos: level_positions) {
+      locked_flag = _file_manager.PinBlock(pos, _pinned_lock_flag) &&
+                    locked_flag;
+      Node<ElementType, T, AggregatePolicy> curr_node =
+          _file_manager.GetNode(pos);
+      if (!curr_node.GetIsLeaf()) {
+        next_level_positions.insert(next_level_positions.end(),
+                                    curr_node._links.begin(),
+                                    curr_node._links.end());
+      }
+    }
+    level_positions = std::move(next_level_positions);
+  }
+  return locked_flag;
+}
+
+/*
+ * Collects positions of leaves which have elements from first to last (not
+ * including) of subtree. Children counts show which subtrees are touched, so
+ * only internal nodes over the range are read.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_CollectLeavesInRange(
+    file_pos_t subtree_root_pos,
+    size_t first,
+    size_t last,
+    std::vector<file_pos_t> &leaves_positions
+) {
+  Node<ElementType, T, AggregatePolicy> curr_node =
+      _file_manager.GetNode(subtree_root_pos);
+  if (curr_node.GetIsLeaf()) {
+    leaves_positions.push_back(subtree_root_pos);
+    return;
+  }
+  size_t child_first = 0;
+  for (unsigned i = 0; i < curr_node.Size() + 1 && child_first < last; ++i) {
+    size_t child_last = child_first + curr_node.ChildrenCntBefore(i);
+    if (first < child_last) {
+      _CollectLeavesInRange(curr_node.LinkBefore(i),
+                            std::max(first, child_first) - child_first,
+                            std::min(last, child_last) - child_first,
+                            leaves_positions);
+    }
+    child_first = child_last + 1;  // Skip element after child
+  }
+}
+
+/*
+ * Max elements count in subtree of height levels where every node has
+ * node_size elements. Saturates long before overflow.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_SubtreeCapacity(unsigned height,
+                                             size_t node_size) {
+  const size_t limit = std::numeric_limits<size_t>::max() / (2 * T);
+  size_t capacity = node_size;
+  for (unsigned level = 1; level < height && capacity < limit; ++level) {
+    capacity = node_size + (node_size + 1) * capacity;
+  }
+  return std::min(capacity, limit);
+}
+
+/*
+ * Min elements count in non-root subtree of height levels.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_MinSubtreeSize(
+    unsigned height
+) {
+  const size_t limit = std::numeric_limits<size_t>::max() / (2 * T);
+  size_t min_size = T - 1;
+  for (unsigned level = 1; level < height && min_size < limit; ++level) {
+    min_size = T - 1 + T * min_size;
+  }
+  return std::min(min_size, limit);
+}
+
+/*
+ * Height is the lowest one which fits elements, but root must still have two
+ * children with minimal subtrees.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+unsigned BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_PackedHeight(
+    size_t elements_cnt,
+    size_t node_size
+) {
+  unsigned height = 1;
+  while (_SubtreeCapacity(height, node_size) < elements_cnt) {
+    ++height;
+  }
+  // Too few elements to fill two minimal subtrees under root
+  while (height > 1 && elements_cnt < 2 * _MinSubtreeSize(height - 1) + 1) {
+    --height;
+  }
+  return height;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_PackedChildrenCnt(
+    size_t elements_cnt,
+    unsigned height,
+    size_t node_size,
+    bool is_root
+) {
+  size_t child_target = _SubtreeCapacity(height - 1, node_size) + 1;
+  size_t child_max = _SubtreeCapacity(height - 1, 2 * T - 2) + 1;
+  size_t child_min = _MinSubtreeSize(height - 1) + 1;
+  // Each child takes its subtree and one element after it (except the last).
+  size_t children_cnt = (elements_cnt + child_target) / child_target;
+  children_cnt = std::max(children_cnt,
+                          (elements_cnt + child_max) / child_max);
+  children_cnt = std::min(children_cnt, (elements_cnt + 1) / child_min);
+  return std::clamp(children_cnt, is_root ? size_t{2} : T, 2 * T - 1);
+}
+
+/*
+ * Children of one node differ in size by one element at most, so only two
+ * child subtrees are counted on every level.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_PackedNodesCnt(
+    size_t elements_cnt,
+    unsigned height,
+    size_t node_size,
+    bool is_root
+) {
+  if (height == 1) {
+    return 1;
+  }
+  size_t children_cnt = _PackedChildrenCnt(elements_cnt, height, node_size,
+                                           is_root);
+  size_t in_children_cnt = elements_cnt - (children_cnt - 1);
+  size_t larger_cnt = in_children_cnt % children_cnt;
+  size_t child_size = in_children_cnt / children_cnt;
+  size_t nodes_cnt = 1 + (children_cnt - larger_cnt) *
+      _PackedNodesCnt(child_size, height - 1, node_size, false);
+  if (larger_cnt != 0) {
+    nodes_cnt += larger_cnt *
+        _PackedNodesCnt(child_size + 1, height - 1, node_size, false);
+  }
+  return nodes_cnt;
+}
+
+/*
+ * Writes subtree of height levels with next elements_cnt elements from reader.
+ * Children are written before their parent, so blocks are filled strictly
+ * sequentially. Elements are spread among children as even as possible.
+ * Returns position of subtree root.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_WritePacked(
+    FileSavingManager<ElementType, T, TracePolicy,
+                      AggregatePolicy> &new_file_manager,
+    _ElementsReader &reader,
+    size_t elements_cnt,
+    unsigned height,
+    size_t node_size,
+    bool is_root,
+    AggregateType &aggregate
+) const {
+  uint32_t flags = is_root ? Node<ElementType, T>::_Flags::ROOT : 0;
+  aggregate = AggregatePolicy::Identity();
+  if (height == 1) {
+    std::vector<ElementType> elements;
+    elements.reserve(elements_cnt);
+    for (size_t i = 0; i < elements_cnt; ++i) {
+      elements.push_back(reader.Next());
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements.back()));
+    }
+    return new_file_manager.NewNode(Node<ElementType, T, AggregatePolicy>(
+        std::move(elements),
+        std::vector<file_pos_t>(elements_cnt + 1, 0),
+        std::vector<size_t>(elements_cnt + 1, 0),
+        flags | Node<ElementType, T>::_Flags::LEAF
+    ));
+  }
+  size_t children_cnt = _PackedChildrenCnt(elements_cnt, height, node_size,
+                                           is_root);
+  size_t in_children_cnt = elements_cnt - (children_cnt - 1);
+  std::vector<ElementType> elements;
+  std::vector<file_pos_t> links;
+  std::vector<size_t> children_cnts;
+  std::vector<AggregateType> aggregates;
+  for (size_t i = 0; i < children_cnt; ++i) {
+    size_t child_size = in_children_cnt / children_cnt +
+                        (i < in_children_cnt % children_cnt ? 1 : 0);
+    AggregateType child_aggregate;
+    links.push_back(_WritePacked(new_file_manager, reader, child_size,
+                                 height - 1, node_size, false,
+                                 child_aggregate));
+    children_cnts.push_back(child_size);
+    aggregates.push_back(child_aggregate);
+    aggregate = AggregatePolicy::Combine(aggregate, child_aggregate);
+    if (i + 1 < children_cnt) {
+      elements.push_back(reader.Next());
+      aggregate = AggregatePolicy::Combine(
+          aggregate, AggregatePolicy::FromElement(elements.back()));
+    }
+  }
+  Node<ElementType, T, AggregatePolicy> node(
+      std::move(elements), std::move(links), std::move(children_cnts), flags
+  );
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    std::copy(aggregates.begin(), aggregates.end(), node._aggregates.begin());
+  }
+  return new_file_manager.NewNode(node);
+}
+
+/*
+ * Raw blocks are taken from the same allocator as nodes, so they are kept
+ * free or used between sessions, but tree never looks into them.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_NewRawBlock() {
+  return _file_manager.NewNode();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_DeleteRawBlock(file_pos_t pos) {
+  _file_manager.DeleteNode(pos);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+char*
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_GetRawBlockPtr(file_pos_t pos) {
+  return _file_manager._block_rw.template GetBlockPtr<char>(pos);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+size_t
+BTreeList<ElementType, T, TracePolicy, AggregatePolicy>::_RawBlockSize() const {
+  return _file_manager._block_rw._block_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Elements reader                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_ElementsReader::_ElementsReader(
+    const FileSavingManager<ElementType, T, TracePolicy,
+                            AggregatePolicy> &manager,
+    file_pos_t root_pos
+) : _file_manager(manager) {
+  _GoDownLeft(root_pos);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+ElementType
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_ElementsReader::Next() {
+  while (_path.back()._next_index == _path.back()._elements.size()) {
+    _path.pop_back();
+  }
+  unsigned index = _path.back()._next_index++;
+  ElementType element = _path.back()._elements[index];
+  if (!_path.back()._links.empty()) {
+    _GoDownLeft(_path.back()._links[index + 1]);
+  }
+  return element;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+BTreeList<ElementType, T, TracePolicy,
+          AggregatePolicy>::_ElementsReader::_GoDownLeft(
+    file_pos_t pos
+) {
+  bool is_leaf = false;
+  while (!is_leaf) {
+    Node<ElementType, T, AggregatePolicy> curr_node =
+        _file_manager.GetNode(pos);
+    is_leaf = curr_node.GetIsLeaf();
+    pos = curr_node.LinkBefore(0);
+    _path.push_back(_PathEntry{
+        std::move(curr_node._elements),
+        is_leaf ? std::vector<file_pos_t>{} : std::move(curr_node._links),
+        0
+    });
+  }
+}
+
 #endif //B_TREE_LIST_LIBRARY_H
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <boost/iostreams/code_converter.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
 #include "data_info.hpp"
+#include "mapping_windows.hpp"
+#include "pinned_blocks.hpp"
 
 #ifndef B_TREE_LIST_LIB__BLOCK_RW_HPP_
 #define B_TREE_LIST_LIB__BLOCK_RW_HPP_
@@ -35,6 +37,9 @@ class BlockRW {
   template<typename TypeToRead>
   const TypeToRead* GetBlockPtr(file_pos_t pos) const;
 
+  // Pointer to block in file mapping even if block is pinned
+  char* GetMappedBlockPtr(file_pos_t pos);
+
   template <typename ElementType, size_t T>
   struct Node<ElementType, T>::_NodeInfo* GetNodeInfoPtr(file_pos_t pos);
 
@@ -51,6 +56,9 @@ class BlockRW {
   template<typename ElementType, size_t T>
   ElementType* GetNodeElementPtr(file_pos_t pos, unsigned index);
 
+  template<typename ElementType, size_t T>
+  const ElementType* GetNodeElementPtr(file_pos_t pos, unsigned index) const;
+
   template<typename ElementType, size_t T>
   char* GetNodeLinksBegPtr(file_pos_t pos);
 
@@ -60,6 +68,9 @@ class BlockRW {
   template<typename ElementType, size_t T>
   [[maybe_unused]] file_pos_t* GetNodeLinkPtr(file_pos_t pos, unsigned index);
 
+  template<typename ElementType, size_t T>
+  const file_pos_t* GetNodeLinkPtr(file_pos_t pos, unsigned index) const;
+
   template<typename ElementType, size_t T>
   char* GetNodeCCBegPtr(file_pos_t pos);
 
@@ -69,6 +80,16 @@ class BlockRW {
   template<typename ElementType, size_t T>
   size_t* GetNodeCCPtr(file_pos_t pos, unsigned index);
 
+  template<typename ElementType, size_t T>
+  const size_t* GetNodeCCPtr(file_pos_t pos, unsigned index) const;
+
+  template<typename ElementType, size_t T, typename AggregatePolicy>
+  typename AggregatePolicy::ValueType* GetNodeAggregatesBegPtr(file_pos_t pos);
+
+  template<typename ElementType, size_t T, typename AggregatePolicy>
+  const typename AggregatePolicy::ValueType*
+      GetNodeAggregatesBegPtr(file_pos_t pos) const;
+
   template<typename TypeToWrite>
   void WriteBlock(file_pos_t pos, const TypeToWrite& element);
 
@@ -81,6 +102,11 @@ class BlockRW {
 
   size_t _first_node_offset;
 
+  std::shared_ptr<PinnedBlocks> _pinned_blocks_ptr;  // Null if none pinned.
+
+  // Null if memory of mapping is not bounded.
+  std::shared_ptr<MappingWindows> _windows_ptr;
+
   //////////////////////////////////////////////////////////////////////////////
   // Friend classes                                                           //
   //////////////////////////////////////////////////////////////////////////////
@@ -88,10 +114,12 @@ class BlockRW {
   template <typename ElementType>
   friend class Allocator;
 
-  template <typename ElementType, size_t T>
+  template <typename ElementType, size_t T, typename TracePolicy,
+            typename AggregatePolicy>
   friend class FileSavingManager;
 
-  template <typename ElementType, size_t T>
+  template <typename ElementType, size_t T, typename TracePolicy,
+            typename AggregatePolicy>
   friend class BTreeList;
 };
 
@@ -116,16 +144,40 @@ const DataInfo* BlockRW::GetDataInfoPtr() const {
 
 template<typename TypeToRead>
 TypeToRead* BlockRW::GetBlockPtr(file_pos_t pos) {
+  if (_pinned_blocks_ptr != nullptr) {
+    if (char* pinned = _pinned_blocks_ptr->Find(pos)) {
+      return reinterpret_cast<TypeToRead*>(pinned);
+    }
+  }
+  if (_windows_ptr != nullptr) {
+    _windows_ptr->Touch(pos, _mapped_file_ptr->data() + _first_node_offset,
+                        _mapped_file_ptr->size() - _first_node_offset,
+                        _block_size);
+  }
   return reinterpret_cast<TypeToRead*>(_mapped_file_ptr->data() +
       _first_node_offset + pos * _block_size);
 }
 
 template<typename TypeToRead>
 const TypeToRead* BlockRW::GetBlockPtr(file_pos_t pos) const {
+  if (_pinned_blocks_ptr != nullptr) {
+    if (const char* pinned = _pinned_blocks_ptr->Find(pos)) {
+      return reinterpret_cast<const TypeToRead*>(pinned);
+    }
+  }
+  if (_windows_ptr != nullptr) {
+    _windows_ptr->Touch(pos, _mapped_file_ptr->data() + _first_node_offset,
+                        _mapped_file_ptr->size() - _first_node_offset,
+                        _block_size);
+  }
   return reinterpret_cast<TypeToRead*>(_mapped_file_ptr->data() +
       _first_node_offset + pos * _block_size);
 }
 
+char* BlockRW::GetMappedBlockPtr(file_pos_t pos) {
+  return _mapped_file_ptr->data() + _first_node_offset + pos * _block_size;
+}
+
 template<typename ElementType, size_t T>
 struct Node<ElementType, T>::_NodeInfo* BlockRW::GetNodeInfoPtr(
     file_pos_t pos
@@ -161,6 +213,14 @@ ElementType* BlockRW::GetNodeElementPtr(file_pos_t pos, unsigned index) {
   );
 }
 
+template<typename ElementType, size_t T>
+const ElementType* BlockRW::GetNodeElementPtr(file_pos_t pos,
+                                              unsigned index) const {
+  return reinterpret_cast<const ElementType*>(
+      GetNodeElementsBegPtr<ElementType, T>(pos) +  sizeof(ElementType) * index
+  );
+}
+
 template<typename ElementType, size_t T>
 [[maybe_unused]] file_pos_t* BlockRW::GetNodeLinkPtr(file_pos_t pos,
                                                      unsigned index) {
@@ -170,6 +230,15 @@ template<typename ElementType, size_t T>
   );
 }
 
+template<typename ElementType, size_t T>
+const file_pos_t* BlockRW::GetNodeLinkPtr(file_pos_t pos,
+                                          unsigned index) const {
+  return reinterpret_cast<const file_pos_t*>(
+      GetBlockPtr<char>(pos) + Node<ElementType, T>::links_offset +
+      sizeof(file_pos_t) * index
+  );
+}
+
 template<typename ElementType, size_t T>
 char* BlockRW::GetNodeCCBegPtr(file_pos_t pos) {
   return GetBlockPtr<char>(pos) + Node<ElementType, T>::cc_offset;
@@ -187,6 +256,33 @@ size_t* BlockRW::GetNodeCCPtr(file_pos_t pos, unsigned index) {
   );
 }
 
+template<typename ElementType, size_t T>
+const size_t* BlockRW::GetNodeCCPtr(file_pos_t pos, unsigned index) const {
+  return reinterpret_cast<const size_t*>(
+      GetNodeCCBegPtr<ElementType, T>(pos) + sizeof(size_t) * index
+  );
+}
+
+template<typename ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType* BlockRW::GetNodeAggregatesBegPtr(
+    file_pos_t pos
+) {
+  return reinterpret_cast<typename AggregatePolicy::ValueType*>(
+      GetBlockPtr<char>(pos) +
+      Node<ElementType, T, AggregatePolicy>::aggregates_offset
+  );
+}
+
+template<typename ElementType, size_t T, typename AggregatePolicy>
+const typename AggregatePolicy::ValueType* BlockRW::GetNodeAggregatesBegPtr(
+    file_pos_t pos
+) const {
+  return reinterpret_cast<const typename AggregatePolicy::ValueType*>(
+      GetBlockPtr<char>(pos) +
+      Node<ElementType, T, AggregatePolicy>::aggregates_offset
+  );
+}
+
 template<typename ElementType, size_t T>
 char* BlockRW::GetNodeLinksBegPtr(file_pos_t pos) {
   return GetBlockPtr<char>(pos) + Node<ElementType, T>::links_offset;
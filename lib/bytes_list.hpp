@@ -0,0 +1,420 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__BYTES_LIST_HPP_
+#define B_TREE_LIST_LIB__BYTES_LIST_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "b_tree_list.hpp"
+
+// List of byte strings of any length. First InlineSize bytes of each string
+// are kept inside the tree. The rest goes to a run of small extents of a
+// shared overflow heap block, or, if it does not fit in one heap block, to
+// chain of whole overflow blocks. All blocks are taken from the same file.
+template <size_t InlineSize = 48, size_t T = 200>
+class BytesList {
+ public:
+  // If file with filename name exists, tries open it as data file.
+  // If not exists creates new empty file.
+  explicit BytesList(const std::string &filename);
+
+  // Insert bytes to index position.
+  void Insert(size_t index, std::string_view bytes);
+
+  // Add bytes after the last element.
+  void PushBack(std::string_view bytes);
+
+  // Extract element from index position.
+  std::string Extract(size_t index);
+
+  // Get copy of element by index.
+  std::string Get(size_t index);
+
+  // Replace element by index.
+  void Set(size_t index, std::string_view bytes);
+
+  [[nodiscard]] size_t Size() const;
+
+  // Write all changes to file and wait for them to reach disk.
+  void Sync();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private classes                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Element of tree. Overflow position and offset are meaningful only if
+  // size is more than InlineSize. Offset is index of the first extent in
+  // heap block, length of overflow is size without InlineSize.
+  struct _Record{
+    file_pos_t _overflow_pos;
+    uint64_t _overflow_offset;
+    uint64_t _size;
+    char _inline[InlineSize];
+  };
+
+  // Heap block loaded to memory with number of its free extents.
+  struct _HeapBlock{
+    file_pos_t _pos;
+    size_t _free_cnt;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  _Record _WriteRecord(std::string_view bytes);
+
+  std::string _ReadRecord(const _Record &record);
+
+  void _DeleteOverflow(const _Record &record);
+
+  [[nodiscard]] size_t _OverflowPayloadSize() const;
+
+  // Overflow of size bytes is kept in heap block, not in chain.
+  [[nodiscard]] bool _InHeap(uint64_t size) const;
+
+  [[nodiscard]] size_t _HeapExtentsCnt() const;
+
+  [[nodiscard]] size_t _HeapWordsCnt() const;
+
+  [[nodiscard]] size_t _HeapExtentsOffset() const;
+
+  // Reads list of heap blocks from file on the first use.
+  void _LoadHeap();
+
+  // Marks extents_cnt free extents in a row as used, in existing heap block
+  // or in new one. Returns block position and index of the first extent.
+  std::pair<file_pos_t, size_t> _TakeExtents(size_t extents_cnt);
+
+  // Looks for extents_cnt free extents in a row in heap block. Returns
+  // index of the first one or extents count if there is no such run.
+  size_t _FindFreeRun(file_pos_t pos, size_t extents_cnt);
+
+  void _MarkExtents(file_pos_t pos, size_t first, size_t cnt, bool used_flag);
+
+  // Frees extents and deletes heap block if it becomes empty.
+  void _ReleaseExtents(file_pos_t pos, size_t first, size_t cnt);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Never rebuilt: rebuild copies only tree nodes, not overflow blocks.
+  BTreeList<_Record, T> _list;
+
+  // In order of list in file, starting from data info head.
+  std::vector<_HeapBlock> _heap_blocks;
+  bool _heap_loaded_flag;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Static fields                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  const static size_t heap_extent_size = 64;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+template <size_t InlineSize, size_t T>
+BytesList<InlineSize, T>::BytesList(const std::string &filename)
+    : _list(filename, false),
+      _heap_loaded_flag(false) {}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::Insert(size_t index, std::string_view bytes) {
+  _list.Insert(index, _WriteRecord(bytes));
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::PushBack(std::string_view bytes) {
+  _list.PushBack(_WriteRecord(bytes));
+}
+
+template <size_t InlineSize, size_t T>
+std::string BytesList<InlineSize, T>::Extract(size_t index) {
+  _Record record = _list.Extract(index);
+  std::string bytes = _ReadRecord(record);
+  _DeleteOverflow(record);
+  return bytes;
+}
+
+template <size_t InlineSize, size_t T>
+std::string BytesList<InlineSize, T>::Get(size_t index) {
+  return _ReadRecord(_list[index]);
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::Set(size_t index, std::string_view bytes) {
+  _Record new_record = _WriteRecord(bytes);
+  _Record old_record = _list[index];
+  _list[index] = new_record;
+  _DeleteOverflow(old_record);
+}
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::Size() const {
+  return _list.Size();
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::Sync() {
+  _list.Sync();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Private methods                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Overflow block starts with position of the next block of chain. The last
+ * block of chain is found by size of record.
+ */
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::_OverflowPayloadSize() const {
+  return _list._RawBlockSize() - sizeof(file_pos_t);
+}
+
+template <size_t InlineSize, size_t T>
+bool BytesList<InlineSize, T>::_InHeap(uint64_t size) const {
+  return size - InlineSize <= _HeapExtentsCnt() * heap_extent_size;
+}
+
+/*
+ * Heap block starts with position + 1 of the next heap block (zero for the
+ * last one) and bitmap of used extents, then extents go.
+ */
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::_HeapExtentsCnt() const {
+  size_t extents_cnt = (_list._RawBlockSize() - sizeof(file_pos_t)) /
+                       heap_extent_size;
+  while (sizeof(file_pos_t) + (extents_cnt + 63) / 64 * 8 +
+         extents_cnt * heap_extent_size > _list._RawBlockSize()) {
+    --extents_cnt;
+  }
+  return extents_cnt;
+}
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::_HeapWordsCnt() const {
+  return (_HeapExtentsCnt() + 63) / 64;
+}
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::_HeapExtentsOffset() const {
+  return sizeof(file_pos_t) + _HeapWordsCnt() * 8;
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::_LoadHeap() {
+  if (_heap_loaded_flag) {
+    return;
+  }
+  _heap_loaded_flag = true;
+  file_pos_t next_pos = _list._data_info_ptr->_overflow_heap_head;
+  while (next_pos != 0) {
+    const char* block_ptr = _list._GetRawBlockPtr(next_pos - 1);
+    size_t used_cnt = 0;
+    for (size_t i = 0; i < _HeapWordsCnt(); ++i) {
+      uint64_t word;
+      std::memcpy(&word, block_ptr + sizeof(file_pos_t) + i * 8, 8);
+      used_cnt += std::popcount(word);
+    }
+    _heap_blocks.push_back(_HeapBlock{next_pos - 1,
+                                      _HeapExtentsCnt() - used_cnt});
+    std::memcpy(&next_pos, block_ptr, sizeof(file_pos_t));
+  }
+}
+
+template <size_t InlineSize, size_t T>
+std::pair<file_pos_t, size_t>
+BytesList<InlineSize, T>::_TakeExtents(size_t extents_cnt) {
+  _LoadHeap();
+  for (_HeapBlock &heap_block: _heap_blocks) {
+    if (heap_block._free_cnt >= extents_cnt) {
+      size_t first = _FindFreeRun(heap_block._pos, extents_cnt);
+      if (first != _HeapExtentsCnt()) {
+        _MarkExtents(heap_block._pos, first, extents_cnt, true);
+        heap_block._free_cnt -= extents_cnt;
+        return {heap_block._pos, first};
+      }
+    }
+  }
+  file_pos_t pos = _list._NewRawBlock();
+  char* block_ptr = _list._GetRawBlockPtr(pos);
+  file_pos_t &head = _list._data_info_ptr->_overflow_heap_head;
+  std::memcpy(block_ptr, &head, sizeof(file_pos_t));
+  std::memset(block_ptr + sizeof(file_pos_t), 0, _HeapWordsCnt() * 8);
+  head = pos + 1;
+  _heap_blocks.insert(_heap_blocks.begin(),
+                      _HeapBlock{pos, _HeapExtentsCnt() - extents_cnt});
+  _MarkExtents(pos, 0, extents_cnt, true);
+  return {pos, 0};
+}
+
+template <size_t InlineSize, size_t T>
+size_t BytesList<InlineSize, T>::_FindFreeRun(file_pos_t pos,
+                                              size_t extents_cnt) {
+  const char* bitmap_ptr = _list._GetRawBlockPtr(pos) + sizeof(file_pos_t);
+  size_t run_first = 0;
+  for (size_t i = 0; i < _HeapExtentsCnt(); ++i) {
+    uint64_t word;
+    std::memcpy(&word, bitmap_ptr + i / 64 * 8, 8);
+    if ((word >> (i % 64) & 1) != 0) {
+      run_first = i + 1;
+    } else if (i + 1 - run_first == extents_cnt) {
+      return run_first;
+    }
+  }
+  return _HeapExtentsCnt();
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::_MarkExtents(file_pos_t pos,
+                                            size_t first,
+                                            size_t cnt,
+                                            bool used_flag) {
+  char* bitmap_ptr = _list._GetRawBlockPtr(pos) + sizeof(file_pos_t);
+  for (size_t i = first; i < first + cnt; ++i) {
+    uint64_t word;
+    std::memcpy(&word, bitmap_ptr + i / 64 * 8, 8);
+    if (used_flag) {
+      word |= uint64_t{1} << (i % 64);
+    } else {
+      word &= ~(uint64_t{1} << (i % 64));
+    }
+    std::memcpy(bitmap_ptr + i / 64 * 8, &word, 8);
+  }
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::_ReleaseExtents(file_pos_t pos,
+                                               size_t first,
+                                               size_t cnt) {
+  _LoadHeap();
+  _MarkExtents(pos, first, cnt, false);
+  auto heap_block_it = std::find_if(
+      _heap_blocks.begin(), _heap_blocks.end(),
+      [pos](const _HeapBlock &heap_block) { return heap_block._pos == pos; });
+  heap_block_it->_free_cnt += cnt;
+  if (heap_block_it->_free_cnt != _HeapExtentsCnt()) {
+    return;
+  }
+  file_pos_t next_pos;
+  std::memcpy(&next_pos, _list._GetRawBlockPtr(pos), sizeof(file_pos_t));
+  if (heap_block_it == _heap_blocks.begin()) {
+    _list._data_info_ptr->_overflow_heap_head = next_pos;
+  } else {
+    std::memcpy(_list._GetRawBlockPtr(std::prev(heap_block_it)->_pos),
+                &next_pos, sizeof(file_pos_t));
+  }
+  _heap_blocks.erase(heap_block_it);
+  _list._DeleteRawBlock(pos);
+}
+
+/*
+ * Blocks are allocated before writing, because allocation can remap file and
+ * invalidate block pointers.
+ */
+
+template <size_t InlineSize, size_t T>
+typename BytesList<InlineSize, T>::_Record
+BytesList<InlineSize, T>::_WriteRecord(std::string_view bytes) {
+  _Record record{0, 0, bytes.size(), {}};
+  size_t inline_size = std::min(bytes.size(), InlineSize);
+  std::memcpy(record._inline, bytes.data(), inline_size);
+  bytes.remove_prefix(inline_size);
+  if (bytes.empty()) {
+    return record;
+  }
+  if (_InHeap(record._size)) {
+    auto [pos, first] = _TakeExtents(
+        (bytes.size() + heap_extent_size - 1) / heap_extent_size);
+    std::memcpy(_list._GetRawBlockPtr(pos) + _HeapExtentsOffset() +
+                    first * heap_extent_size,
+                bytes.data(), bytes.size());
+    record._overflow_pos = pos;
+    record._overflow_offset = first;
+    return record;
+  }
+  size_t payload_size = _OverflowPayloadSize();
+  std::vector<file_pos_t> chain((bytes.size() + payload_size - 1) /
+                                payload_size);
+  for (auto &block_pos: chain) {
+    block_pos = _list._NewRawBlock();
+  }
+  for (size_t i = 0; i < chain.size(); ++i) {
+    char* block_ptr = _list._GetRawBlockPtr(chain[i]);
+    file_pos_t next_pos = i + 1 < chain.size() ? chain[i + 1] : 0;
+    std::memcpy(block_ptr, &next_pos, sizeof(file_pos_t));
+    size_t part_size = std::min(bytes.size(), payload_size);
+    std::memcpy(block_ptr + sizeof(file_pos_t), bytes.data(), part_size);
+    bytes.remove_prefix(part_size);
+  }
+  record._overflow_pos = chain.front();
+  return record;
+}
+
+template <size_t InlineSize, size_t T>
+std::string BytesList<InlineSize, T>::_ReadRecord(const _Record &record) {
+  std::string bytes(record._inline,
+                    std::min<size_t>(record._size, InlineSize));
+  if (record._size <= InlineSize) {
+    return bytes;
+  }
+  bytes.reserve(record._size);
+  if (_InHeap(record._size)) {
+    bytes.append(_list._GetRawBlockPtr(record._overflow_pos) +
+                     _HeapExtentsOffset() +
+                     record._overflow_offset * heap_extent_size,
+                 record._size - InlineSize);
+    return bytes;
+  }
+  file_pos_t block_pos = record._overflow_pos;
+  while (bytes.size() < record._size) {
+    const char* block_ptr = _list._GetRawBlockPtr(block_pos);
+    size_t part_size = std::min(record._size - bytes.size(),
+                                _OverflowPayloadSize());
+    bytes.append(block_ptr + sizeof(file_pos_t), part_size);
+    std::memcpy(&block_pos, block_ptr, sizeof(file_pos_t));
+  }
+  return bytes;
+}
+
+template <size_t InlineSize, size_t T>
+void BytesList<InlineSize, T>::_DeleteOverflow(const _Record &record) {
+  if (record._size <= InlineSize) {
+    return;
+  }
+  if (_InHeap(record._size)) {
+    _ReleaseExtents(record._overflow_pos, record._overflow_offset,
+                    (record._size - InlineSize + heap_extent_size - 1) /
+                        heap_extent_size);
+    return;
+  }
+  size_t payload_size = _OverflowPayloadSize();
+  size_t blocks_cnt = (record._size - InlineSize + payload_size - 1) /
+                      payload_size;
+  file_pos_t block_pos = record._overflow_pos;
+  for (size_t i = 0; i < blocks_cnt; ++i) {
+    file_pos_t next_pos;
+    std::memcpy(&next_pos, _list._GetRawBlockPtr(block_pos),
+                sizeof(file_pos_t));
+    _list._DeleteRawBlock(block_pos);
+    block_pos = next_pos;
+  }
+}
+
+#endif //B_TREE_LIST_LIB__BYTES_LIST_HPP_
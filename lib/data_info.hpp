@@ -17,6 +17,9 @@ struct DataInfo{
   file_pos_t _max_blocks_cnt;
   file_pos_t _root_pos;
   size_t _size;
+  file_pos_t _free_extents_cnt;
+  // Position + 1 of the first BytesList heap block, zero if there is none.
+  file_pos_t _overflow_heap_head;
 };
 
 #endif //B_TREE_LIST_LIB__DATA_INFO_HPP_
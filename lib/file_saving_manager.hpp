@@ -1,10 +1,17 @@
+#include <algorithm>
 #include <vector>
 #include <filesystem>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <boost/interprocess/mapped_region.hpp>
 #include "data_info.hpp"
 #include "allocator.hpp"
 #include "block_rw.hpp"
 #include "node.hpp"
+#include "stats.hpp"
+#include "structure_report.hpp"
+#include "trace_policy.hpp"
 
 //
 // Created by gogagum on 14.07.2020.
@@ -13,6 +20,18 @@
 #ifndef B_TREE_LIST_LIB__FILE_SAVING_MANAGER_HPP_
 #define B_TREE_LIST_LIB__FILE_SAVING_MANAGER_HPP_
 
+// Where list data is kept.
+enum class StorageBackend {
+  FILE,              // Usual file which stays after list is closed.
+  ANONYMOUS_MEMORY,  // Anonymous memory file, freed when list is closed.
+};
+
+// How existing list file is opened.
+enum class OpenMode {
+  READ_WRITE,
+  READ_ONLY,  // File is mapped privately, changes never reach it.
+};
+
 inline size_t GetPagesSize(size_t inmemory_size) {
   return CeilDiv(inmemory_size,
                  boost::interprocess::mapped_region::get_page_size());
@@ -22,7 +41,8 @@ inline size_t GetPagesSize(size_t inmemory_size) {
 // File saving manager                                                        //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy = NoAggregatePolicy>
 class FileSavingManager{
  private:
   //////////////////////////////////////////////////////////////////////////////
@@ -34,24 +54,97 @@ class FileSavingManager{
                     const std::shared_ptr<DataInfo> &data_info_ptr,
                     bool file_creation_expected = false);
 
+  // File manager for backend. For ANONYMOUS_MEMORY memory file (memfd) is
+  // created and name is only shown in /proc, for FILE it is a new file path.
+  FileSavingManager(const std::string &name,
+                    const std::shared_ptr<DataInfo> &data_info_ptr,
+                    StorageBackend backend);
+
+  // File manager for existing file opened in mode. Throws filesystem_error
+  // if there is no such file.
+  FileSavingManager(const std::string &destination,
+                    const std::shared_ptr<DataInfo> &data_info_ptr,
+                    OpenMode mode);
+
   // Set node to the position pos
-  void SetNode(file_pos_t pos, const Node<ElementType, T> &node_to_set);
+  void SetNode(file_pos_t pos,
+               const Node<ElementType, T, AggregatePolicy> &node_to_set);
 
   // Get node from position pos
-  Node<ElementType, T> GetNode(file_pos_t pos) const;
+  Node<ElementType, T, AggregatePolicy> GetNode(file_pos_t pos) const;
+
+  // Report bytes_cnt bytes written in place into node on position pos by
+  // block pointers instead of SetNode: calls write hook of trace policy and
+  // counts node write.
+  void MarkNodeWritten(file_pos_t pos, size_t bytes_cnt);
 
   // Add new node to memory and return position
   file_pos_t NewNode();
 
   // Add new node to memory and set node to this position
-  file_pos_t NewNode(const Node<ElementType, T> &node);
+  file_pos_t NewNode(const Node<ElementType, T, AggregatePolicy> &node);
+
+  // Add new node to memory as close to near_pos as possible
+  file_pos_t NewNode(file_pos_t near_pos);
+
+  // Add new node as close to near_pos as possible and set node to it
+  file_pos_t NewNode(const Node<ElementType, T, AggregatePolicy> &node,
+                     file_pos_t near_pos);
 
   // Delete node (free memory) from pos position in file
   void DeleteNode(file_pos_t pos);
 
+  // Return memory of deleted nodes to file system
+  void ReleaseFreeBlocks();
+
+  // Set madvise advice for the whole mapping. Returns false if kernel
+  // rejected it.
+  bool Advise(int advice);
+
+  // Ask kernel to back mapping with transparent huge pages. Returns false if
+  // kernel rejected it.
+  bool SetHugePages(bool flag_to_set);
+
+  // Ask kernel to read blocks in advance. Returns false if kernel rejected
+  // any run of blocks.
+  bool WillNeedBlocks(std::vector<file_pos_t> positions);
+
+  // Keep block copy in memory instead of file mapping until it is deleted.
+  // Returns false if lock_flag is set, but memory of copies was not locked.
+  bool PinBlock(file_pos_t pos, bool lock_flag);
+
+  // Write pinned blocks to file and stop keeping them in memory
+  void UnpinAllBlocks();
+
+  // Keep at most windows_cnt recently used windows of blocks_per_window
+  // blocks mapped. Zero windows_cnt removes the limit.
+  void SetMappingWindows(size_t windows_cnt, size_t blocks_per_window);
+
+  // Write pinned blocks and data info to file and wait till it is on disk
+  void Sync();
+
+  // Get node copies and allocator counters
+  void GetCounters(StorageCounters &storage,
+                   AllocationCounters &allocation) const;
+
+  void ResetCounters();
+
+  [[nodiscard]] BlocksUsage GetBlocksUsage() const;
+
+  [[nodiscard]] bool IsFreeBlock(file_pos_t pos) const;
+
+  void _FlushPinnedBlocks();
+
+  // Map file from _file_params_ptr path, create root if file is new
+  void _Open();
+
   // Rename mapped file
   void RenameMappedFile(const std::string &new_name);
 
+  // Tell trace policy about new file size if allocator remapped file since
+  // remaps_cnt was taken
+  void _TraceFileResize(uint64_t remaps_cnt) const;
+
   ~FileSavingManager();
 
   //////////////////////////////////////////////////////////////////////////////
@@ -66,12 +159,19 @@ class FileSavingManager{
   std::shared_ptr<boost::iostreams::mapped_file> _mapped_file_ptr;
   std::shared_ptr<boost::iostreams::mapped_file_params> _file_params_ptr;
   bool _new_file_flag;
+  int _memory_fd;  // -1 if data is in usual file.
+  bool _read_only_flag;
+
+  // Mutable, because nodes are read by const methods too, maybe by several
+  // threads at once.
+  mutable AtomicStorageCounters _counters;
 
   //////////////////////////////////////////////////////////////////////////////
   // Friend classes                                                           //
   //////////////////////////////////////////////////////////////////////////////
 
-  template<typename _ElementType, size_t _T>
+  template<typename _ElementType, size_t _T, typename _TracePolicy,
+           typename _AggregatePolicy>
   friend class BTreeList;
 };
 
@@ -79,30 +179,103 @@ class FileSavingManager{
 // Implementation                                                             //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-FileSavingManager<ElementType, T>::FileSavingManager(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::FileSavingManager(
     const std::string &destination,
     const std::shared_ptr<DataInfo> &data_info_ptr,
     bool file_creation_expected
 ) : _data_info_ptr(data_info_ptr),
     _file_params_ptr(
         std::make_shared<boost::iostreams::mapped_file_params>(destination)
-    ) {
-  // Prepare opening
-  size_t page_size = boost::interprocess::mapped_region::get_page_size();
+    ),
+    _memory_fd(-1),
+    _read_only_flag(false) {
   _new_file_flag = !std::filesystem::exists(_file_params_ptr->path);
   if (file_creation_expected || _new_file_flag) {
     std::filesystem::remove(_file_params_ptr->path);
     _new_file_flag = true;
   }
+  _Open();
+}
+
+/*
+ * Memory file is opened through its /proc/self/fd link, so the rest of
+ * manager and allocator work with it as with usual file path.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::FileSavingManager(
+    const std::string &name,
+    const std::shared_ptr<DataInfo> &data_info_ptr,
+    StorageBackend backend
+) : _data_info_ptr(data_info_ptr),
+    _file_params_ptr(std::make_shared<boost::iostreams::mapped_file_params>()),
+    _new_file_flag(true),
+    _memory_fd(-1),
+    _read_only_flag(false) {
+  if (backend == StorageBackend::ANONYMOUS_MEMORY) {
+    _memory_fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+    if (_memory_fd == -1) {
+      throw std::filesystem::filesystem_error(
+          "memfd_create failed", name,
+          std::error_code(errno, std::generic_category()));
+    }
+    _file_params_ptr->path = "/proc/self/fd/" + std::to_string(_memory_fd);
+  } else {
+    _file_params_ptr->path = name;
+    std::filesystem::remove(_file_params_ptr->path);
+  }
+  _Open();
+}
+
+/*
+ * Read-only file is mapped copy-on-write: boost opens file for reading only
+ * and tree code, which writes into mapping freely, changes private copies of
+ * pages.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::FileSavingManager(
+    const std::string &destination,
+    const std::shared_ptr<DataInfo> &data_info_ptr,
+    OpenMode mode
+) : _data_info_ptr(data_info_ptr),
+    _file_params_ptr(
+        std::make_shared<boost::iostreams::mapped_file_params>(destination)
+    ),
+    _new_file_flag(false),
+    _memory_fd(-1),
+    _read_only_flag(mode == OpenMode::READ_ONLY) {
+  if (!std::filesystem::exists(_file_params_ptr->path)) {
+    throw std::filesystem::filesystem_error(
+        "no list file", destination,
+        std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  _Open();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::_Open() {
+  size_t page_size = boost::interprocess::mapped_region::get_page_size();
+  size_t block_size =
+      GetPagesSize(Node<ElementType, T, AggregatePolicy>::inmemory_size) *
+      page_size;
   if (_new_file_flag) {
     _file_params_ptr->new_file_size =
-        Allocator<ElementType>::data_info_size +
-        GetPagesSize(Node<ElementType, T>::inmemory_size) * page_size;
+        Allocator<ElementType>::data_info_size + block_size;
   } else {
     _file_params_ptr->new_file_size = 0;
   }
-  _file_params_ptr->flags = boost::iostreams::mapped_file::mapmode::readwrite;
+  _file_params_ptr->flags =
+      _read_only_flag ? boost::iostreams::mapped_file::mapmode::priv
+                      : boost::iostreams::mapped_file::mapmode::readwrite;
   _file_params_ptr->offset = 0;
   // Opening file
   _mapped_file_ptr =
@@ -110,32 +283,38 @@ FileSavingManager<ElementType, T>::FileSavingManager(
   _block_rw = BlockRW(
       _mapped_file_ptr,
       GetPagesSize(Allocator<ElementType>::data_info_size) * page_size,
-      GetPagesSize(Node<ElementType, T>::inmemory_size) * page_size
+      block_size
   );
   _allocator = Allocator<ElementType>(
       _mapped_file_ptr,
       _file_params_ptr,
       _data_info_ptr,
-      GetPagesSize(Node<ElementType, T>::inmemory_size) * page_size,
+      block_size,
       _new_file_flag
   );
   if (_new_file_flag) {
-    auto root_node = Node<ElementType, T>(
+    auto root_node = Node<ElementType, T, AggregatePolicy>(
         std::vector<ElementType>{},
         std::vector<file_pos_t>{0},
         std::vector<size_t>{0},
-        Node<ElementType, T>::_Flags::ROOT | Node<ElementType, T>::_Flags::LEAF
+        Node<ElementType, T, AggregatePolicy>::_Flags::ROOT |
+            Node<ElementType, T, AggregatePolicy>::_Flags::LEAF
     );
     _data_info_ptr->_root_pos = NewNode(root_node);
   }
 }
 
-template <typename ElementType, size_t T>
-void FileSavingManager<ElementType, T>::SetNode(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::SetNode(
     file_pos_t pos,
-    const Node<ElementType, T>& node_to_set
+    const Node<ElementType, T, AggregatePolicy>& node_to_set
 ) {
-  *_block_rw.GetNodeInfoPtr<ElementType, T>(pos) = node_to_set.GetNodeInfo();
+  TracePolicy::OnNodeWrite(pos);
+  // Info has the same layout for every aggregate policy.
+  auto* info = _block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+  info->_elements_cnt = node_to_set.Size();
+  info->_flags = node_to_set._flags;
 
   std::memcpy(_block_rw.GetNodeElementsBegPtr<ElementType, T>(pos),
               node_to_set._elements.data(), node_to_set.ElementsArraySize());
@@ -143,15 +322,37 @@ void FileSavingManager<ElementType, T>::SetNode(
               node_to_set._links.data(), node_to_set.LinksArraySize());
   std::memcpy(_block_rw.GetNodeCCBegPtr<ElementType, T>(pos),
               node_to_set._children_cnts.data(), node_to_set.CCArraySize());
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    std::memcpy(
+        _block_rw.GetNodeAggregatesBegPtr<ElementType, T, AggregatePolicy>(pos),
+        node_to_set._aggregates.data(), node_to_set.AggregatesArraySize());
+  }
+  _counters.AddWritten(node_to_set.ElementsArraySize() +
+                       node_to_set.LinksArraySize() +
+                       node_to_set.CCArraySize() +
+                       node_to_set.AggregatesArraySize());
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void FileSavingManager<ElementType, T, TracePolicy,
+                       AggregatePolicy>::MarkNodeWritten(
+    file_pos_t pos,
+    size_t bytes_cnt
+) {
+  TracePolicy::OnNodeWrite(pos);
+  _counters.AddWritten(bytes_cnt);
 }
 
-template <typename ElementType, size_t T>
-Node<ElementType, T> FileSavingManager<ElementType, T>::GetNode(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+Node<ElementType, T, AggregatePolicy>
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::GetNode(
     file_pos_t pos
 ) const {
-  Node<ElementType, T> taken_node;
-  struct Node<ElementType, T>::_NodeInfo taken_info =
-      *_block_rw.GetNodeInfoPtr<ElementType, T>(pos);
+  TracePolicy::OnNodeRead(pos);
+  Node<ElementType, T, AggregatePolicy> taken_node;
+  auto taken_info = *_block_rw.GetNodeInfoPtr<ElementType, T>(pos);
   taken_node.Resize(taken_info._elements_cnt);
   taken_node._flags = taken_info._flags;
 
@@ -164,30 +365,301 @@ Node<ElementType, T> FileSavingManager<ElementType, T>::GetNode(
   std::memcpy(taken_node._children_cnts.data(),
               _block_rw.GetNodeCCBegPtr<ElementType, T>(pos),
               taken_node.CCArraySize());
+  if constexpr (is_aggregated_v<AggregatePolicy>) {
+    std::memcpy(
+        taken_node._aggregates.data(),
+        _block_rw.GetNodeAggregatesBegPtr<ElementType, T, AggregatePolicy>(pos),
+        taken_node.AggregatesArraySize());
+  }
+  _counters.AddRead(taken_node.ElementsArraySize() +
+                    taken_node.LinksArraySize() +
+                    taken_node.CCArraySize() +
+                    taken_node.AggregatesArraySize());
   return taken_node;
 }
 
-template <typename ElementType, size_t T>
-file_pos_t FileSavingManager<ElementType, T>::NewNode() {
-  return _allocator.NewNode();
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::NewNode() {
+  uint64_t remaps_cnt = _allocator._counters.remaps;
+  file_pos_t pos = _allocator.NewNode();
+  TracePolicy::OnAllocation(pos);
+  _TraceFileResize(remaps_cnt);
+  return pos;
 }
 
-template <typename ElementType, size_t T>
-file_pos_t FileSavingManager<ElementType, T>::NewNode(
-    const Node<ElementType, T> &node
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::NewNode(
+    const Node<ElementType, T, AggregatePolicy> &node
 ) {
   file_pos_t pos = NewNode();
   SetNode(pos, node);
   return pos;
 }
 
-template <typename ElementType, size_t T>
-void FileSavingManager<ElementType, T>::DeleteNode(file_pos_t pos) {
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::NewNode(
+    file_pos_t near_pos
+) {
+  uint64_t remaps_cnt = _allocator._counters.remaps;
+  file_pos_t pos = _allocator.NewNode(near_pos);
+  TracePolicy::OnAllocation(pos);
+  _TraceFileResize(remaps_cnt);
+  return pos;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+file_pos_t
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::NewNode(
+    const Node<ElementType, T, AggregatePolicy> &node,
+    file_pos_t near_pos
+) {
+  file_pos_t pos = NewNode(near_pos);
+  SetNode(pos, node);
+  return pos;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::DeleteNode(
+    file_pos_t pos
+) {
+  if (_block_rw._pinned_blocks_ptr != nullptr) {
+    _block_rw._pinned_blocks_ptr->Unpin(pos);
+  }
+  uint64_t remaps_cnt = _allocator._counters.remaps;
   _allocator.DeleteNode(pos);
+  _TraceFileResize(remaps_cnt);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::_TraceFileResize(
+    uint64_t remaps_cnt
+) const {
+  if (_allocator._counters.remaps != remaps_cnt) {
+    TracePolicy::OnFileResize(_data_info_ptr->_max_blocks_cnt);
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::GetCounters(
+    StorageCounters &storage,
+    AllocationCounters &allocation
+) const {
+  storage = _counters.Load();
+  if (_block_rw._windows_ptr != nullptr) {
+    storage.evicted_windows =
+        _block_rw._windows_ptr->_evicted_cnt.load(std::memory_order_relaxed);
+  }
+  allocation = _allocator._counters;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::ResetCounters() {
+  _counters.Reset();
+  if (_block_rw._windows_ptr != nullptr) {
+    _block_rw._windows_ptr->_evicted_cnt.store(0, std::memory_order_relaxed);
+  }
+  _allocator._counters = AllocationCounters();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+BlocksUsage
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::GetBlocksUsage(
+) const {
+  BlocksUsage usage;
+  usage.block_size = _allocator._block_size;
+  usage.file_size = _allocator._file_size;
+  usage.blocks_cnt = _data_info_ptr->_max_blocks_cnt;
+  usage.free_tail_start = _data_info_ptr->_free_tail_start;
+  usage.free_blocks_cnt = _allocator._free_blocks_cnt;
+  size_t run = 0;
+  for (file_pos_t pos = 0; pos <= usage.free_tail_start; ++pos) {
+    if (pos < usage.free_tail_start && _allocator._IsFree(pos)) {
+      ++run;
+      continue;
+    }
+    if (run != 0) {
+      ++usage.free_runs_cnt;
+      usage.largest_free_run = std::max(usage.largest_free_run, run);
+    }
+    run = 0;
+  }
+  return usage;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::IsFreeBlock(
+    file_pos_t pos
+) const {
+  return pos < _data_info_ptr->_free_tail_start && _allocator._IsFree(pos);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::ReleaseFreeBlocks() {
+  _allocator.ReleaseFreeBlocks();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::Advise(int advice) {
+  _allocator._map_advice = advice;
+  return _allocator._ApplyAdvice();
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::SetHugePages(
+    bool flag_to_set
+) {
+  _allocator._huge_pages_flag = flag_to_set;
+  bool success_flag = true;
+  if (!flag_to_set) {
+    success_flag = madvise(_mapped_file_ptr->data(), _mapped_file_ptr->size(),
+                           MADV_NOHUGEPAGE) == 0;
+  }
+  return _allocator._ApplyAdvice() && success_flag;
+}
+
+/*
+ * Sorts positions and passes each run of consecutive blocks to kernel with
+ * one call.
+ */
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::WillNeedBlocks(
+    std::vector<file_pos_t> positions
+) {
+  std::sort(positions.begin(), positions.end());
+  bool success_flag = true;
+  size_t run_start = 0;
+  while (run_start < positions.size()) {
+    size_t run_end = run_start + 1;
+    while (run_end < positions.size() &&
+           positions[run_end] == positions[run_end - 1] + 1) {
+      ++run_end;
+    }
+    success_flag = madvise(_block_rw.GetBlockPtr<char>(positions[run_start]),
+                           (run_end - run_start) * _allocator._block_size,
+                           MADV_WILLNEED) == 0 && success_flag;
+    run_start = run_end;
+  }
+  return success_flag;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+bool
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::PinBlock(file_pos_t pos,
+                                                              bool lock_flag) {
+  if (_block_rw._pinned_blocks_ptr == nullptr) {
+    _block_rw._pinned_blocks_ptr = std::shared_ptr<PinnedBlocks>(
+        new PinnedBlocks(_allocator._block_size, lock_flag)
+    );
+    _allocator._block_rw._pinned_blocks_ptr = _block_rw._pinned_blocks_ptr;
+  }
+  if (_block_rw._pinned_blocks_ptr->Find(pos) == nullptr) {
+    std::memcpy(_block_rw._pinned_blocks_ptr->Pin(pos),
+                _block_rw.GetMappedBlockPtr(pos),
+                _allocator._block_size);
+  }
+  return !_block_rw._pinned_blocks_ptr->LockFailed();
 }
 
-template <typename ElementType, size_t T>
-void FileSavingManager<ElementType, T>::RenameMappedFile(
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::UnpinAllBlocks() {
+  _FlushPinnedBlocks();
+  _block_rw._pinned_blocks_ptr = nullptr;
+  _allocator._block_rw._pinned_blocks_ptr = nullptr;
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::SetMappingWindows(
+    size_t windows_cnt,
+    size_t blocks_per_window
+) {
+  if (windows_cnt == 0) {
+    _block_rw._windows_ptr = nullptr;
+  } else {
+    _block_rw._windows_ptr = std::shared_ptr<MappingWindows>(
+        new MappingWindows(blocks_per_window, windows_cnt,
+                           _file_params_ptr->path,
+                           _block_rw._first_node_offset)
+    );
+  }
+  _allocator._block_rw._windows_ptr = _block_rw._windows_ptr;
+  static_cast<void>(_allocator._ApplyAdvice());
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void FileSavingManager<ElementType, T, TracePolicy, AggregatePolicy>::Sync() {
+  _FlushPinnedBlocks();
+  if (_read_only_flag) {
+    return;
+  }
+  _allocator.SaveFreeBlocks();
+  *_block_rw.GetDataInfoPtr() = *_data_info_ptr;
+  msync(_mapped_file_ptr->data(), _mapped_file_ptr->size(), MS_SYNC);
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::_FlushPinnedBlocks() {
+  if (_block_rw._pinned_blocks_ptr == nullptr) {
+    return;
+  }
+  const PinnedBlocks &pinned_blocks = *_block_rw._pinned_blocks_ptr;
+  for (size_t slot = 0; slot < pinned_blocks._slots_cnt; ++slot) {
+    file_pos_t pos = pinned_blocks._pos_by_slot[slot];
+    if (pos != PinnedBlocks::no_pos) {
+      std::memcpy(_block_rw.GetMappedBlockPtr(pos),
+                  pinned_blocks._buffer + slot * _allocator._block_size,
+                  _allocator._block_size);
+    }
+  }
+}
+
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+void
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::RenameMappedFile(
     const std::string &new_name
 ) {
   _mapped_file_ptr->close();
@@ -196,11 +668,23 @@ void FileSavingManager<ElementType, T>::RenameMappedFile(
   _file_params_ptr->new_file_size = 0;
   _file_params_ptr->length = _allocator._file_size;
   _mapped_file_ptr->open(*_file_params_ptr);
+  // The same advice was accepted for the old mapping of this file.
+  static_cast<void>(_allocator._ApplyAdvice());
 }
 
-template <typename ElementType, size_t T>
-FileSavingManager<ElementType, T>::~FileSavingManager() {
-  *_block_rw.GetDataInfoPtr() = *_data_info_ptr;
+template <typename ElementType, size_t T, typename TracePolicy,
+          typename AggregatePolicy>
+FileSavingManager<ElementType, T, TracePolicy,
+                  AggregatePolicy>::~FileSavingManager() {
+  if (!_read_only_flag) {
+    _FlushPinnedBlocks();
+    _allocator.SaveFreeBlocks();
+    *_block_rw.GetDataInfoPtr() = *_data_info_ptr;
+  }
+  if (_memory_fd != -1) {
+    _mapped_file_ptr->close();
+    close(_memory_fd);
+  }
 }
 
 #endif //B_TREE_LIST_LIB__FILE_SAVING_MANAGER_HPP_
@@ -0,0 +1,92 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__INTEGRITY_REPORT_HPP_
+#define B_TREE_LIST_LIB__INTEGRITY_REPORT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class IntegrityErrorKind {
+  DATA_INFO,             // Used blocks do not fit into file.
+  BAD_LINK,              // Link points after the last used block.
+  FREE_BLOCK_REACHABLE,  // Block is reachable from root and free.
+  BLOCK_REACHED_TWICE,   // Block is child of two nodes or of itself.
+  NODE_SIZE,             // Elements count is out of B-tree bounds.
+  FLAGS,                 // Root flag is not set on root only.
+  LEAF_DEPTH,            // Leaves are on different levels.
+  CHILDREN_CNT,          // Children count differs from child subtree size.
+  LIST_SIZE,             // List size differs from elements in tree.
+};
+
+constexpr size_t integrity_error_kinds_cnt = 9;
+
+const std::array<const char*, integrity_error_kinds_cnt>
+    integrity_error_kind_names{
+        "data_info", "bad_link", "free_block_reachable",
+        "block_reached_twice", "node_size", "flags", "leaf_depth",
+        "children_cnt", "list_size"
+    };
+
+// stored is value read from file, actual is value it should be equal to or
+// bound it breaks. pos is block of node the value belongs to, for
+// CHILDREN_CNT it is child block.
+struct IntegrityError {
+  IntegrityErrorKind kind;
+  uint64_t pos;
+  uint64_t stored;
+  uint64_t actual;
+};
+
+// Only the first max_kept_integrity_errors errors are kept, all are counted.
+constexpr size_t max_kept_integrity_errors = 1000;
+
+struct IntegrityReport {
+  size_t nodes_cnt = 0;  // Nodes checked.
+  size_t errors_cnt = 0;
+  std::array<size_t, integrity_error_kinds_cnt> errors_by_kind{};
+  std::vector<IntegrityError> errors;
+
+  [[nodiscard]] bool IsValid() const {
+    return errors_cnt == 0;
+  }
+};
+
+void AddIntegrityError(IntegrityReport &report, const IntegrityError &error);
+
+// Add counters and errors of other to report.
+void MergeIntegrityReports(IntegrityReport &report,
+                           const IntegrityReport &other);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+inline void AddIntegrityError(IntegrityReport &report,
+                              const IntegrityError &error) {
+  ++report.errors_cnt;
+  ++report.errors_by_kind[static_cast<size_t>(error.kind)];
+  if (report.errors.size() < max_kept_integrity_errors) {
+    report.errors.push_back(error);
+  }
+}
+
+inline void MergeIntegrityReports(IntegrityReport &report,
+                                  const IntegrityReport &other) {
+  report.nodes_cnt += other.nodes_cnt;
+  report.errors_cnt += other.errors_cnt;
+  for (size_t i = 0; i < integrity_error_kinds_cnt; ++i) {
+    report.errors_by_kind[i] += other.errors_by_kind[i];
+  }
+  for (const IntegrityError &error: other.errors) {
+    if (report.errors.size() == max_kept_integrity_errors) {
+      break;
+    }
+    report.errors.push_back(error);
+  }
+}
+
+#endif //B_TREE_LIST_LIB__INTEGRITY_REPORT_HPP_
@@ -0,0 +1,155 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "data_info.hpp"
+
+#ifndef B_TREE_LIST_LIB__MAPPING_WINDOWS_HPP_
+#define B_TREE_LIST_LIB__MAPPING_WINDOWS_HPP_
+
+typedef uint64_t file_pos_t;
+typedef int64_t signed_file_pos_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Mapping windows                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Splits blocks of file mapping into windows of equal number of blocks and
+ * keeps at most windows_cnt recently used ones. When another window is
+ * touched, the least recently used one is written back (msync), its pages are
+ * dropped from mapping (MADV_DONTNEED only removes page table entries) and
+ * then from page cache (POSIX_FADV_DONTNEED on the same file range). Data is
+ * read back from file on the next access, so pointers into dropped windows
+ * stay valid. Pages of memory file (ANONYMOUS_MEMORY backend) can not leave
+ * page cache, for it budget only limits mapped pages.
+ */
+
+class MappingWindows {
+ public:
+  ~MappingWindows();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Functions                                                                //
+  //////////////////////////////////////////////////////////////////////////////
+
+  // Blocks are mapped from file at path, the first one is on blocks_offset
+  // in file. Throws filesystem_error if file can not be opened.
+  MappingWindows(size_t blocks_per_window,
+                 size_t windows_cnt,
+                 const std::string &path,
+                 size_t blocks_offset);
+
+  MappingWindows(const MappingWindows &other) = delete;
+
+  // Mark window of block pos as used. blocks_begin and blocks_length describe
+  // current mapping of blocks. Can be called by several threads.
+  void Touch(file_pos_t pos, char* blocks_begin, size_t blocks_length,
+             size_t block_size);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::list<size_t> _lru;  // The most recently used window first.
+  std::unordered_map<size_t, std::list<size_t>::iterator> _windows;
+  std::atomic<size_t> _last_window;  // Touched without taking lock.
+  std::mutex _mutex;
+  size_t _blocks_per_window;
+  size_t _windows_cnt;
+  int _fd;  // Descriptor of mapped file for dropping pages from page cache.
+  size_t _blocks_offset;
+  std::atomic<uint64_t> _evicted_cnt;  // Read without taking lock.
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Friend classes                                                           //
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend class BlockRW;
+
+  template <typename ElementType, size_t T, typename TracePolicy,
+            typename AggregatePolicy>
+  friend class FileSavingManager;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+MappingWindows::MappingWindows(size_t blocks_per_window,
+                               size_t windows_cnt,
+                               const std::string &path,
+                               size_t blocks_offset)
+  : _last_window(SIZE_MAX),
+    _blocks_per_window(std::max<size_t>(blocks_per_window, 1)),
+    _windows_cnt(std::max<size_t>(windows_cnt, 1)),
+    _fd(open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    _blocks_offset(blocks_offset),
+    _evicted_cnt(0) {
+  if (_fd == -1) {
+    throw std::filesystem::filesystem_error(
+        "can not open mapped file", path,
+        std::error_code(errno, std::generic_category()));
+  }
+}
+
+MappingWindows::~MappingWindows() {
+  close(_fd);
+}
+
+/*
+ * Consecutive accesses to the same window, the common case for node reads,
+ * cost one atomic load. Eviction waits for writeback of dirty pages of cold
+ * window, because page cache keeps dirty pages.
+ */
+
+void MappingWindows::Touch(file_pos_t pos,
+                           char* blocks_begin,
+                           size_t blocks_length,
+                           size_t block_size) {
+  size_t window = pos / _blocks_per_window;
+  if (_last_window.load(std::memory_order_relaxed) == window) {
+    return;
+  }
+  std::lock_guard lock(_mutex);
+  _last_window.store(window, std::memory_order_relaxed);
+  auto window_it = _windows.find(window);
+  if (window_it != _windows.end()) {
+    _lru.splice(_lru.begin(), _lru, window_it->second);
+    return;
+  }
+  _lru.push_front(window);
+  _windows[window] = _lru.begin();
+  if (_lru.size() <= _windows_cnt) {
+    return;
+  }
+  size_t cold_window = _lru.back();
+  _lru.pop_back();
+  _windows.erase(cold_window);
+  size_t window_size = _blocks_per_window * block_size;
+  size_t cold_offset = cold_window * window_size;
+  if (cold_offset < blocks_length) {
+    size_t cold_length = std::min(window_size, blocks_length - cold_offset);
+    msync(blocks_begin + cold_offset, cold_length, MS_SYNC);
+    madvise(blocks_begin + cold_offset, cold_length, MADV_DONTNEED);
+    posix_fadvise(_fd, static_cast<off_t>(_blocks_offset + cold_offset),
+                  static_cast<off_t>(cold_length), POSIX_FADV_DONTNEED);
+  }
+  _evicted_cnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+#endif //B_TREE_LIST_LIB__MAPPING_WINDOWS_HPP_
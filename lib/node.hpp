@@ -7,6 +7,7 @@
 #include <utility>
 #include <vector>
 #include <boost/interprocess/mapped_region.hpp>
+#include "aggregate_policy.hpp"
 
 #ifndef B_TREE_LIST_LIB__NODE_HPP_
 #define B_TREE_LIST_LIB__NODE_HPP_
@@ -22,11 +23,14 @@ inline int CeilDiv(int a, int b) {
 // Node                                                                       //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
+template <typename ElementType, size_t T,
+          typename AggregatePolicy = NoAggregatePolicy>
 class Node{
  private:
   struct _NodeInfo;
 
+  typedef typename AggregatePolicy::ValueType AggregateType;
+
   //////////////////////////////////////////////////////////////////////////////
   // Functions                                                                //
   //////////////////////////////////////////////////////////////////////////////
@@ -43,17 +47,19 @@ class Node{
        std::vector<size_t>  &&children_cnts,
        uint32_t flags = 0);
 
-  Node(const Node<ElementType, T> &other);
+  Node(const Node<ElementType, T, AggregatePolicy> &other);
 
-  Node(Node<ElementType, T> &&other);
+  Node(Node<ElementType, T, AggregatePolicy> &&other);
 
   //////////////////////////////////////////////////////////////////////////////
   // Assign operator                                                          //
   //////////////////////////////////////////////////////////////////////////////
 
-  Node<ElementType, T>& operator=(Node<ElementType, T> &&other);
+  Node<ElementType, T, AggregatePolicy>& operator=(
+      Node<ElementType, T, AggregatePolicy> &&other);
 
-  Node<ElementType, T>& operator=(const Node<ElementType, T> &other);
+  Node<ElementType, T, AggregatePolicy>& operator=(
+      const Node<ElementType, T, AggregatePolicy> &other);
 
   //////////////////////////////////////////////////////////////////////////////
   // Getters/setters                                                          //
@@ -81,6 +87,12 @@ class Node{
 
   void SetChildrenCnts(unsigned i, size_t cc_before, size_t cc_after);
 
+  // Aggregates of children subtrees. Must not be called if list has no
+  // aggregate policy.
+  AggregateType& AggregateAfter(unsigned i);
+
+  AggregateType& AggregateBefore(unsigned i);
+
   _NodeInfo GetNodeInfo() const;
 
   //////////////////////////////////////////////////////////////////////////////
@@ -112,15 +124,23 @@ class Node{
 
   size_t ExtractBackChildrenCnt();
 
+  // Aggregate extracts do nothing and return identity if list has no
+  // aggregate policy.
+  AggregateType ExtractAggregateAfter(unsigned i);
+
+  AggregateType ExtractAggregateBefore(unsigned i);
+
+  AggregateType ExtractBackAggregate();
+
   ElementType ExtractBack();
 
   //////////////////////////////////////////////////////////////////////////////
   // Separation functions                                                     //
   //////////////////////////////////////////////////////////////////////////////
 
-  Node<ElementType, T> NodeFromFirstHalf();
+  Node<ElementType, T, AggregatePolicy> NodeFromFirstHalf();
 
-  Node<ElementType, T> NodeFromSecondHalf();
+  Node<ElementType, T, AggregatePolicy> NodeFromSecondHalf();
 
   ElementType GetMiddleElement() const;
 
@@ -128,7 +148,8 @@ class Node{
   // Connect                                                                  //
   //////////////////////////////////////////////////////////////////////////////
 
-  void ConnectWith(ElementType e, const Node<ElementType, T> &other);
+  void ConnectWith(ElementType e,
+                   const Node<ElementType, T, AggregatePolicy> &other);
 
   //////////////////////////////////////////////////////////////////////////////
   // Flags setters/getters                                                    //
@@ -156,6 +177,8 @@ class Node{
 
   [[nodiscard]] size_t CCArraySize() const;
 
+  [[nodiscard]] size_t AggregatesArraySize() const;
+
   //////////////////////////////////////////////////////////////////////////////
   // Resize functions                                                         //
   //////////////////////////////////////////////////////////////////////////////
@@ -185,6 +208,7 @@ class Node{
   std::vector<ElementType> _elements;
   std::vector<file_pos_t> _links;
   std::vector<size_t> _children_cnts;
+  std::vector<AggregateType> _aggregates;  // Empty if not aggregated.
   uint32_t _flags;
 
   //////////////////////////////////////////////////////////////////////////////
@@ -198,41 +222,56 @@ class Node{
   const static ptrdiff_t cc_offset =
       sizeof(struct _NodeInfo) + (2 * T - 1) * sizeof(ElementType) +
       (2 * T) * sizeof(file_pos_t);
+  constexpr static bool aggregated = is_aggregated_v<AggregatePolicy>;
+  // Aggregates follow children counts, so lists without them keep the same
+  // block layout.
+  const static ptrdiff_t aggregates_offset =
+      (cc_offset + (2 * T) * sizeof(size_t) + alignof(AggregateType) - 1) /
+      alignof(AggregateType) * alignof(AggregateType);
   const static size_t inmemory_size =
-      sizeof(struct _NodeInfo) + (2 * T - 1) * sizeof(ElementType) +
-      (2 * T) * (sizeof(file_pos_t) + sizeof(size_t));
+      aggregated ? aggregates_offset + (2 * T) * sizeof(AggregateType)
+                 : sizeof(struct _NodeInfo) +
+                   (2 * T - 1) * sizeof(ElementType) +
+                   (2 * T) * (sizeof(file_pos_t) + sizeof(size_t));
 
   //////////////////////////////////////////////////////////////////////////////
   // Friend classes                                                           //
   //////////////////////////////////////////////////////////////////////////////
 
-  template <typename _ElementType, size_t _T>
+  template <typename _ElementType, size_t _T, typename _TracePolicy,
+            typename _AggregatePolicy>
   friend class BTreeList;
 
-  template <typename _ElementType, size_t _T>
+  template <typename _ElementType, size_t _T, typename _TracePolicy,
+            typename _AggregatePolicy>
   friend class FileSavingManager;
 
   friend class BlockRW;
 
-  template <typename _ElementType, size_t _T>
-  friend Node<_ElementType, _T> Connect(const Node<_ElementType, _T> &left_node,
-                                        const Node<_ElementType, _T> &right_node,
-                                        const _ElementType &element);
+  template <typename _ElementType, size_t _T, typename _AggregatePolicy>
+  friend Node<_ElementType, _T, _AggregatePolicy> Connect(
+      const Node<_ElementType, _T, _AggregatePolicy> &left_node,
+      const Node<_ElementType, _T, _AggregatePolicy> &right_node,
+      const _ElementType &element);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation                                                             //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>::Node()
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::Node()
   : _elements(0),
     _links(1, static_cast<file_pos_t>(0)),
     _children_cnts(1, static_cast<size_t>(0)),
-    _flags(_Flags::ROOT | _Flags::LEAF) {}
+    _flags(_Flags::ROOT | _Flags::LEAF) {
+  if constexpr (aggregated) {
+    _aggregates.assign(1, AggregatePolicy::Identity());
+  }
+}
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>::Node(
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::Node(
     const std::vector<_ElementType>& v,
     const std::vector<file_pos_t> &links,
     const std::vector<uint64_t> &children_cnts,
@@ -240,10 +279,14 @@ Node<_ElementType, T>::Node(
 ) : _elements(v),
     _links(links),
     _children_cnts(children_cnts),
-    _flags(flags) {}
+    _flags(flags) {
+  if constexpr (aggregated) {
+    _aggregates.assign(_children_cnts.size(), AggregatePolicy::Identity());
+  }
+}
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>::Node(
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::Node(
     std::vector<_ElementType> &&v,
     std::vector<file_pos_t> &&links,
     std::vector<uint64_t> &&children_cnts,
@@ -251,44 +294,58 @@ Node<_ElementType, T>::Node(
 ) : _elements(std::move(v)),
     _links(std::move(links)),
     _children_cnts(std::move(children_cnts)),
-    _flags(flags) {}
+    _flags(flags) {
+  if constexpr (aggregated) {
+    _aggregates.assign(_children_cnts.size(), AggregatePolicy::Identity());
+  }
+}
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>::Node(const Node<_ElementType, T> &other)
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::Node(
+    const Node<_ElementType, T, AggregatePolicy> &other
+)
   : _elements(other._elements),
     _links(other._links),
     _children_cnts(other._children_cnts),
+    _aggregates(other._aggregates),
     _flags(other._flags) {}
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>::Node(Node<_ElementType, T> &&other)
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::Node(
+    Node<_ElementType, T, AggregatePolicy> &&other
+)
   : _elements(std::move(other._elements)),
     _links(std::move(other._links)),
     _children_cnts(std::move(other._children_cnts)),
+    _aggregates(std::move(other._aggregates)),
     _flags(other._flags) {}
 
 ////////////////////////////////////////////////////////////////////////////////
 // Assignment operator                                                        //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>& Node<_ElementType, T>::operator=(
-    Node<_ElementType, T> &&other
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>&
+Node<_ElementType, T, AggregatePolicy>::operator=(
+    Node<_ElementType, T, AggregatePolicy> &&other
 ) {
   _elements = std::move(other._elements);
   _links = std::move(other._links);
   _children_cnts = std::move(other._children_cnts);
+  _aggregates = std::move(other._aggregates);
   _flags = other._flags;
   return *this;
 }
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T>& Node<_ElementType, T>::operator=(
-    const Node<_ElementType, T> &other
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>&
+Node<_ElementType, T, AggregatePolicy>::operator=(
+    const Node<_ElementType, T, AggregatePolicy> &other
 ) {
   _elements = other._elements;
   _links = other._links;
   _children_cnts = other._children_cnts;
+  _aggregates = other._aggregates;
   _flags = other._flags;
   return *this;
 }
@@ -297,53 +354,59 @@ Node<_ElementType, T>& Node<_ElementType, T>::operator=(
 // Getters/setters                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-_ElementType& Node<_ElementType, T>::Element(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+_ElementType& Node<_ElementType, T, AggregatePolicy>::Element(unsigned i) {
   return _elements[i];
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t& Node<_ElementType, T>::LinkAfter(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t& Node<_ElementType, T, AggregatePolicy>::LinkAfter(unsigned i) {
   return _links[i + 1];
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t& Node<_ElementType, T>::LinkBefore(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t& Node<_ElementType, T, AggregatePolicy>::LinkBefore(unsigned i) {
   return _links[i];
 }
 
-template <typename _ElementType, size_t T>
-[[maybe_unused]] file_pos_t Node<_ElementType, T>::LinkAfter(unsigned i) const {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+[[maybe_unused]] file_pos_t Node<_ElementType, T, AggregatePolicy>::LinkAfter(
+    unsigned i
+) const {
   return _links[i + 1];
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t Node<_ElementType, T>::LinkBefore(unsigned i) const {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t Node<_ElementType, T, AggregatePolicy>::LinkBefore(
+    unsigned i
+) const {
   return _links[i];
 }
 
-template <typename _ElementType, size_t T>
-size_t& Node<_ElementType, T>::ChildrenCntAfter(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+size_t& Node<_ElementType, T, AggregatePolicy>::ChildrenCntAfter(unsigned i) {
   return _children_cnts[i + 1];
 }
 
-template <typename _ElementType, size_t T>
-size_t& Node<_ElementType, T>::ChildrenCntBefore(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+size_t& Node<_ElementType, T, AggregatePolicy>::ChildrenCntBefore(unsigned i) {
   return _children_cnts[i];
 }
 
-template <typename _ElementType, size_t T>
-[[maybe_unused]] size_t Node<_ElementType, T>::ChildrenCntAfter(unsigned i) const {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+[[maybe_unused]] size_t
+Node<_ElementType, T, AggregatePolicy>::ChildrenCntAfter(unsigned i) const {
   return _children_cnts[i + 1];
 }
 
-template <typename _ElementType, size_t T>
-[[maybe_unused]] size_t Node<_ElementType, T>::ChildrenCntBefore(unsigned i) const {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+[[maybe_unused]] size_t
+Node<_ElementType, T, AggregatePolicy>::ChildrenCntBefore(unsigned i) const {
   return _children_cnts[i];
 }
 
-template <typename _ElementType, size_t T>
-void Node<_ElementType, T>::SetLinks(
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+void Node<_ElementType, T, AggregatePolicy>::SetLinks(
     unsigned i,
     file_pos_t link_before,
     file_pos_t link_after
@@ -352,8 +415,8 @@ void Node<_ElementType, T>::SetLinks(
   LinkAfter(i) = link_after;
 }
 
-template <typename _ElementType, size_t T>
-void Node<_ElementType, T>::SetChildrenCnts(
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+void Node<_ElementType, T, AggregatePolicy>::SetChildrenCnts(
     unsigned i,
     size_t cc_before,
     size_t cc_after
@@ -362,35 +425,55 @@ void Node<_ElementType, T>::SetChildrenCnts(
   ChildrenCntAfter(i) = cc_after;
 }
 
-template <typename ElementType, size_t T>
-struct Node<ElementType, T>::_NodeInfo
-Node<ElementType, T>::GetNodeInfo() const {
-  return Node<ElementType, T>::_NodeInfo{Size(), _flags};
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType&
+Node<_ElementType, T, AggregatePolicy>::AggregateAfter(unsigned i) {
+  return _aggregates[i + 1];
+}
+
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType&
+Node<_ElementType, T, AggregatePolicy>::AggregateBefore(unsigned i) {
+  return _aggregates[i];
+}
+
+template <typename ElementType, size_t T, typename AggregatePolicy>
+struct Node<ElementType, T, AggregatePolicy>::_NodeInfo
+Node<ElementType, T, AggregatePolicy>::GetNodeInfo() const {
+  return Node<ElementType, T, AggregatePolicy>::_NodeInfo{Size(), _flags};
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Adding elements                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-void Node<_ElementType, T>::PushBack(const _ElementType &e) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+void Node<_ElementType, T, AggregatePolicy>::PushBack(const _ElementType &e) {
   _elements.push_back(e);
   _links.push_back(0);
   _children_cnts.push_back(0);
+  if constexpr (aggregated) {
+    _aggregates.push_back(AggregatePolicy::Identity());
+  }
 }
 
-template <typename _ElementType, size_t T>
-void Node<_ElementType, T>::Insert(unsigned i, const _ElementType &e) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+void Node<_ElementType, T, AggregatePolicy>::Insert(unsigned i,
+                                                    const _ElementType &e) {
   _elements.insert(_elements.begin() + i, e);
   _links.insert(_links.begin() + i + 1, 0);
   _children_cnts.insert(_children_cnts.begin() + i + 1, 0);
+  if constexpr (aggregated) {
+    _aggregates.insert(_aggregates.begin() + i + 1,
+                       AggregatePolicy::Identity());
+  }
 }
 
-template<typename ElementType, size_t T>
+template<typename ElementType, size_t T, typename AggregatePolicy>
 template<typename IteratorType>
-void Node<ElementType, T>::Insert(unsigned int i,
-                                  const IteratorType &begin,
-                                  const IteratorType &end) {
+void Node<ElementType, T, AggregatePolicy>::Insert(unsigned int i,
+                                                   const IteratorType &begin,
+                                                   const IteratorType &end) {
   int cnt = end - begin;
   _elements.insert(_elements.begin() + i, begin, end);
   std::vector<file_pos_t> links_to_insert(cnt, 0);
@@ -401,63 +484,105 @@ void Node<ElementType, T>::Insert(unsigned int i,
   _children_cnts.insert(_children_cnts.begin() + i + 1,
                         cnts_to_insert.begin(),
                         cnts_to_insert.end());
+  if constexpr (aggregated) {
+    _aggregates.insert(_aggregates.begin() + i + 1, cnt,
+                       AggregatePolicy::Identity());
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Extracts                                                                   //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-_ElementType Node<_ElementType, T>::Extract(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+_ElementType Node<_ElementType, T, AggregatePolicy>::Extract(unsigned i) {
   _ElementType element = _elements[i];
   _elements.erase(_elements.begin() + i);
   return element;
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t Node<_ElementType, T>::ExtractLinkAfter(unsigned i) {
-  unsigned index = _links[i + 1];
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t Node<_ElementType, T, AggregatePolicy>::ExtractLinkAfter(
+    unsigned i
+) {
+  file_pos_t index = _links[i + 1];
   _links.erase(_links.begin() + i + 1);
   return index;
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t Node<_ElementType, T>::ExtractLinkBefore(unsigned i) {
-  unsigned index = _links[i];
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t Node<_ElementType, T, AggregatePolicy>::ExtractLinkBefore(
+    unsigned i
+) {
+  file_pos_t index = _links[i];
   _links.erase(_links.begin() + i);
   return index;
 }
 
-template <typename _ElementType, size_t T>
-size_t Node<_ElementType, T>::ExtractChildrenCntAfter(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+size_t Node<_ElementType, T, AggregatePolicy>::ExtractChildrenCntAfter(
+    unsigned i
+) {
   size_t cnt = _children_cnts[i + 1];
   _children_cnts.erase(_children_cnts.begin() + i + 1);
   return cnt;
 }
 
-template <typename _ElementType, size_t T>
-size_t Node<_ElementType, T>::ExtractChildrenCntBefore(unsigned i) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+size_t Node<_ElementType, T, AggregatePolicy>::ExtractChildrenCntBefore(
+    unsigned i
+) {
   size_t cnt = _children_cnts[i];
   _children_cnts.erase(_children_cnts.begin() + i);
   return cnt;
 }
 
-template <typename _ElementType, size_t T>
-file_pos_t Node<_ElementType, T>::ExtractBackLink() {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+file_pos_t Node<_ElementType, T, AggregatePolicy>::ExtractBackLink() {
   file_pos_t index = _links.back();
   _links.pop_back();
   return index;
 }
 
-template <typename _ElementType, size_t T>
-size_t Node<_ElementType, T>::ExtractBackChildrenCnt() {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+size_t Node<_ElementType, T, AggregatePolicy>::ExtractBackChildrenCnt() {
   size_t cnt = _children_cnts.back();
   _children_cnts.pop_back();
   return cnt;
 }
 
-template <typename _ElementType, size_t T>
-_ElementType Node<_ElementType, T>::ExtractBack() {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+Node<_ElementType, T, AggregatePolicy>::ExtractAggregateAfter(unsigned i) {
+  return ExtractAggregateBefore(i + 1);
+}
+
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+Node<_ElementType, T, AggregatePolicy>::ExtractAggregateBefore(unsigned i) {
+  if constexpr (!aggregated) {
+    return AggregatePolicy::Identity();
+  } else {
+    AggregateType aggregate = _aggregates[i];
+    _aggregates.erase(_aggregates.begin() + i);
+    return aggregate;
+  }
+}
+
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+typename AggregatePolicy::ValueType
+Node<_ElementType, T, AggregatePolicy>::ExtractBackAggregate() {
+  if constexpr (!aggregated) {
+    return AggregatePolicy::Identity();
+  } else {
+    AggregateType aggregate = _aggregates.back();
+    _aggregates.pop_back();
+    return aggregate;
+  }
+}
+
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+_ElementType Node<_ElementType, T, AggregatePolicy>::ExtractBack() {
   _ElementType element = _elements.back();
   _elements.pop_back();
   return element;
@@ -467,9 +592,10 @@ _ElementType Node<_ElementType, T>::ExtractBack() {
 // Separation functions                                                       //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T> Node<_ElementType, T>::NodeFromFirstHalf() {
-  return Node<_ElementType, T> (
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::NodeFromFirstHalf() {
+  Node<_ElementType, T, AggregatePolicy> half_node(
     std::vector<_ElementType>(_elements.begin(),
                               _elements.begin() + _elements.size() / 2),
     std::vector<file_pos_t>(_links.begin(),
@@ -478,11 +604,17 @@ Node<_ElementType, T> Node<_ElementType, T>::NodeFromFirstHalf() {
                         _children_cnts.begin() + _children_cnts.size() / 2),
     this->_flags & ~_Flags::ROOT
   );
+  if constexpr (aggregated) {
+    half_node._aggregates.assign(
+        _aggregates.begin(), _aggregates.begin() + _aggregates.size() / 2);
+  }
+  return half_node;
 }
 
-template <typename _ElementType, size_t T>
-Node<_ElementType, T> Node<_ElementType, T>::NodeFromSecondHalf() {
-  return Node<_ElementType, T>(
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>
+Node<_ElementType, T, AggregatePolicy>::NodeFromSecondHalf() {
+  Node<_ElementType, T, AggregatePolicy> half_node(
     std::vector<_ElementType>(_elements.end() - _elements.size() / 2,
                               _elements.end()),
     std::vector<file_pos_t>(_links.end() - _links.size() / 2,
@@ -491,10 +623,15 @@ Node<_ElementType, T> Node<_ElementType, T>::NodeFromSecondHalf() {
                         _children_cnts.end()),
     this->_flags & ~_Flags::ROOT
   );
+  if constexpr (aggregated) {
+    half_node._aggregates.assign(
+        _aggregates.end() - _aggregates.size() / 2, _aggregates.end());
+  }
+  return half_node;
 }
 
-template <typename _ElementType, size_t T>
-_ElementType Node<_ElementType, T>::GetMiddleElement() const {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+_ElementType Node<_ElementType, T, AggregatePolicy>::GetMiddleElement() const {
   return *(_elements.begin() + _elements.size() / 2);
 }
 
@@ -502,9 +639,11 @@ _ElementType Node<_ElementType, T>::GetMiddleElement() const {
 // Connect                                                                    //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename _ElementType, size_t T>
-void Node<_ElementType, T>::ConnectWith(_ElementType e,
-                                        const Node<_ElementType, T> &other) {
+template <typename _ElementType, size_t T, typename AggregatePolicy>
+void Node<_ElementType, T, AggregatePolicy>::ConnectWith(
+    _ElementType e,
+    const Node<_ElementType, T, AggregatePolicy> &other
+) {
   _elements.push_back(e);
   _elements.insert(_elements.end(),
                    other._elements.begin(),
@@ -513,29 +652,34 @@ void Node<_ElementType, T>::ConnectWith(_ElementType e,
   _children_cnts.insert(_children_cnts.end(),
                         other._children_cnts.begin(),
                         other._children_cnts.end());
+  _aggregates.insert(_aggregates.end(),
+                     other._aggregates.begin(),
+                     other._aggregates.end());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Flags setters and getters                                                  //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-bool Node<ElementType, T>::GetIsRoot() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+bool Node<ElementType, T, AggregatePolicy>::GetIsRoot() const {
   return _flags & _Flags::ROOT ;
 }
 
-template <typename ElementType, size_t T>
-void Node<ElementType, T>::SetIsRoot(bool flag_to_set) {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+void Node<ElementType, T, AggregatePolicy>::SetIsRoot(bool flag_to_set) {
   _flags = (_flags & ~1UL) | flag_to_set;
 }
 
-template <typename ElementType, size_t T>
-bool Node<ElementType, T>::GetIsLeaf() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+bool Node<ElementType, T, AggregatePolicy>::GetIsLeaf() const {
   return _flags & _Flags::LEAF;
 }
 
-template <typename ElementType, size_t T>
-[[maybe_unused]] void Node<ElementType, T>::SetIsLeaf(bool flag_to_set) {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+[[maybe_unused]] void Node<ElementType, T, AggregatePolicy>::SetIsLeaf(
+    bool flag_to_set
+) {
   _flags = (_flags & ~2UL) | (flag_to_set << 1);
 }
 
@@ -543,8 +687,8 @@ template <typename ElementType, size_t T>
 // Size getters                                                               //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-size_t Node<ElementType, T>::GetAllChildrenCnt() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::GetAllChildrenCnt() const {
   size_t sum = 0;
   for (auto i: _children_cnts) {
     sum += i;
@@ -553,54 +697,69 @@ size_t Node<ElementType, T>::GetAllChildrenCnt() const {
   return sum;
 }
 
-template <typename ElementType, size_t T>
-size_t Node<ElementType, T>::Size() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::Size() const {
   return _elements.size();
 }
 
-template <typename ElementType, size_t T>
-size_t Node<ElementType, T>::ElementsArraySize() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::ElementsArraySize() const {
   return _elements.size() * sizeof(ElementType);
 }
 
-template <typename ElementType, size_t T>
-size_t Node<ElementType, T>::LinksArraySize() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::LinksArraySize() const {
   return _links.size() * sizeof(file_pos_t);
 }
 
-template <typename ElementType, size_t T>
-size_t Node<ElementType, T>::CCArraySize() const {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::CCArraySize() const {
   return _children_cnts.size() * sizeof(size_t);
 }
 
+template <typename ElementType, size_t T, typename AggregatePolicy>
+size_t Node<ElementType, T, AggregatePolicy>::AggregatesArraySize() const {
+  return _aggregates.size() * sizeof(AggregateType);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Resize functions                                                           //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-void Node<ElementType, T>::Resize(size_t new_size) {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+void Node<ElementType, T, AggregatePolicy>::Resize(size_t new_size) {
   _elements.resize(new_size);
   _links.resize(new_size + 1, static_cast<file_pos_t >(0));
   _children_cnts.resize(new_size + 1, static_cast<size_t >(0));
+  if constexpr (aggregated) {
+    _aggregates.resize(new_size + 1, AggregatePolicy::Identity());
+  }
 }
 
-template <typename ElementType, size_t T>
-void Node<ElementType, T>::Resize(size_t new_size,
-                                  const ElementType& element_to_fill) {
+template <typename ElementType, size_t T, typename AggregatePolicy>
+void Node<ElementType, T, AggregatePolicy>::Resize(
+    size_t new_size,
+    const ElementType& element_to_fill
+) {
   _elements.resize(new_size, element_to_fill);
   _links.resize(new_size + 1, static_cast<file_pos_t >(0));
   _children_cnts.resize(new_size + 1, static_cast<size_t >(0));
+  if constexpr (aggregated) {
+    _aggregates.resize(new_size + 1, AggregatePolicy::Identity());
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Friend functions                                                           //
 ////////////////////////////////////////////////////////////////////////////////
 
-template <typename ElementType, size_t T>
-Node<ElementType, T> Connect(const Node<ElementType, T> &left_node,
-                             const Node<ElementType, T> &right_node,
-                             const ElementType &e) {
-  Node<ElementType, T> node_to_return = left_node;
+template <typename ElementType, size_t T, typename AggregatePolicy>
+Node<ElementType, T, AggregatePolicy> Connect(
+    const Node<ElementType, T, AggregatePolicy> &left_node,
+    const Node<ElementType, T, AggregatePolicy> &right_node,
+    const ElementType &e
+) {
+  Node<ElementType, T, AggregatePolicy> node_to_return = left_node;
   node_to_return.ConnectWith(e, right_node);
   return node_to_return;
 }
@@ -0,0 +1,178 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+#include "data_info.hpp"
+
+#ifndef B_TREE_LIST_LIB__PINNED_BLOCKS_HPP_
+#define B_TREE_LIST_LIB__PINNED_BLOCKS_HPP_
+
+typedef uint64_t file_pos_t;
+typedef int64_t signed_file_pos_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Pinned blocks                                                              //
+////////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Copies of hot blocks kept in anonymous memory (optionally locked) instead
+ * of file mapping. While block is pinned, its copy is the only valid one.
+ * Slots are found by dense array indexed by block position, so lookup on
+ * every block access is one load.
+ */
+
+class PinnedBlocks {
+ public:
+  ~PinnedBlocks();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Functions                                                                //
+  //////////////////////////////////////////////////////////////////////////////
+
+  PinnedBlocks(size_t block_size, bool lock_flag);
+
+  PinnedBlocks(const PinnedBlocks &other) = delete;
+
+  // Get pinned copy of block or nullptr if block is not pinned
+  [[nodiscard]] char* Find(file_pos_t pos) const;
+
+  // Get memory for block copy. Content is to be filled by caller.
+  char* Pin(file_pos_t pos);
+
+  void Unpin(file_pos_t pos);
+
+  [[nodiscard]] bool Empty() const;
+
+  // True if lock was asked, but mlock failed for some memory of copies.
+  // Such memory is still used, it just can be swapped out.
+  [[nodiscard]] bool LockFailed() const;
+
+  // Throws bad_alloc if memory can not be mapped.
+  void _Grow();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  static constexpr file_pos_t no_pos = std::numeric_limits<file_pos_t>::max();
+
+  std::vector<size_t> _slot_by_pos;  // Slot + 1, zero if not pinned.
+  std::vector<file_pos_t> _pos_by_slot;  // no_pos if slot is free.
+  std::vector<size_t> _free_slots;
+  char* _buffer;
+  size_t _slots_cnt;
+  size_t _pinned_cnt;
+  size_t _block_size;
+  bool _lock_flag;
+  bool _lock_failed_flag;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Friend classes                                                           //
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend class BlockRW;
+
+  template <typename ElementType, size_t T, typename TracePolicy,
+            typename AggregatePolicy>
+  friend class FileSavingManager;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+PinnedBlocks::PinnedBlocks(size_t block_size, bool lock_flag)
+  : _buffer(nullptr),
+    _slots_cnt(0),
+    _pinned_cnt(0),
+    _block_size(block_size),
+    _lock_flag(lock_flag),
+    _lock_failed_flag(false) {}
+
+char* PinnedBlocks::Find(file_pos_t pos) const {
+  if (pos >= _slot_by_pos.size() || _slot_by_pos[pos] == 0) {
+    return nullptr;
+  }
+  return _buffer + (_slot_by_pos[pos] - 1) * _block_size;
+}
+
+char* PinnedBlocks::Pin(file_pos_t pos) {
+  if (char* pinned = Find(pos)) {
+    return pinned;
+  }
+  if (_free_slots.empty()) {
+    _Grow();
+  }
+  size_t slot = _free_slots.back();
+  _free_slots.pop_back();
+  if (pos >= _slot_by_pos.size()) {
+    _slot_by_pos.resize(pos + 1, 0);
+  }
+  _slot_by_pos[pos] = slot + 1;
+  _pos_by_slot[slot] = pos;
+  ++_pinned_cnt;
+  return _buffer + slot * _block_size;
+}
+
+void PinnedBlocks::Unpin(file_pos_t pos) {
+  if (pos < _slot_by_pos.size() && _slot_by_pos[pos] != 0) {
+    size_t slot = _slot_by_pos[pos] - 1;
+    _free_slots.push_back(slot);
+    _pos_by_slot[slot] = no_pos;
+    _slot_by_pos[pos] = 0;
+    --_pinned_cnt;
+  }
+}
+
+bool PinnedBlocks::Empty() const {
+  return _pinned_cnt == 0;
+}
+
+bool PinnedBlocks::LockFailed() const {
+  return _lock_failed_flag;
+}
+
+/*
+ * Doubles buffer. Pointers to pinned blocks taken before are invalidated,
+ * the same way as with file remapping.
+ */
+
+void PinnedBlocks::_Grow() {
+  size_t new_slots_cnt = std::max<size_t>(2 * _slots_cnt, 16);
+  auto* new_buffer = static_cast<char*>(mmap(nullptr,
+                                             new_slots_cnt * _block_size,
+                                             PROT_READ | PROT_WRITE,
+                                             MAP_PRIVATE | MAP_ANONYMOUS,
+                                             -1, 0));
+  if (new_buffer == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  if (_lock_flag && mlock(new_buffer, new_slots_cnt * _block_size) != 0) {
+    _lock_failed_flag = true;
+  }
+  if (_buffer != nullptr) {
+    std::memcpy(new_buffer, _buffer, _slots_cnt * _block_size);
+    munmap(_buffer, _slots_cnt * _block_size);
+  }
+  for (size_t slot = new_slots_cnt; slot > _slots_cnt; --slot) {
+    _free_slots.push_back(slot - 1);
+  }
+  _pos_by_slot.resize(new_slots_cnt, no_pos);
+  _buffer = new_buffer;
+  _slots_cnt = new_slots_cnt;
+}
+
+PinnedBlocks::~PinnedBlocks() {
+  if (_buffer != nullptr) {
+    munmap(_buffer, _slots_cnt * _block_size);
+  }
+}
+
+#endif //B_TREE_LIST_LIB__PINNED_BLOCKS_HPP_
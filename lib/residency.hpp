@@ -0,0 +1,118 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__RESIDENCY_HPP_
+#define B_TREE_LIST_LIB__RESIDENCY_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+
+// Page cache residency of nodes of one tree level.
+struct LevelResidency {
+  size_t nodes_cnt = 0;
+  size_t pages_cnt = 0;
+  size_t resident_pages_cnt = 0;
+};
+
+// Page cache residency of leaves, which first element index is in
+// [first, last).
+struct RangeResidency {
+  size_t first = 0;
+  size_t last = 0;
+  size_t leaves_cnt = 0;
+  size_t pages_cnt = 0;
+  size_t resident_pages_cnt = 0;
+};
+
+// Extent of file on disk as reported by FIEMAP.
+struct FileExtent {
+  uint64_t logical_offset;
+  uint64_t physical_offset;
+  uint64_t length;
+  uint32_t flags;  // FIEMAP_EXTENT_* flags.
+};
+
+struct ResidencyMap {
+  std::vector<LevelResidency> levels;  // Root level first.
+  std::vector<RangeResidency> ranges;
+  size_t file_pages_cnt = 0;           // Whole mapping, including free blocks.
+  size_t file_resident_pages_cnt = 0;
+  // False if residency of pages can not be taken (mincore failed), resident
+  // pages counts are zero then.
+  bool pages_flag = false;
+  bool extents_flag = false;  // False if file system does not support FIEMAP.
+  std::vector<FileExtent> extents;
+};
+
+// One byte per page of [begin, begin + length), lowest bit is set if page is
+// resident. begin must be page aligned. Returns false if mincore failed,
+// residency is empty then.
+bool GetPagesResidency(const void* begin,
+                       size_t length,
+                       std::vector<unsigned char> &residency);
+
+// Extents of file at path. Returns false if they can not be taken.
+bool GetFileExtents(const std::string &path, std::vector<FileExtent> &extents);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+inline bool GetPagesResidency(const void* begin,
+                              size_t length,
+                              std::vector<unsigned char> &residency) {
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  residency.assign((length + page_size - 1) / page_size, 0);
+  if (mincore(const_cast<void*>(begin), length, residency.data()) != 0) {
+    residency.clear();
+    return false;
+  }
+  return true;
+}
+
+/*
+ * The first call asks only for number of extents. File is not synced, so
+ * delayed allocation extents are reported with FIEMAP_EXTENT_DELALLOC.
+ */
+
+inline bool GetFileExtents(const std::string &path,
+                           std::vector<FileExtent> &extents) {
+  extents.clear();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  struct fiemap request{};
+  request.fm_length = FIEMAP_MAX_OFFSET;
+  if (ioctl(fd, FS_IOC_FIEMAP, &request) != 0) {
+    close(fd);
+    return false;
+  }
+  size_t extents_cnt = request.fm_mapped_extents;
+  std::vector<char> buffer(sizeof(struct fiemap) +
+                           extents_cnt * sizeof(struct fiemap_extent));
+  auto* result = reinterpret_cast<struct fiemap*>(buffer.data());
+  result->fm_length = FIEMAP_MAX_OFFSET;
+  result->fm_extent_count = extents_cnt;
+  bool success_flag = ioctl(fd, FS_IOC_FIEMAP, result) == 0;
+  close(fd);
+  if (!success_flag) {
+    return false;
+  }
+  for (uint32_t i = 0; i < result->fm_mapped_extents; ++i) {
+    const struct fiemap_extent &extent = result->fm_extents[i];
+    extents.push_back(FileExtent{extent.fe_logical, extent.fe_physical,
+                                 extent.fe_length, extent.fe_flags});
+  }
+  return true;
+}
+
+#endif //B_TREE_LIST_LIB__RESIDENCY_HPP_
@@ -0,0 +1,300 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__STATS_HPP_
+#define B_TREE_LIST_LIB__STATS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+// Operations of list with separate latency histograms.
+enum class ListOperation {
+  ACCESS,   // operator[]
+  INSERT,   // Insert of one element, PushBack, PushFront
+  EXTRACT,  // Extract, PopBack, PopFront
+  BATCH,    // Insert of range, GetMany, GetSorted, SetSorted, ApplyBatch
+};
+
+constexpr size_t list_operations_cnt = 4;
+
+// Node copies between file mapping and memory (FileSavingManager).
+struct StorageCounters {
+  uint64_t nodes_read = 0;
+  uint64_t nodes_written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  uint64_t evicted_windows = 0;  // Mapping windows dropped by memory budget.
+};
+
+// Node copy counters of StorageCounters, which are changed by concurrent
+// readers. Relaxed order is enough, counters are only summed.
+struct AtomicStorageCounters {
+  std::atomic<uint64_t> nodes_read = 0;
+  std::atomic<uint64_t> nodes_written = 0;
+  std::atomic<uint64_t> bytes_read = 0;
+  std::atomic<uint64_t> bytes_written = 0;
+
+  AtomicStorageCounters() = default;
+
+  // Copies are made while no other thread uses counters (file manager of
+  // rebuilt list replaces the old one).
+  AtomicStorageCounters(const AtomicStorageCounters &other);
+
+  AtomicStorageCounters& operator=(const AtomicStorageCounters &other);
+
+  void AddRead(uint64_t bytes);
+
+  void AddWritten(uint64_t bytes);
+
+  [[nodiscard]] StorageCounters Load() const;
+
+  void Reset();
+};
+
+// Block allocation (Allocator).
+struct AllocationCounters {
+  uint64_t allocations = 0;
+  uint64_t free_block_hits = 0;  // Allocations which reused deleted block.
+  uint64_t deletions = 0;
+  uint64_t remaps = 0;           // File resizes with remapping.
+};
+
+// Tree rebalancing (BTreeList).
+struct StructureCounters {
+  uint64_t splits = 0;
+  uint64_t merges = 0;
+  uint64_t borrows = 0;  // Element moves from neighbour on extract.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Latency histogram                                                          //
+////////////////////////////////////////////////////////////////////////////////
+
+// Log-linear histogram of nanoseconds, like HDR histogram with 4 bits of
+// precision: every power of two range is split into 16 buckets, so any value
+// is reported with error less than 1/16.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Record(uint64_t value_ns);
+
+  [[nodiscard]] uint64_t Count() const;
+
+  [[nodiscard]] uint64_t Max() const;
+
+  // Upper bound of bucket with p-th quantile, p is in [0, 1].
+  [[nodiscard]] uint64_t Percentile(double p) const;
+
+  void Reset();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  static size_t _BucketIndex(uint64_t value);
+
+  static uint64_t _BucketUpperBound(size_t index);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Static fields                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr static unsigned sub_bucket_bits = 4;
+  constexpr static size_t sub_buckets_cnt = 1 << sub_bucket_bits;
+  constexpr static size_t buckets_cnt = (64 - sub_bucket_bits + 1) *
+                                        sub_buckets_cnt;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::array<uint64_t, buckets_cnt> _counts;
+  uint64_t _count;
+  uint64_t _max;
+};
+
+// Snapshot of all list statistics.
+struct ListStats {
+  StorageCounters storage;
+  AllocationCounters allocation;
+  StructureCounters structure;
+  std::array<LatencyHistogram, list_operations_cnt> latencies;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Latency recorder                                                           //
+////////////////////////////////////////////////////////////////////////////////
+
+// Histograms of one list, filled by LatencyScope. Constant operations of list
+// may run in several threads, so histograms are read and written under mutex.
+struct LatencyRecorder {
+  std::array<LatencyHistogram, list_operations_cnt> histograms;
+  std::mutex mutex;
+};
+
+// Measures time from construction to destruction into histogram of
+// operation. Operations started inside another measured operation of the same
+// thread (for example Insert called by PushBack) are not measured. Recorder
+// may be null.
+class LatencyScope {
+ public:
+  LatencyScope(LatencyRecorder* recorder, ListOperation operation);
+
+  LatencyScope(const LatencyScope&) = delete;
+
+  LatencyScope& operator=(const LatencyScope&) = delete;
+
+  ~LatencyScope();
+
+ private:
+  LatencyRecorder* _recorder;  // Null if operation is not measured.
+  const LatencyRecorder* _outer_recorder;  // Operation recorder of the thread.
+  ListOperation _operation;
+  std::chrono::steady_clock::time_point _start;
+
+  // Recorder of operation running in this thread, null outside operations.
+  inline static thread_local const LatencyRecorder* _operation_recorder =
+      nullptr;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+inline LatencyHistogram::LatencyHistogram()
+    : _counts{},
+      _count(0),
+      _max(0) {}
+
+inline AtomicStorageCounters::AtomicStorageCounters(
+    const AtomicStorageCounters &other) {
+  *this = other;
+}
+
+inline AtomicStorageCounters& AtomicStorageCounters::operator=(
+    const AtomicStorageCounters &other) {
+  StorageCounters counters = other.Load();
+  nodes_read.store(counters.nodes_read, std::memory_order_relaxed);
+  nodes_written.store(counters.nodes_written, std::memory_order_relaxed);
+  bytes_read.store(counters.bytes_read, std::memory_order_relaxed);
+  bytes_written.store(counters.bytes_written, std::memory_order_relaxed);
+  return *this;
+}
+
+inline void AtomicStorageCounters::AddRead(uint64_t bytes) {
+  nodes_read.fetch_add(1, std::memory_order_relaxed);
+  bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+inline void AtomicStorageCounters::AddWritten(uint64_t bytes) {
+  nodes_written.fetch_add(1, std::memory_order_relaxed);
+  bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+inline StorageCounters AtomicStorageCounters::Load() const {
+  StorageCounters counters;
+  counters.nodes_read = nodes_read.load(std::memory_order_relaxed);
+  counters.nodes_written = nodes_written.load(std::memory_order_relaxed);
+  counters.bytes_read = bytes_read.load(std::memory_order_relaxed);
+  counters.bytes_written = bytes_written.load(std::memory_order_relaxed);
+  return counters;
+}
+
+inline void AtomicStorageCounters::Reset() {
+  nodes_read.store(0, std::memory_order_relaxed);
+  nodes_written.store(0, std::memory_order_relaxed);
+  bytes_read.store(0, std::memory_order_relaxed);
+  bytes_written.store(0, std::memory_order_relaxed);
+}
+
+inline void LatencyHistogram::Record(uint64_t value_ns) {
+  ++_counts[_BucketIndex(value_ns)];
+  ++_count;
+  _max = value_ns > _max ? value_ns : _max;
+}
+
+inline uint64_t LatencyHistogram::Count() const {
+  return _count;
+}
+
+inline uint64_t LatencyHistogram::Max() const {
+  return _max;
+}
+
+inline uint64_t LatencyHistogram::Percentile(double p) const {
+  if (_count == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(p * static_cast<double>(_count));
+  rank = rank == 0 ? 1 : rank;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_cnt; ++i) {
+    seen += _counts[i];
+    if (seen >= rank) {
+      uint64_t upper_bound = _BucketUpperBound(i);
+      return upper_bound < _max ? upper_bound : _max;
+    }
+  }
+  return _max;
+}
+
+inline void LatencyHistogram::Reset() {
+  _counts.fill(0);
+  _count = 0;
+  _max = 0;
+}
+
+/*
+ * Values below 16 have own buckets. Other values are bucketed by position of
+ * the highest bit and next 4 bits.
+ */
+
+inline size_t LatencyHistogram::_BucketIndex(uint64_t value) {
+  if (value < sub_buckets_cnt) {
+    return value;
+  }
+  unsigned highest_bit = 63 - __builtin_clzll(value);
+  unsigned shift = highest_bit - sub_bucket_bits;
+  return (highest_bit - sub_bucket_bits + 1) * sub_buckets_cnt +
+         ((value >> shift) & (sub_buckets_cnt - 1));
+}
+
+inline uint64_t LatencyHistogram::_BucketUpperBound(size_t index) {
+  if (index < sub_buckets_cnt) {
+    return index;
+  }
+  unsigned shift = index / sub_buckets_cnt - 1;
+  uint64_t lower_bound = (sub_buckets_cnt + index % sub_buckets_cnt) << shift;
+  return lower_bound + (uint64_t{1} << shift) - 1;
+}
+
+inline LatencyScope::LatencyScope(LatencyRecorder* recorder,
+                                  ListOperation operation)
+    : _recorder(nullptr),
+      _outer_recorder(_operation_recorder),
+      _operation(operation) {
+  if (recorder != nullptr && recorder != _operation_recorder) {
+    _recorder = recorder;
+    _operation_recorder = recorder;
+    _start = std::chrono::steady_clock::now();
+  }
+}
+
+inline LatencyScope::~LatencyScope() {
+  if (_recorder != nullptr) {
+    auto latency = std::chrono::steady_clock::now() - _start;
+    _operation_recorder = _outer_recorder;
+    std::lock_guard lock(_recorder->mutex);
+    _recorder->histograms[static_cast<size_t>(_operation)].Record(
+        static_cast<uint64_t>(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(latency).count()));
+  }
+}
+
+#endif //B_TREE_LIST_LIB__STATS_HPP_
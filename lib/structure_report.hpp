@@ -0,0 +1,62 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__STRUCTURE_REPORT_HPP_
+#define B_TREE_LIST_LIB__STRUCTURE_REPORT_HPP_
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+constexpr size_t fill_buckets_cnt = 10;
+
+// Nodes of one tree level.
+struct LevelStructure {
+  size_t nodes_cnt = 0;
+  size_t elements_cnt = 0;
+};
+
+// How blocks of list file are used. Blocks after free_tail_start are the
+// dead tail: file keeps them only as spare space for new nodes.
+struct BlocksUsage {
+  size_t block_size = 0;
+  size_t file_size = 0;          // Bytes, including data info page.
+  size_t blocks_cnt = 0;         // Blocks in file.
+  size_t free_tail_start = 0;
+  size_t free_blocks_cnt = 0;    // Free blocks before the tail.
+  size_t free_runs_cnt = 0;      // Runs of adjacent free blocks.
+  size_t largest_free_run = 0;
+};
+
+struct StructureReport {
+  unsigned height = 0;
+  size_t size = 0;
+  std::vector<LevelStructure> levels;  // Root level first.
+
+  // Non-root nodes by number of elements. Bucket i holds sizes from
+  // [T-1, 2T-2] range part [i / fill_buckets_cnt, (i + 1) / fill_buckets_cnt).
+  // Sizes out of range break B-tree invariant and are counted separately.
+  std::array<size_t, fill_buckets_cnt> fill_histogram{};
+  size_t underfull_nodes_cnt = 0;
+  size_t overfull_nodes_cnt = 0;
+  double average_fill = 0.;  // Elements per non-root node divided by 2T-2.
+
+  BlocksUsage blocks;
+  size_t nodes_cnt = 0;
+  size_t raw_blocks_cnt = 0;   // Used blocks which are not nodes (BytesList).
+  size_t tail_blocks_cnt = 0;  // Dead tail.
+
+  // Mean of |child block - parent block| over all tree edges.
+  double average_parent_child_distance = 0.;
+
+  // Nodes after rebuild on close (same nodes without gaps) and after
+  // Rebuild(path, 1.) (elements packed into full nodes). Sizes do not include
+  // spare blocks which file grows by.
+  size_t rebuild_blocks_cnt = 0;
+  size_t rebuild_file_size = 0;
+  size_t packed_blocks_cnt = 0;
+  size_t packed_file_size = 0;
+};
+
+#endif //B_TREE_LIST_LIB__STRUCTURE_REPORT_HPP_
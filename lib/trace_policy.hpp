@@ -0,0 +1,277 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__TRACE_POLICY_HPP_
+#define B_TREE_LIST_LIB__TRACE_POLICY_HPP_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Trace policy is the last template parameter of BTreeList. It is a class
+// with static hooks, which are called with position of block:
+//   OnNodeRead(pos), OnNodeWrite(pos)  node is read or written,
+//   OnSplit(pos), OnMerge(pos)         node is split or merged with neighbour,
+//   OnAllocation(pos)                  block is allocated,
+//   OnFileResize(blocks_cnt)           file is resized to blocks_cnt blocks.
+// Hooks of default policy are empty and are removed by compiler.
+
+struct NoTracePolicy {
+  static void OnNodeRead(uint64_t) {}
+  static void OnNodeWrite(uint64_t) {}
+  static void OnSplit(uint64_t) {}
+  static void OnMerge(uint64_t) {}
+  static void OnAllocation(uint64_t) {}
+  static void OnFileResize(uint64_t) {}
+};
+
+enum class TracePointKind : uint8_t {
+  NODE_READ,
+  NODE_WRITE,
+  SPLIT,
+  MERGE,
+  ALLOCATION,
+  FILE_RESIZE,
+};
+
+struct TracePoint {
+  uint64_t time_ns;  // steady_clock time.
+  uint64_t value;    // Block position or blocks count for FILE_RESIZE.
+  uint32_t thread_index;
+  TracePointKind kind;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Ring buffer trace policy                                                   //
+////////////////////////////////////////////////////////////////////////////////
+
+// Keeps the last Capacity trace points of every thread in its own ring
+// buffer. Hooks take no locks: only owner thread writes into a buffer. A lock
+// is taken once per thread, when its buffer is registered. Points of all
+// lists with this policy go to the same buffers.
+template <size_t Capacity = (1 << 16)>
+class RingBufferTracePolicy {
+ public:
+  static void OnNodeRead(uint64_t pos);
+  static void OnNodeWrite(uint64_t pos);
+  static void OnSplit(uint64_t pos);
+  static void OnMerge(uint64_t pos);
+  static void OnAllocation(uint64_t pos);
+  static void OnFileResize(uint64_t blocks_cnt);
+
+  // Points of all threads ordered by time. Points written concurrently with
+  // collecting may be lost or torn, so collect when lists are not used.
+  static std::vector<TracePoint> Collect();
+
+  // Write collected points as instant events of Chrome trace format, which
+  // is opened by chrome://tracing and Perfetto.
+  static void WriteChromeTrace(const std::string &path);
+
+  // Forget all points. Lists should not be used meanwhile.
+  static void Clear();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private types                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  struct _ThreadBuffer {
+    std::array<TracePoint, Capacity> points;
+    std::atomic<uint64_t> written_cnt;
+    uint32_t thread_index;
+  };
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  static void _Push(TracePointKind kind, uint64_t value);
+
+  static _ThreadBuffer& _GetThreadBuffer();
+
+  // Buffers of all threads, including finished ones.
+  static std::vector<std::shared_ptr<_ThreadBuffer>>& _Buffers();
+
+  static std::mutex& _BuffersMutex();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Static fields                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+};
+
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+
+// Static user space probes, which cost one nop when nobody listens. They are
+// listed by "perf list sdt_b_tree_list:*" after "perf buildid-cache --add" of
+// binary and can be recorded by perf, bpftrace or SystemTap.
+struct SdtTracePolicy {
+  static void OnNodeRead(uint64_t pos) {
+    DTRACE_PROBE1(b_tree_list, node_read, pos);
+  }
+  static void OnNodeWrite(uint64_t pos) {
+    DTRACE_PROBE1(b_tree_list, node_write, pos);
+  }
+  static void OnSplit(uint64_t pos) {
+    DTRACE_PROBE1(b_tree_list, split, pos);
+  }
+  static void OnMerge(uint64_t pos) {
+    DTRACE_PROBE1(b_tree_list, merge, pos);
+  }
+  static void OnAllocation(uint64_t pos) {
+    DTRACE_PROBE1(b_tree_list, allocation, pos);
+  }
+  static void OnFileResize(uint64_t blocks_cnt) {
+    DTRACE_PROBE1(b_tree_list, file_resize, blocks_cnt);
+  }
+};
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnNodeRead(uint64_t pos) {
+  _Push(TracePointKind::NODE_READ, pos);
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnNodeWrite(uint64_t pos) {
+  _Push(TracePointKind::NODE_WRITE, pos);
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnSplit(uint64_t pos) {
+  _Push(TracePointKind::SPLIT, pos);
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnMerge(uint64_t pos) {
+  _Push(TracePointKind::MERGE, pos);
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnAllocation(uint64_t pos) {
+  _Push(TracePointKind::ALLOCATION, pos);
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::OnFileResize(uint64_t blocks_cnt) {
+  _Push(TracePointKind::FILE_RESIZE, blocks_cnt);
+}
+
+template <size_t Capacity>
+std::vector<TracePoint> RingBufferTracePolicy<Capacity>::Collect() {
+  std::vector<TracePoint> points;
+  std::lock_guard lock(_BuffersMutex());
+  for (const auto &buffer: _Buffers()) {
+    uint64_t written_cnt = buffer->written_cnt.load(std::memory_order_acquire);
+    uint64_t first = written_cnt > Capacity ? written_cnt - Capacity : 0;
+    for (uint64_t i = first; i < written_cnt; ++i) {
+      points.push_back(buffer->points[i & (Capacity - 1)]);
+    }
+  }
+  std::sort(points.begin(), points.end(),
+            [](const TracePoint &lhs, const TracePoint &rhs) {
+              return lhs.time_ns < rhs.time_ns;
+            });
+  return points;
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::WriteChromeTrace(
+    const std::string &path
+) {
+  const std::array<const char*, 6> names{
+      "node_read", "node_write", "split", "merge", "allocation", "file_resize"
+  };
+  std::ofstream out(path, std::ios::trunc);
+  out << std::fixed << std::setprecision(3);
+  out << "{\"traceEvents\":[";
+  bool first_flag = true;
+  for (const TracePoint &point: Collect()) {
+    out << (first_flag ? "\n" : ",\n")
+        << "{\"name\":\"" << names[static_cast<size_t>(point.kind)]
+        << "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":"
+        << static_cast<double>(point.time_ns) / 1000.
+        << ",\"pid\":" << getpid() << ",\"tid\":" << point.thread_index
+        << ",\"args\":{\""
+        << (point.kind == TracePointKind::FILE_RESIZE ? "blocks" : "block")
+        << "\":" << point.value << "}}";
+    first_flag = false;
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::Clear() {
+  std::lock_guard lock(_BuffersMutex());
+  for (const auto &buffer: _Buffers()) {
+    buffer->written_cnt.store(0, std::memory_order_release);
+  }
+}
+
+template <size_t Capacity>
+void RingBufferTracePolicy<Capacity>::_Push(TracePointKind kind,
+                                            uint64_t value) {
+  _ThreadBuffer &buffer = _GetThreadBuffer();
+  uint64_t written_cnt = buffer.written_cnt.load(std::memory_order_relaxed);
+  buffer.points[written_cnt & (Capacity - 1)] = TracePoint{
+      static_cast<uint64_t>(std::chrono::duration_cast<
+          std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now().time_since_epoch()).count()),
+      value,
+      buffer.thread_index,
+      kind
+  };
+  buffer.written_cnt.store(written_cnt + 1, std::memory_order_release);
+}
+
+/*
+ * Buffer is created and registered on the first hook of thread. Registry
+ * shares it, so points of finished threads can still be collected.
+ */
+
+template <size_t Capacity>
+typename RingBufferTracePolicy<Capacity>::_ThreadBuffer&
+RingBufferTracePolicy<Capacity>::_GetThreadBuffer() {
+  thread_local std::shared_ptr<_ThreadBuffer> buffer = [] {
+    auto new_buffer = std::make_shared<_ThreadBuffer>();
+    new_buffer->written_cnt.store(0, std::memory_order_relaxed);
+    std::lock_guard lock(_BuffersMutex());
+    new_buffer->thread_index = static_cast<uint32_t>(_Buffers().size());
+    _Buffers().push_back(new_buffer);
+    return new_buffer;
+  }();
+  return *buffer;
+}
+
+template <size_t Capacity>
+std::vector<std::shared_ptr<
+    typename RingBufferTracePolicy<Capacity>::_ThreadBuffer>>&
+RingBufferTracePolicy<Capacity>::_Buffers() {
+  static std::vector<std::shared_ptr<_ThreadBuffer>> buffers;
+  return buffers;
+}
+
+template <size_t Capacity>
+std::mutex& RingBufferTracePolicy<Capacity>::_BuffersMutex() {
+  static std::mutex buffers_mutex;
+  return buffers_mutex;
+}
+
+#endif //B_TREE_LIST_LIB__TRACE_POLICY_HPP_
@@ -0,0 +1,329 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_LIB__TRACE_RECORDER_HPP_
+#define B_TREE_LIST_LIB__TRACE_RECORDER_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Operation kinds in trace.
+enum class TraceOperation : uint8_t {
+  GET = 0,
+  SET = 1,
+  INSERT = 2,
+  EXTRACT = 3,
+};
+
+struct TraceRecord {
+  TraceOperation operation;
+  uint64_t index;
+  uint64_t count;  // Number of consecutive positions starting with index.
+};
+
+// Trace file starts with this header. Records follow as operation byte
+// (count flag in high bit), zigzag varint of index delta from the previous
+// record and, if flag is set, varint of count.
+struct TraceHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t element_size;
+  uint64_t t;
+};
+
+constexpr char trace_magic[8] = {'B', 'T', 'L', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t trace_version = 1;
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace recorder                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+// Records may come from several threads at once (const element access under
+// shared lock). Write errors do not interrupt list operations, recording stops
+// and error is reported by Flush.
+class TraceRecorder {
+ public:
+  // Throws std::runtime_error if trace file can not be created.
+  TraceRecorder(const std::string &path, uint32_t element_size, uint64_t t);
+
+  TraceRecorder(const TraceRecorder&) = delete;
+
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  // Flushes buffered records, write errors are lost here.
+  ~TraceRecorder();
+
+  void Record(TraceOperation operation, uint64_t index, uint64_t count = 1);
+
+  // True while operation of TraceScope is running in the calling thread,
+  // nested operations should not be recorded then.
+  [[nodiscard]] bool InsideOperation() const;
+
+  // Write buffered records to file. Throws std::runtime_error if some write
+  // to trace file failed.
+  void Flush();
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  void _PutVarint(uint64_t value);
+
+  void _WriteBuffer();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::ofstream _out;
+  std::string _path;
+  std::mutex _mutex;  // Guards buffer, stream and previous index.
+  std::vector<char> _buffer;
+  uint64_t _prev_index;
+  bool _failed_flag;
+
+  // Recorder of operation running in this thread, null outside operations.
+  inline static thread_local const TraceRecorder* _operation_recorder =
+      nullptr;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Static fields                                                            //
+  //////////////////////////////////////////////////////////////////////////////
+
+  constexpr static size_t buffer_flush_size = 1 << 16;
+  constexpr static uint8_t count_flag = 0x80;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Friend classes                                                           //
+  //////////////////////////////////////////////////////////////////////////////
+
+  friend class TraceScope;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace scope                                                                //
+////////////////////////////////////////////////////////////////////////////////
+
+// Records one operation when scope ends. Operations started inside another
+// recorded operation (for example Insert called by PushBack) are not
+// recorded. Recorder may be null.
+class TraceScope {
+ public:
+  TraceScope(TraceRecorder* recorder, TraceOperation operation,
+             uint64_t index, uint64_t count = 1);
+
+  TraceScope(const TraceScope&) = delete;
+
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  void SetCount(uint64_t count);
+
+  ~TraceScope();
+
+ private:
+  TraceRecorder* _recorder;  // Null if operation is not recorded.
+  const TraceRecorder* _outer_recorder;  // Operation recorder of the thread.
+  TraceOperation _operation;
+  uint64_t _index;
+  uint64_t _count;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace reader                                                               //
+////////////////////////////////////////////////////////////////////////////////
+
+class TraceReader {
+ public:
+  explicit TraceReader(const std::string &path);
+
+  [[nodiscard]] const TraceHeader& Header() const;
+
+  // Returns false at the end of trace.
+  bool Next(TraceRecord &record);
+
+ private:
+  //////////////////////////////////////////////////////////////////////////////
+  // Private methods                                                          //
+  //////////////////////////////////////////////////////////////////////////////
+
+  bool _GetVarint(uint64_t &value);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Fields                                                                   //
+  //////////////////////////////////////////////////////////////////////////////
+
+  std::ifstream _in;
+  TraceHeader _header;
+  uint64_t _prev_index;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation                                                             //
+////////////////////////////////////////////////////////////////////////////////
+
+inline TraceRecorder::TraceRecorder(const std::string &path,
+                                    uint32_t element_size,
+                                    uint64_t t)
+    : _out(path, std::ios::binary | std::ios::trunc),
+      _path(path),
+      _prev_index(0),
+      _failed_flag(false) {
+  TraceHeader header{};
+  std::memcpy(header.magic, trace_magic, sizeof(trace_magic));
+  header.version = trace_version;
+  header.element_size = element_size;
+  header.t = t;
+  _out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!_out) {
+    throw std::runtime_error("can not write trace: " + path);
+  }
+}
+
+inline TraceRecorder::~TraceRecorder() {
+  std::lock_guard lock(_mutex);
+  _WriteBuffer();
+}
+
+inline void TraceRecorder::Record(TraceOperation operation,
+                                  uint64_t index,
+                                  uint64_t count) {
+  std::lock_guard lock(_mutex);
+  if (_failed_flag) {
+    return;
+  }
+  _buffer.push_back(static_cast<char>(
+      static_cast<uint8_t>(operation) | (count != 1 ? count_flag : 0)));
+  auto delta = static_cast<int64_t>(index - _prev_index);
+  _PutVarint((static_cast<uint64_t>(delta) << 1) ^
+             static_cast<uint64_t>(delta >> 63));
+  if (count != 1) {
+    _PutVarint(count);
+  }
+  _prev_index = index;
+  if (_buffer.size() >= buffer_flush_size) {
+    _WriteBuffer();
+  }
+}
+
+inline bool TraceRecorder::InsideOperation() const {
+  return _operation_recorder == this;
+}
+
+inline void TraceRecorder::Flush() {
+  std::lock_guard lock(_mutex);
+  _WriteBuffer();
+  if (_failed_flag) {
+    throw std::runtime_error("can not write trace: " + _path);
+  }
+}
+
+inline void TraceRecorder::_PutVarint(uint64_t value) {
+  while (value >= 0x80) {
+    _buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  _buffer.push_back(static_cast<char>(value));
+}
+
+/*
+ * Called with locked mutex. After the first failed write the rest of trace is
+ * dropped, because records are delta-encoded and can not skip a gap.
+ */
+
+inline void TraceRecorder::_WriteBuffer() {
+  if (!_failed_flag) {
+    _out.write(_buffer.data(), static_cast<std::streamsize>(_buffer.size()));
+    _out.flush();
+    _failed_flag = !_out;
+  }
+  _buffer.clear();
+}
+
+inline TraceScope::TraceScope(TraceRecorder* recorder,
+                              TraceOperation operation,
+                              uint64_t index,
+                              uint64_t count)
+    : _recorder(nullptr),
+      _outer_recorder(TraceRecorder::_operation_recorder),
+      _operation(operation),
+      _index(index),
+      _count(count) {
+  if (recorder != nullptr && !recorder->InsideOperation()) {
+    _recorder = recorder;
+    TraceRecorder::_operation_recorder = recorder;
+  }
+}
+
+inline void TraceScope::SetCount(uint64_t count) {
+  _count = count;
+}
+
+inline TraceScope::~TraceScope() {
+  if (_recorder != nullptr) {
+    TraceRecorder::_operation_recorder = _outer_recorder;
+    if (_count != 0) {
+      _recorder->Record(_operation, _index, _count);
+    }
+  }
+}
+
+inline TraceReader::TraceReader(const std::string &path)
+    : _in(path, std::ios::binary),
+      _header{},
+      _prev_index(0) {
+  _in.read(reinterpret_cast<char*>(&_header), sizeof(_header));
+  if (!_in || std::memcmp(_header.magic, trace_magic,
+                          sizeof(trace_magic)) != 0 ||
+      _header.version != trace_version) {
+    throw std::runtime_error("not a b-tree-list trace: " + path);
+  }
+}
+
+inline const TraceHeader& TraceReader::Header() const {
+  return _header;
+}
+
+inline bool TraceReader::Next(TraceRecord &record) {
+  int operation_byte = _in.get();
+  if (operation_byte == std::char_traits<char>::eof()) {
+    return false;
+  }
+  uint64_t zigzag_delta;
+  if (!_GetVarint(zigzag_delta)) {
+    return false;
+  }
+  auto delta = static_cast<int64_t>(zigzag_delta >> 1) ^
+               -static_cast<int64_t>(zigzag_delta & 1);
+  record.operation = static_cast<TraceOperation>(operation_byte & 0x7f);
+  record.index = _prev_index + static_cast<uint64_t>(delta);
+  record.count = 1;
+  if ((operation_byte & 0x80) != 0 && !_GetVarint(record.count)) {
+    return false;
+  }
+  _prev_index = record.index;
+  return true;
+}
+
+inline bool TraceReader::_GetVarint(uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int byte = _in.get();
+    if (byte == std::char_traits<char>::eof()) {
+      return false;
+    }
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif //B_TREE_LIST_LIB__TRACE_RECORDER_HPP_
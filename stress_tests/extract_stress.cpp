@@ -19,11 +19,10 @@ auto TestExtracts(size_t extracts_cnt, const std::string& file_name) {
   std::filesystem::copy(file_name, in_test_filename);
   auto* test_list = new BTreeList<int, 200>(in_test_filename, false);
 
+  boost::minstd_rand generator(42);
   auto start = std::chrono::high_resolution_clock::now();
   for(unsigned i = 0; i < extracts_cnt; ++i) {
-    auto pos =
-        boost::minstd_rand(static_cast<unsigned>(std::time(nullptr)))() %
-        test_list->Size();
+    auto pos = generator() % test_list->Size();
     test_list->Extract(pos);
   }
   auto finish = std::chrono::high_resolution_clock::now();
@@ -0,0 +1,78 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <boost/random.hpp>
+#include "../lib/b_tree_list.hpp"
+
+#ifndef HUGE_SIZE_STRESS_CPP
+#define HUGE_SIZE_STRESS_CPP
+
+// Element value which depends on position, so shifted elements are seen.
+uint8_t ValueForPos(size_t pos) {
+  return static_cast<uint8_t>(pos ^ (pos >> 32) ^ (pos >> 8));
+}
+
+/*
+ * Works with positions around 2^32 in list of more than 2^32 elements.
+ * Returns number of wrong answers.
+ */
+
+size_t TestHugeSize(size_t operations_cnt, const std::string& file_name) {
+  auto* test_list = new BTreeList<uint8_t, 200>(file_name, false);
+  const size_t size = test_list->Size();
+  const size_t window_beg = (size_t{1} << 32) - operations_cnt;
+  size_t wrong_cnt = 0;
+
+  for (size_t pos = window_beg; pos < size; ++pos) {
+    (*test_list)[pos] = ValueForPos(pos);
+  }
+  for (size_t pos = window_beg; pos < size; ++pos) {
+    wrong_cnt += ((*test_list)[pos] != ValueForPos(pos));
+  }
+
+  boost::minstd_rand generator(42);
+  for (size_t i = 0; i < operations_cnt; ++i) {
+    size_t pos = window_beg + generator() % (size - window_beg - 1);
+    test_list->Insert(pos, 0);
+    wrong_cnt += ((*test_list)[pos] != 0);
+    wrong_cnt += ((*test_list)[pos + 1] != ValueForPos(pos));
+    wrong_cnt += (test_list->Extract(pos) != 0);
+    wrong_cnt += ((*test_list)[pos] != ValueForPos(pos));
+  }
+  wrong_cnt += (test_list->Size() != size);
+
+  delete test_list;
+  return wrong_cnt;
+}
+
+void RunHugeSizeTestPack(size_t operations_cnt) {
+  std::ofstream file;
+  file.open("huge_size_test.txt", std::ios_base::trunc);
+
+  std::string filename = "huge_size_test_data";
+  const size_t size_of_btree = (size_t{1} << 32) + operations_cnt;
+  auto* test_list = new BTreeList<uint8_t, 200>(filename, size_of_btree, 0,
+                                                false);
+  delete test_list;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  size_t wrong_cnt = TestHugeSize(operations_cnt, filename);
+  auto finish = std::chrono::high_resolution_clock::now();
+
+  file << "wrong: " << wrong_cnt << std::endl;
+  file << std::chrono::duration_cast<std::chrono::microseconds>(
+      finish - start).count() / operations_cnt << std::endl;
+
+  std::filesystem::remove(filename);
+  file.close();
+}
+
+#endif
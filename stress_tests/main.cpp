@@ -2,19 +2,41 @@
 // Created by gogagum on 10.08.2020.
 //
 
+#include <cstring>
+#include <iostream>
 #include "insert_stress.cpp"
 #include "extract_stress.cpp"
 #include "set_stress.cpp"
+#include "huge_size_stress.cpp"
 
-void RunAllTests() {
+void RunAllTests(bool huge_size_flag) {
   size_t max_size = 100000000;
   size_t operations_cnt = 100000;
   RunInsertsTestPack(max_size, operations_cnt);
   RunExtractsTestPack(max_size, operations_cnt);
   RunSetsTestPack(max_size, operations_cnt);
+  if (huge_size_flag) {
+    RunHugeSizeTestPack(operations_cnt);
+  }
 }
 
-int main() {
-  RunAllTests();
+/*
+ * --huge_size also runs the pack with more than 2^32 elements. List file
+ * takes about 41 bytes per one-byte element, so it needs about 180 GB of
+ * free disk in working directory and takes hours. It is off by default.
+ */
+
+int main(int argc, char** argv) {
+  bool huge_size_flag = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--huge_size") == 0) {
+      huge_size_flag = true;
+    } else {
+      std::cerr << "unknown argument: " << argv[i] << "\n"
+                << "usage: " << argv[0] << " [--huge_size]\n";
+      return 1;
+    }
+  }
+  RunAllTests(huge_size_flag);
   return 0;
-}
\ No newline at end of file
+}
@@ -4,7 +4,10 @@
 
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
+#include <boost/random.hpp>
+#include <deque>
 #include "../lib/b_tree_list.hpp"
+#include "../lib/bytes_list.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 //  Constructor tests                                                         //
@@ -224,4 +227,1277 @@ TEST(not_simple_extracts, random_extracts) {
   EXPECT_EQ(test_list->Size(), 1);
 
   EXPECT_EQ(std::filesystem::remove(data_file_name), true);
-}
\ No newline at end of file
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Rebuild tests                                                              //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(rebuild_tests, van_emde_boas_layout) {
+  std::string data_file_name = "van_emde_boas_layout_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 2>(data_file_name);
+  for (int i = 0; i < 500; ++i) {
+    elements.push_back(i);
+    test_list->Insert(test_list->Size(), i);
+  }
+  for (unsigned i = 0; i < 100; ++i) {
+    elements.erase(elements.begin() + i * 3);
+    test_list->Extract(i * 3);
+  }
+  test_list->SetRebuildLayout(RebuildLayout::VAN_EMDE_BOAS);
+  delete test_list;
+
+  test_list = new BTreeList<int, 2>(data_file_name);
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (unsigned i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(rebuild_tests, packed_rebuild_to_path) {
+  std::string data_file_name = "packed_rebuild_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 3>(data_file_name);
+  for (int i = 0; i < 1000; ++i) {
+    elements.push_back(i);
+    test_list->Insert(test_list->Size(), i);
+  }
+  for (unsigned i = 0; i < 300; ++i) {
+    elements.erase(elements.begin() + i * 2);
+    test_list->Extract(i * 2);
+  }
+
+  for (double fill_factor: {1., 0.5, 0.}) {
+    std::string rebuilt_file_name = "packed_rebuild_test_data_rebuilt";
+    test_list->Rebuild(rebuilt_file_name, fill_factor);
+    EXPECT_EQ((*test_list)[5], elements[5]);
+    auto* rebuilt_list = new BTreeList<int, 3>(rebuilt_file_name, false);
+    EXPECT_EQ(rebuilt_list->Size(), elements.size());
+    for (unsigned i = 0; i < elements.size(); ++i) {
+      EXPECT_EQ((*rebuilt_list)[i], elements[i]);
+    }
+    rebuilt_list->Insert(0, -1);
+    EXPECT_EQ(rebuilt_list->Extract(10), elements[9]);
+    delete rebuilt_list;
+    EXPECT_EQ(std::filesystem::remove(rebuilt_file_name), true);
+  }
+  EXPECT_THROW(test_list->Rebuild(data_file_name), std::invalid_argument);
+  EXPECT_THROW(test_list->Rebuild("./" + data_file_name),
+               std::invalid_argument);
+  test_list->Insert(0, -1);
+  EXPECT_EQ(test_list->Extract(0), -1);
+  delete test_list;
+
+  // File was not replaced, so reopened list has all elements.
+  test_list = new BTreeList<int, 3>(data_file_name, false);
+  ASSERT_EQ(test_list->Size(), elements.size());
+  for (unsigned i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocator tests                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(allocator_tests, free_space_after_extracts) {
+  std::string data_file_name = "free_space_after_extracts_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 2>(data_file_name, false);
+  for (int i = 0; i < 5000; ++i) {
+    elements.push_back(i);
+    test_list->Insert(test_list->Size(), i);
+  }
+  struct stat file_stat{};
+  stat(data_file_name.c_str(), &file_stat);
+  auto full_file_blocks = file_stat.st_blocks;
+  for (unsigned i = 0; i < 4500; ++i) {
+    elements.erase(elements.begin() + 400);
+    test_list->Extract(400);
+  }
+  test_list->ReleaseFreeSpace();
+  stat(data_file_name.c_str(), &file_stat);
+  EXPECT_LT(file_stat.st_blocks, full_file_blocks / 2);
+  delete test_list;
+
+  // Free blocks are kept between openings
+  test_list = new BTreeList<int, 2>(data_file_name, false);
+  auto file_size = std::filesystem::file_size(data_file_name);
+  for (int i = 0; i < 300; ++i) {
+    elements.insert(elements.begin() + 100, -i);
+    test_list->Insert(100, -i);
+  }
+  EXPECT_EQ(std::filesystem::file_size(data_file_name), file_size);
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (unsigned i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Access advice tests                                                        //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(advice_tests, advice_and_prefetch) {
+  std::string data_file_name = "advice_and_prefetch_test_data";
+  auto* test_list = new BTreeList<int, 50>(data_file_name, false);
+  EXPECT_TRUE(test_list->Advise(AccessAdvice::RANDOM));
+  if (std::filesystem::exists("/sys/kernel/mm/transparent_hugepage")) {
+    EXPECT_TRUE(test_list->SetHugePages(true));
+  }
+  for (int i = 0; i < 100000; ++i) {
+    test_list->PushBack(i);
+  }
+  EXPECT_TRUE(test_list->Prefetch(0, test_list->Size()));
+  EXPECT_TRUE(test_list->Prefetch(1990, 300000));
+  EXPECT_TRUE(test_list->Prefetch(5, 5));
+  EXPECT_TRUE(test_list->Advise(AccessAdvice::SEQUENTIAL));
+  for (int i = 0; i < 100000; ++i) {
+    EXPECT_EQ((*test_list)[i], i);
+  }
+  test_list->Sync();
+  delete test_list;
+
+  // Drop file from page cache, then prefetch the second quarter of list.
+  // Pages are watched through a separate mapping of the file.
+  int fd = open(data_file_name.c_str(), O_RDONLY);
+  ASSERT_NE(fd, -1);
+  ASSERT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+  size_t file_size = std::filesystem::file_size(data_file_name);
+  void* file_mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  ASSERT_NE(file_mapping, MAP_FAILED);
+  auto count_resident_pages = [file_mapping, file_size]() {
+    std::vector<unsigned char> residency;
+    EXPECT_TRUE(GetPagesResidency(file_mapping, file_size, residency));
+    return static_cast<size_t>(
+        std::count_if(residency.begin(), residency.end(),
+                      [](unsigned char page) { return page & 1; }));
+  };
+  test_list = new BTreeList<int, 50>(data_file_name, OpenMode::READ_WRITE);
+  auto resident_before = count_resident_pages();
+  if (resident_before * 10 > file_size / GetFilePageSize()) {
+    munmap(file_mapping, file_size);
+    close(fd);
+    delete test_list;
+    std::filesystem::remove(data_file_name);
+    GTEST_SKIP() << "file system keeps pages in page cache";
+  }
+  EXPECT_TRUE(test_list->Prefetch(25000, 50000));
+  // Readahead is asynchronous. Every leaf holds at most 98 elements and
+  // takes one page.
+  for (int i = 0; i < 200 &&
+       count_resident_pages() < resident_before + 25000 / 98; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ResidencyMap residency_map = test_list->Residency(4);
+  ASSERT_TRUE(residency_map.pages_flag);
+  const RangeResidency &prefetched = residency_map.ranges[1];
+  const RangeResidency &not_prefetched = residency_map.ranges[3];
+  EXPECT_EQ(prefetched.resident_pages_cnt, prefetched.pages_cnt);
+  EXPECT_LT(not_prefetched.resident_pages_cnt * 2, not_prefetched.pages_cnt);
+  munmap(file_mapping, file_size);
+  close(fd);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Batch tests                                                                //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(batch_tests, get_many) {
+  std::string data_file_name = "get_many_test_data";
+  std::vector<int> elements;
+  for (int i = 0; i < 3000; ++i) {
+    elements.push_back(i * 7);
+  }
+  auto* test_list = new BTreeList<int, 4>(data_file_name,
+                                         elements.begin(),
+                                         elements.end());
+  std::vector<size_t> indexes;
+  for (size_t i = 0; i < 1000; ++i) {
+    indexes.push_back((i * 7919) % elements.size());
+  }
+  std::vector<int> results;
+  test_list->GetMany(indexes, std::back_inserter(results));
+  ASSERT_EQ(results.size(), indexes.size());
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    EXPECT_EQ(results[i], elements[indexes[i]]);
+  }
+  indexes.push_back(elements.size());
+  results.clear();
+  EXPECT_THROW(test_list->GetMany(indexes, std::back_inserter(results)),
+               std::out_of_range);
+  EXPECT_TRUE(results.empty());
+  const auto &const_list = *test_list;
+  EXPECT_EQ(const_list[elements.size() - 1], elements.back());
+  EXPECT_THROW(static_cast<void>(const_list[elements.size()]),
+               std::out_of_range);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(batch_tests, get_and_set_sorted) {
+  std::string data_file_name = "get_and_set_sorted_test_data";
+  std::vector<int> elements;
+  for (int i = 0; i < 3000; ++i) {
+    elements.push_back(i);
+  }
+  auto* test_list = new BTreeList<int, 3>(data_file_name,
+                                         elements.begin(),
+                                         elements.end());
+  std::vector<size_t> indexes = {0, 0, 1, 2, 17, 18, 400, 1999, 2000, 2999};
+  std::vector<int> values;
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    values.push_back(-static_cast<int>(i));
+    elements[indexes[i]] = values.back();
+  }
+  test_list->SetSorted(indexes, values.begin());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+
+  indexes.clear();
+  for (size_t i = 0; i < elements.size(); i += 3) {
+    indexes.push_back(i);
+  }
+  std::vector<int> results;
+  test_list->GetSorted(indexes, std::back_inserter(results));
+  ASSERT_EQ(results.size(), indexes.size());
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    EXPECT_EQ(results[i], elements[indexes[i]]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(batch_tests, apply_batch) {
+  using Operation = BTreeList<int, 3>::BatchOperation;
+  std::string data_file_name = "apply_batch_test_data";
+  std::vector<int> elements;
+  for (int i = 0; i < 500; ++i) {
+    elements.push_back(i);
+  }
+  auto* test_list = new BTreeList<int, 3>(data_file_name,
+                                         elements.begin(),
+                                         elements.end());
+  boost::minstd_rand generator(37);
+  for (unsigned batch = 0; batch < 20; ++batch) {
+    std::vector<Operation> operations;
+    for (int i = 0; i < 100; ++i) {
+      int value = 1000 * (batch + 1) + i;
+      switch (generator() % 3) {
+        case 0: {
+          size_t index = generator() % (elements.size() + 1);
+          operations.push_back(Operation{Operation::INSERT, index, value});
+          elements.insert(elements.begin() + index, value);
+          break;
+        }
+        case 1: {
+          size_t index = generator() % elements.size();
+          operations.push_back(Operation{Operation::EXTRACT, index, 0});
+          elements.erase(elements.begin() + index);
+          break;
+        }
+        default: {
+          size_t index = generator() % elements.size();
+          operations.push_back(Operation{Operation::SET, index, value});
+          elements[index] = value;
+        }
+      }
+    }
+    test_list->ApplyBatch(operations);
+    ASSERT_EQ(test_list->Size(), elements.size());
+    for (size_t i = 0; i < elements.size(); ++i) {
+      ASSERT_EQ((*test_list)[i], elements[i]);
+    }
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Pinned levels tests                                                        //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(pinned_levels_tests, changes_with_pinned_levels) {
+  std::string data_file_name = "changes_with_pinned_levels_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  EXPECT_TRUE(test_list->PinUpperLevels(2, true));
+  for (int i = 0; i < 2000; ++i) {
+    size_t index = (i * 37) % (elements.size() + 1);
+    elements.insert(elements.begin() + index, i);
+    test_list->Insert(index, i);
+  }
+  for (int i = 0; i < 1500; ++i) {
+    size_t index = (i * 53) % elements.size();
+    elements.erase(elements.begin() + index);
+    test_list->Extract(index);
+  }
+  (*test_list)[7] = -7;
+  elements[7] = -7;
+  test_list->Sync();
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  test_list = new BTreeList<int, 3>(data_file_name, false);
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(finger_search_tests, local_access_with_changes) {
+  std::string data_file_name = "local_access_with_changes_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  test_list->SetFingerSearch(true);
+  for (int i = 0; i < 3000; ++i) {
+    elements.push_back(i);
+  }
+  test_list->Insert(0, elements.begin(), elements.end());
+  size_t pos = 1000;
+  for (int i = 0; i < 5000; ++i) {
+    pos = (pos + elements.size() + (i * 7) % 11 - 5) % elements.size();
+    EXPECT_EQ((*test_list)[pos], elements[pos]);
+    if (i % 100 == 0) {
+      test_list->Insert(pos, -i);
+      elements.insert(elements.begin() + pos, -i);
+    } else if (i % 100 == 50) {
+      EXPECT_EQ(test_list->Extract(pos), elements[pos]);
+      elements.erase(elements.begin() + pos);
+    } else if (i % 10 == 0) {
+      (*test_list)[pos] = i;
+      elements[pos] = i;
+    }
+  }
+  for (size_t i = elements.size(); i > 0; --i) {
+    EXPECT_EQ((*test_list)[i - 1], elements[i - 1]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(finger_search_tests, local_inserts_and_extracts) {
+  std::string data_file_name = "local_inserts_and_extracts_test_data";
+  std::vector<int> elements;
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  test_list->SetFingerSearch(true);
+  size_t pos = 0;
+  for (int i = 0; i < 6000; ++i) {
+    pos = (pos + elements.size() + 1 + (i * 7) % 5 - 2) %
+          (elements.size() + 1);
+    if (i % 3 != 2 || elements.empty()) {
+      test_list->Insert(pos, i);
+      elements.insert(elements.begin() + pos, i);
+    } else {
+      pos = std::min(pos, elements.size() - 1);
+      EXPECT_EQ(test_list->Extract(pos), elements[pos]);
+      elements.erase(elements.begin() + pos);
+    }
+    if (i % 500 == 0) {
+      test_list->Insert(elements.size(), -i);
+      elements.push_back(-i);
+    }
+  }
+  ASSERT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(deque_operations_tests, push_and_pop_on_both_ends) {
+  std::string data_file_name = "push_and_pop_on_both_ends_test_data";
+  std::deque<int> elements;
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  for (int i = 0; i < 3000; ++i) {
+    if (i % 3 == 0) {
+      test_list->PushFront(i);
+      elements.push_front(i);
+    } else {
+      test_list->PushBack(i);
+      elements.push_back(i);
+    }
+    if (i % 7 == 3) {
+      EXPECT_EQ(test_list->PopBack(), elements.back());
+      elements.pop_back();
+    }
+    if (i % 11 == 5) {
+      EXPECT_EQ(test_list->PopFront(), elements.front());
+      elements.pop_front();
+    }
+    if (i % 101 == 0) {
+      test_list->Insert(elements.size() / 2, -i);
+      elements.insert(elements.begin() + elements.size() / 2, -i);
+    }
+  }
+  delete test_list;
+
+  test_list = new BTreeList<int, 3>(data_file_name, false);
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  while (!elements.empty()) {
+    EXPECT_EQ(test_list->PopFront(), elements.front());
+    elements.pop_front();
+  }
+  EXPECT_EQ(test_list->Size(), 0);
+  EXPECT_THROW(test_list->PopBack(), std::out_of_range);
+  EXPECT_THROW(test_list->PopFront(), std::out_of_range);
+  EXPECT_EQ(test_list->Size(), 0);
+  test_list->PushBack(1);
+  EXPECT_EQ((*test_list)[0], 1);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(bytes_list_tests, short_and_long_strings) {
+  std::string data_file_name = "short_and_long_strings_test_data";
+  std::vector<std::string> elements;
+  auto* test_list = new BytesList<16, 3>(data_file_name);
+  for (int i = 0; i < 500; ++i) {
+    std::string bytes(static_cast<size_t>((i * 97) % 10000), 'a' + i % 26);
+    bytes += std::to_string(i);
+    size_t index = (i * 37) % (elements.size() + 1);
+    elements.insert(elements.begin() + index, bytes);
+    test_list->Insert(index, bytes);
+  }
+  for (int i = 0; i < 200; ++i) {
+    size_t index = (i * 53) % elements.size();
+    EXPECT_EQ(test_list->Extract(index), elements[index]);
+    elements.erase(elements.begin() + index);
+  }
+  test_list->Set(3, std::string(20000, 'z'));
+  elements[3] = std::string(20000, 'z');
+  test_list->Set(4, "short");
+  elements[4] = "short";
+  test_list->PushBack(std::string("with\0zero", 9));
+  elements.emplace_back("with\0zero", 9);
+  delete test_list;
+
+  test_list = new BytesList<16, 3>(data_file_name);
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ(test_list->Get(i), elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(bytes_list_tests, medium_strings_share_heap_blocks) {
+  std::string data_file_name = "medium_strings_share_heap_blocks_test_data";
+  std::vector<std::string> elements;
+  auto* test_list = new BytesList<16, 20>(data_file_name);
+  for (int i = 0; i < 3000; ++i) {
+    std::string bytes(static_cast<size_t>(100 + (i * 31) % 200), 'a' + i % 26);
+    size_t index = (i * 37) % (elements.size() + 1);
+    elements.insert(elements.begin() + index, bytes);
+    test_list->Insert(index, bytes);
+  }
+  for (int i = 0; i < 1500; ++i) {
+    size_t index = (i * 53) % elements.size();
+    EXPECT_EQ(test_list->Extract(index), elements[index]);
+    elements.erase(elements.begin() + index);
+  }
+  for (int i = 0; i < 500; ++i) {
+    std::string bytes(static_cast<size_t>(20 + (i * 13) % 400), 'A' + i % 26);
+    test_list->Set(i, bytes);
+    elements[i] = bytes;
+  }
+  delete test_list;
+  // A whole block for every overflow would take more than 6 MB.
+  EXPECT_LT(std::filesystem::file_size(data_file_name), 3000000u);
+
+  test_list = new BytesList<16, 20>(data_file_name);
+  for (int i = 0; i < 500; ++i) {
+    test_list->PushBack(std::string(150, 'p'));
+    elements.emplace_back(150, 'p');
+  }
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ(test_list->Get(i), elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(storage_backend_tests, anonymous_memory) {
+  std::string name = "anonymous_memory_test_data";
+  std::vector<int> elements;
+  auto* test_list =
+      new BTreeList<int, 3>(name, StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 3000; ++i) {
+    size_t index = (i * 37) % (elements.size() + 1);
+    elements.insert(elements.begin() + index, i);
+    test_list->Insert(index, i);
+  }
+  for (int i = 0; i < 1000; ++i) {
+    size_t index = (i * 53) % elements.size();
+    EXPECT_EQ(test_list->Extract(index), elements[index]);
+    elements.erase(elements.begin() + index);
+  }
+  test_list->ReleaseFreeSpace();
+  EXPECT_EQ(test_list->Size(), elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    EXPECT_EQ((*test_list)[i], elements[i]);
+  }
+  EXPECT_FALSE(std::filesystem::exists(name));
+  delete test_list;
+  EXPECT_FALSE(std::filesystem::exists(name));
+}
+
+TEST(trace_tests, record_and_read_trace) {
+  std::string data_file_name = "record_and_read_trace_test_data";
+  std::string trace_file_name = "record_and_read_trace_test_trace";
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  std::vector<int> elements{1, 2, 3, 4, 5};
+  test_list->Insert(0, elements.begin(), elements.end());
+  test_list->StartRecording(trace_file_name);
+  test_list->Insert(2, 10);
+  test_list->PushBack(11);
+  EXPECT_EQ((*test_list)[6], 11);
+  EXPECT_EQ(test_list->Extract(0), 1);
+  std::vector<size_t> indexes{1, 2, 3, 0};
+  std::vector<int> values(indexes.size());
+  test_list->GetMany(indexes, values.begin());
+  test_list->PopFront();
+  test_list->Set(1, 12);
+  test_list->StopRecording();
+  (*test_list)[0] = 0;
+  delete test_list;
+
+  std::vector<TraceRecord> expected{
+      {TraceOperation::INSERT, 2, 1},
+      {TraceOperation::INSERT, 6, 1},
+      {TraceOperation::GET, 6, 1},
+      {TraceOperation::EXTRACT, 0, 1},
+      {TraceOperation::GET, 1, 3},
+      {TraceOperation::GET, 0, 1},
+      {TraceOperation::EXTRACT, 0, 1},
+      {TraceOperation::SET, 1, 1},
+  };
+  TraceReader reader(trace_file_name);
+  EXPECT_EQ(reader.Header().element_size, sizeof(int));
+  EXPECT_EQ(reader.Header().t, 3);
+  TraceRecord record{};
+  for (const auto &expected_record: expected) {
+    ASSERT_TRUE(reader.Next(record));
+    EXPECT_EQ(record.operation, expected_record.operation);
+    EXPECT_EQ(record.index, expected_record.index);
+    EXPECT_EQ(record.count, expected_record.count);
+  }
+  EXPECT_FALSE(reader.Next(record));
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+  EXPECT_EQ(std::filesystem::remove(trace_file_name), true);
+}
+
+TEST(trace_tests, concurrent_reads_and_write_errors) {
+  std::string data_file_name = "concurrent_trace_test_data";
+  std::string trace_file_name = "concurrent_trace_test_trace";
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  for (int i = 0; i < 1000; ++i) {
+    test_list->PushBack(i);
+  }
+  test_list->StartRecording(trace_file_name);
+  const auto &const_list = *test_list;
+  std::vector<std::thread> threads;
+  for (int thread_index = 0; thread_index < 4; ++thread_index) {
+    threads.emplace_back([&const_list]() {
+      for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_EQ(const_list[i], static_cast<int>(i));
+      }
+    });
+  }
+  for (std::thread &thread: threads) {
+    thread.join();
+  }
+  test_list->StopRecording();
+
+  TraceReader reader(trace_file_name);
+  TraceRecord record{};
+  size_t records_cnt = 0;
+  while (reader.Next(record)) {
+    EXPECT_EQ(record.operation, TraceOperation::GET);
+    ++records_cnt;
+  }
+  EXPECT_EQ(records_cnt, 4000);
+
+  EXPECT_THROW(test_list->StartRecording("no_such_directory/trace"),
+               std::runtime_error);
+  test_list->StartRecording("/dev/full");
+  test_list->Set(0, 1);
+  EXPECT_THROW(test_list->StopRecording(), std::runtime_error);
+  test_list->Set(0, 0);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+  EXPECT_EQ(std::filesystem::remove(trace_file_name), true);
+}
+
+TEST(stats_tests, counters_and_latencies) {
+  std::string name = "stats_test_data";
+  auto* test_list =
+      new BTreeList<int, 3>(name, StorageBackend::ANONYMOUS_MEMORY);
+  test_list->EnableLatencyHistograms(true);
+  for (int i = 0; i < 1000; ++i) {
+    test_list->PushBack(i);
+  }
+  ListStats stats = test_list->Stats();
+  EXPECT_GT(stats.structure.splits, 0u);
+  EXPECT_EQ(stats.structure.merges, 0);
+  EXPECT_GT(stats.storage.nodes_written, 0u);
+  EXPECT_GT(stats.allocation.allocations, 0u);
+  EXPECT_GT(stats.allocation.remaps, 0u);
+  EXPECT_EQ(stats.latencies[static_cast<size_t>(ListOperation::INSERT)]
+                .Count(), 1000);
+  EXPECT_EQ(stats.latencies[static_cast<size_t>(ListOperation::ACCESS)]
+                .Count(), 0);
+
+  test_list->ResetStats();
+  for (int i = 0; i < 900; ++i) {
+    test_list->Extract(0);
+  }
+  EXPECT_EQ((*test_list)[0], 900);
+  stats = test_list->Stats();
+  EXPECT_EQ(stats.structure.splits, 0);
+  EXPECT_GT(stats.structure.merges, 0u);
+  EXPECT_GT(stats.structure.borrows, 0u);
+  EXPECT_GT(stats.allocation.deletions, 0u);
+  EXPECT_EQ(stats.allocation.free_block_hits, 0);
+  const LatencyHistogram &extracts =
+      stats.latencies[static_cast<size_t>(ListOperation::EXTRACT)];
+  EXPECT_EQ(extracts.Count(), 900);
+  EXPECT_LE(extracts.Percentile(0.5), extracts.Percentile(0.99));
+  EXPECT_LE(extracts.Percentile(0.99), extracts.Max());
+  EXPECT_EQ(stats.latencies[static_cast<size_t>(ListOperation::ACCESS)]
+                .Count(), 1);
+  delete test_list;
+}
+
+TEST(stats_tests, memory_budget) {
+  std::string data_file_name = "memory_budget_test_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  size_t block_size = GetFilePageSize();
+  test_list->SetMemoryBudget(16 * block_size, 4 * block_size);
+  for (int i = 0; i < 5000; ++i) {
+    test_list->PushBack(i);
+  }
+  for (int i = 0; i < 5000; i += 7) {
+    (*test_list)[i] = -i;
+  }
+  for (int i = 0; i < 5000; ++i) {
+    ASSERT_EQ((*test_list)[i], i % 7 == 0 ? -i : i);
+  }
+  EXPECT_GT(test_list->Stats().storage.evicted_windows, 0u);
+  // Dropped windows leave page cache too, not only mapping.
+  int fd = open(data_file_name.c_str(), O_RDONLY);
+  ASSERT_NE(fd, -1);
+  size_t file_size = std::filesystem::file_size(data_file_name);
+  void* file_mapping = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  ASSERT_NE(file_mapping, MAP_FAILED);
+  std::vector<unsigned char> residency;
+  ASSERT_TRUE(GetPagesResidency(file_mapping, file_size, residency));
+  size_t resident_pages_cnt = std::count_if(
+      residency.begin(), residency.end(),
+      [](unsigned char page) { return page & 1; });
+  EXPECT_LT(resident_pages_cnt * 4, residency.size());
+  munmap(file_mapping, file_size);
+  close(fd);
+  test_list->SetMemoryBudget(0);
+  test_list->ResetStats();
+  EXPECT_EQ((*test_list)[7], -7);
+  EXPECT_EQ(test_list->Stats().storage.evicted_windows, 0);
+  delete test_list;
+
+  // Dropped pages were written to file.
+  test_list = new BTreeList<int, 3>(data_file_name, false);
+  for (int i = 0; i < 5000; ++i) {
+    ASSERT_EQ((*test_list)[i], i % 7 == 0 ? -i : i);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(stats_tests, concurrent_reads_counted) {
+  std::string name = "concurrent_reads_counted_test_data";
+  auto* test_list =
+      new BTreeList<int, 3>(name, StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 3000; ++i) {
+    test_list->PushBack(i);
+  }
+  test_list->ResetStats();
+  static_cast<void>(test_list->AnalyzeStructure());
+  uint64_t nodes_read = test_list->Stats().storage.nodes_read;
+  EXPECT_GT(nodes_read, 0u);
+
+  test_list->ResetStats();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([test_list]() {
+      for (int j = 0; j < 10; ++j) {
+        static_cast<void>(test_list->AnalyzeStructure());
+      }
+    });
+  }
+  for (std::thread &thread: threads) {
+    thread.join();
+  }
+  EXPECT_EQ(test_list->Stats().storage.nodes_read, 40 * nodes_read);
+  delete test_list;
+}
+
+TEST(stats_tests, concurrent_const_reads_measured) {
+  std::string name = "concurrent_const_reads_test_data";
+  auto* test_list =
+      new BTreeList<int, 3>(name, StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 3000; ++i) {
+    test_list->PushBack(i);
+  }
+  test_list->EnableLatencyHistograms(true);
+  const auto &const_list = *test_list;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&const_list]() {
+      std::vector<size_t> indexes{1, 500, 2999};
+      std::vector<int> values(indexes.size());
+      for (size_t j = 0; j < 1000; ++j) {
+        EXPECT_EQ(const_list[j * 3], static_cast<int>(j * 3));
+        const_list.GetSorted(indexes, values.begin());
+        EXPECT_THAT(values, ::testing::ElementsAre(1, 500, 2999));
+      }
+    });
+  }
+  for (std::thread &thread: threads) {
+    thread.join();
+  }
+  ListStats stats = test_list->Stats();
+  EXPECT_EQ(
+      stats.latencies[static_cast<size_t>(ListOperation::ACCESS)].Count(),
+      4000);
+  EXPECT_EQ(
+      stats.latencies[static_cast<size_t>(ListOperation::BATCH)].Count(),
+      4000);
+  delete test_list;
+}
+
+TEST(stats_tests, in_place_writes_counted) {
+  auto* leaf_list = new BTreeList<int, 64>("in_place_writes_leaf_test_data",
+                                           StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 100; ++i) {
+    leaf_list->PushBack(i);
+  }
+  leaf_list->ResetStats();
+  leaf_list->PushBack(100);
+  leaf_list->PushFront(-1);
+  leaf_list->Set(1, 0);
+  EXPECT_EQ(leaf_list->PopBack(), 100);
+  EXPECT_EQ(leaf_list->PopFront(), -1);
+  std::vector<size_t> sorted_indexes{2, 3, 50};
+  std::vector<int> values{-2, -3, -50};
+  leaf_list->SetSorted(sorted_indexes, values.begin());
+  StorageCounters counters = leaf_list->Stats().storage;
+  EXPECT_EQ(counters.nodes_written, 6);
+  EXPECT_GT(counters.bytes_written, 0u);
+  delete leaf_list;
+
+  using SumList = BTreeList<int64_t, 3, NoTracePolicy,
+                            SumAggregatePolicy<int64_t>>;
+  auto* sum_list = new SumList("in_place_writes_sum_test_data",
+                               StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 1000; ++i) {
+    sum_list->PushBack(i);
+  }
+  size_t depth = sum_list->AnalyzeStructure().levels.size();
+  ASSERT_GT(depth, 2u);
+  sum_list->ResetStats();
+  sum_list->Set(0, 5);
+  // The first element is in leaf, aggregates of all its ancestors change.
+  EXPECT_EQ(sum_list->Stats().storage.nodes_written, depth);
+  sum_list->ResetStats();
+  std::vector<size_t> sum_indexes{0, 1};
+  std::vector<int64_t> sum_values{7, 8};
+  sum_list->SetSorted(sum_indexes, sum_values.begin());
+  // Both elements are in the first leaf.
+  EXPECT_EQ(sum_list->Stats().storage.nodes_written, depth);
+  EXPECT_EQ(sum_list->RangeAggregate(0, 2), 15);
+  delete sum_list;
+}
+
+TEST(stats_tests, histogram_precision) {
+  LatencyHistogram histogram;
+  for (uint64_t value = 1; value <= 100000; ++value) {
+    histogram.Record(value);
+  }
+  EXPECT_EQ(histogram.Count(), 100000);
+  EXPECT_EQ(histogram.Max(), 100000);
+  for (double p: {0.1, 0.5, 0.9, 0.99, 0.999}) {
+    auto exact = static_cast<double>(p * 100000);
+    auto reported = static_cast<double>(histogram.Percentile(p));
+    EXPECT_GE(reported, exact);
+    EXPECT_LE(reported, exact * (1. + 1. / 16));
+  }
+  histogram.Reset();
+  EXPECT_EQ(histogram.Count(), 0);
+  EXPECT_EQ(histogram.Percentile(0.5), 0);
+}
+
+TEST(trace_policy_tests, ring_buffer_policy) {
+  using Policy = RingBufferTracePolicy<1 << 14>;
+  std::string name = "trace_policy_test_data";
+  std::string chrome_trace_name = "trace_policy_test_trace.json";
+  auto* test_list = new BTreeList<int, 3, Policy>(
+      name, StorageBackend::ANONYMOUS_MEMORY);
+  for (int i = 0; i < 200; ++i) {
+    test_list->PushBack(i);
+  }
+  for (int i = 0; i < 150; ++i) {
+    EXPECT_EQ(test_list->Extract(0), i);
+  }
+  ListStats stats = test_list->Stats();
+  delete test_list;
+
+  std::vector<TracePoint> points = Policy::Collect();
+  std::array<uint64_t, 6> kind_cnts{};
+  for (size_t i = 0; i < points.size(); ++i) {
+    ++kind_cnts[static_cast<size_t>(points[i].kind)];
+    if (i != 0) {
+      EXPECT_LE(points[i - 1].time_ns, points[i].time_ns);
+    }
+  }
+  ASSERT_LT(points.size(), 1u << 14);
+  EXPECT_EQ(kind_cnts[static_cast<size_t>(TracePointKind::MERGE)],
+            stats.structure.merges);
+  EXPECT_GT(kind_cnts[static_cast<size_t>(TracePointKind::NODE_WRITE)], 0u);
+
+  Policy::WriteChromeTrace(chrome_trace_name);
+  std::ifstream chrome_trace(chrome_trace_name);
+  std::string json((std::istreambuf_iterator<char>(chrome_trace)),
+                   std::istreambuf_iterator<char>());
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_NE(json.find("\"name\":\"merge\""), std::string::npos);
+  Policy::Clear();
+  EXPECT_TRUE(Policy::Collect().empty());
+  EXPECT_EQ(std::filesystem::remove(chrome_trace_name), true);
+}
+
+TEST(residency_tests, levels_and_ranges) {
+  std::string data_file_name = "residency_test_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  for (int i = 0; i < 5000; ++i) {
+    test_list->PushBack(i);
+  }
+  test_list->Sync();
+  ResidencyMap residency_map = test_list->Residency(8);
+  ASSERT_TRUE(residency_map.pages_flag);
+  ASSERT_GT(residency_map.levels.size(), 2u);
+  EXPECT_EQ(residency_map.levels[0].nodes_cnt, 1);
+  size_t leaves_cnt = residency_map.levels.back().nodes_cnt;
+  size_t ranges_leaves_cnt = 0;
+  for (size_t i = 0; i < residency_map.ranges.size(); ++i) {
+    ranges_leaves_cnt += residency_map.ranges[i].leaves_cnt;
+    EXPECT_GT(residency_map.ranges[i].leaves_cnt, 0u);
+    EXPECT_LE(residency_map.ranges[i].resident_pages_cnt,
+              residency_map.ranges[i].pages_cnt);
+  }
+  EXPECT_EQ(ranges_leaves_cnt, leaves_cnt);
+  EXPECT_EQ(residency_map.ranges.size(), 8);
+  EXPECT_EQ(residency_map.ranges.back().last, 5000);
+  // Pages were just written, so they are in page cache.
+  EXPECT_EQ(residency_map.levels[0].resident_pages_cnt,
+            residency_map.levels[0].pages_cnt);
+  EXPECT_GT(residency_map.file_pages_cnt, 0u);
+  delete test_list;
+
+  // Unaligned address is rejected by mincore.
+  std::vector<unsigned char> pages_residency;
+  EXPECT_FALSE(GetPagesResidency(reinterpret_cast<const void*>(uintptr_t{1}),
+                                 GetFilePageSize(), pages_residency));
+  EXPECT_TRUE(pages_residency.empty());
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+TEST(structure_tests, analyze_read_only) {
+  std::string data_file_name = "structure_test_data";
+  std::string packed_file_name = "structure_test_packed_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name, false);
+  for (int i = 0; i < 3000; ++i) {
+    test_list->Insert(static_cast<size_t>(i) * 7 % (i + 1), i);
+  }
+  for (int i = 0; i < 1500; ++i) {
+    test_list->Extract(static_cast<size_t>(i) * 13 % test_list->Size());
+  }
+  delete test_list;
+  std::ifstream before_stream(data_file_name, std::ios::binary);
+  std::string before((std::istreambuf_iterator<char>(before_stream)),
+                     std::istreambuf_iterator<char>());
+
+  test_list = new BTreeList<int, 3>(data_file_name, OpenMode::READ_ONLY);
+  StructureReport report = test_list->AnalyzeStructure();
+  EXPECT_EQ(report.size, 1500);
+  EXPECT_EQ(report.height, report.levels.size());
+  size_t nodes_cnt = 0;
+  size_t elements_cnt = 0;
+  for (const LevelStructure &level: report.levels) {
+    nodes_cnt += level.nodes_cnt;
+    elements_cnt += level.elements_cnt;
+  }
+  EXPECT_EQ(nodes_cnt, report.nodes_cnt);
+  EXPECT_EQ(elements_cnt, report.size);
+  size_t histogram_nodes_cnt = 0;
+  for (size_t bucket_nodes_cnt: report.fill_histogram) {
+    histogram_nodes_cnt += bucket_nodes_cnt;
+  }
+  EXPECT_EQ(report.underfull_nodes_cnt, 0);
+  EXPECT_EQ(report.overfull_nodes_cnt, 0);
+  EXPECT_EQ(histogram_nodes_cnt, report.nodes_cnt - 1);
+  EXPECT_GT(report.blocks.free_blocks_cnt, 0u);
+  EXPECT_EQ(report.raw_blocks_cnt, 0);
+  EXPECT_EQ(report.rebuild_blocks_cnt, report.nodes_cnt);
+  EXPECT_LE(report.packed_blocks_cnt, report.rebuild_blocks_cnt);
+
+  test_list->Rebuild(packed_file_name);
+  // Changes of read-only list stay in memory.
+  (*test_list)[0] = -1;
+  EXPECT_EQ((*test_list)[0], -1);
+  delete test_list;
+  std::ifstream after_stream(data_file_name, std::ios::binary);
+  std::string after((std::istreambuf_iterator<char>(after_stream)),
+                    std::istreambuf_iterator<char>());
+  EXPECT_EQ(before, after);
+
+  test_list = new BTreeList<int, 3>(packed_file_name, OpenMode::READ_ONLY);
+  EXPECT_EQ(test_list->AnalyzeStructure().nodes_cnt, report.packed_blocks_cnt);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+  EXPECT_EQ(std::filesystem::remove(packed_file_name), true);
+}
+
+TEST(integrity_tests, verify_and_find_corruption) {
+  std::string data_file_name = "integrity_test_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name);
+  for (int i = 0; i < 4000; ++i) {
+    test_list->PushBack(i);
+  }
+  delete test_list;
+
+  test_list = new BTreeList<int, 3>(data_file_name, OpenMode::READ_ONLY);
+  IntegrityReport report = test_list->Verify(4);
+  EXPECT_TRUE(report.IsValid());
+  EXPECT_EQ(report.nodes_cnt, test_list->AnalyzeStructure().nodes_cnt);
+  EXPECT_TRUE(test_list->Verify(1).IsValid());
+  delete test_list;
+
+  // Wrong list size in data info.
+  std::fstream file(data_file_name,
+                    std::ios::in | std::ios::out | std::ios::binary);
+  size_t wrong_size = 4001;
+  file.seekp(offsetof(DataInfo, _size));
+  file.write(reinterpret_cast<const char*>(&wrong_size), sizeof(wrong_size));
+  file.flush();
+  test_list = new BTreeList<int, 3>(data_file_name, OpenMode::READ_ONLY);
+  report = test_list->Verify(4);
+  EXPECT_EQ(report.errors_cnt, 1);
+  EXPECT_EQ(report.errors_by_kind[
+      static_cast<size_t>(IntegrityErrorKind::LIST_SIZE)], 1);
+  delete test_list;
+
+  // Root, which is the first block after rebuild, gets too many elements.
+  size_t wrong_elements_cnt = 100;
+  file.seekp(static_cast<std::streamoff>(GetFilePageSize()));
+  file.write(reinterpret_cast<const char*>(&wrong_elements_cnt),
+             sizeof(wrong_elements_cnt));
+  file.close();
+  test_list = new BTreeList<int, 3>(data_file_name, OpenMode::READ_ONLY);
+  report = test_list->Verify(4);
+  EXPECT_FALSE(report.IsValid());
+  EXPECT_EQ(report.errors_by_kind[
+      static_cast<size_t>(IntegrityErrorKind::NODE_SIZE)], 1);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Large index tests                                                          //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(large_index_tests, descent_by_children_counts_above_32_bits) {
+  std::string data_file_name = "large_index_test_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name);
+  for (int i = 0; i < 6; ++i) {
+    test_list->PushBack(i);
+  }
+  delete test_list;
+
+  // Root, which is the first block after rebuild, has one element and two
+  // leaves. Left children count and list size are moved above 2^32, so
+  // elements of root and right leaf are found only with 64-bit counts.
+  constexpr size_t shift = size_t{1} << 32;
+  constexpr std::streamoff info_size = 16;
+  constexpr std::streamoff cc_offset =
+      info_size + 5 * sizeof(int) + 6 * sizeof(file_pos_t);
+  auto root_pos = static_cast<std::streamoff>(GetFilePageSize());
+  std::fstream file(data_file_name,
+                    std::ios::in | std::ios::out | std::ios::binary);
+  size_t root_elements_cnt = 0;
+  size_t left_cnt = 0;
+  file.seekg(root_pos);
+  file.read(reinterpret_cast<char*>(&root_elements_cnt),
+            sizeof(root_elements_cnt));
+  file.seekg(root_pos + cc_offset);
+  file.read(reinterpret_cast<char*>(&left_cnt), sizeof(left_cnt));
+  ASSERT_EQ(root_elements_cnt, 1u);
+  size_t size = 6 + shift;
+  size_t big_left_cnt = left_cnt + shift;
+  file.seekp(offsetof(DataInfo, _size));
+  file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file.seekp(root_pos + cc_offset);
+  file.write(reinterpret_cast<const char*>(&big_left_cnt),
+             sizeof(big_left_cnt));
+  file.close();
+
+  test_list = new BTreeList<int, 3>(data_file_name, OpenMode::READ_ONLY);
+  const BTreeList<int, 3> &read_list = *test_list;
+  EXPECT_EQ(read_list.Size(), size);
+  std::vector<size_t> indexes;
+  std::vector<int> expected;
+  for (size_t i = 0; i < left_cnt; ++i) {
+    indexes.push_back(i);
+    expected.push_back(static_cast<int>(i));
+  }
+  for (size_t i = left_cnt; i < 6; ++i) {
+    indexes.push_back(i + shift);
+    expected.push_back(static_cast<int>(i));
+  }
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    EXPECT_EQ(read_list[indexes[i]], expected[i]);
+    EXPECT_EQ((*test_list)[indexes[i]], expected[i]);
+  }
+  std::vector<int> results(indexes.size());
+  test_list->GetMany(indexes, results.begin());
+  EXPECT_EQ(results, expected);
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Aggregate tests                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(aggregate_tests, random_operations_match_brute_force) {
+  using SumList = BTreeList<int64_t, 3, NoTracePolicy,
+                            SumAggregatePolicy<int64_t>>;
+  using Operation = SumList::BatchOperation;
+  std::string data_file_name = "aggregate_test_data";
+  std::string rebuilt_file_name = "aggregate_test_rebuilt_data";
+  auto* test_list = new SumList(data_file_name, StorageBackend::FILE);
+  BTreeList<int64_t, 4, NoTracePolicy, MinAggregatePolicy<int64_t>> min_list(
+      "aggregate_min_test_data", StorageBackend::ANONYMOUS_MEMORY);
+  std::vector<int64_t> elements;
+  std::vector<int64_t> min_elements;
+  boost::minstd_rand generator(41);
+  for (int step = 0; step < 3000; ++step) {
+    int64_t value = generator() % 100;
+    size_t size = elements.size();
+    switch (size < 5 ? 0 : generator() % 8) {
+      case 0: {
+        size_t index = generator() % (size + 1);
+        test_list->Insert(index, value);
+        elements.insert(elements.begin() + index, value);
+        break;
+      }
+      case 1: {
+        size_t index = generator() % size;
+        ASSERT_EQ(test_list->Extract(index), elements[index]);
+        elements.erase(elements.begin() + index);
+        break;
+      }
+      case 2:
+        test_list->PushBack(value);
+        elements.push_back(value);
+        break;
+      case 3:
+        ASSERT_EQ(test_list->PopFront(), elements.front());
+        elements.erase(elements.begin());
+        break;
+      case 4: {
+        size_t index = generator() % size;
+        test_list->Set(index, value);
+        elements[index] = value;
+        break;
+      }
+      case 5: {
+        std::vector<size_t> indexes;
+        std::vector<int64_t> values;
+        for (size_t i = generator() % 3; i < size; i += 1 + generator() % 7) {
+          indexes.push_back(i);
+          values.push_back(generator() % 100);
+          elements[i] = values.back();
+        }
+        test_list->SetSorted(indexes, values.begin());
+        break;
+      }
+      case 6: {
+        std::vector<Operation> operations;
+        for (int i = 0; i < 10; ++i) {
+          size_t index = generator() % elements.size();
+          if (i % 2 == 0) {
+            operations.push_back(Operation{Operation::INSERT, index, value});
+            elements.insert(elements.begin() + index, value);
+          } else {
+            operations.push_back(Operation{Operation::EXTRACT, index, 0});
+            elements.erase(elements.begin() + index);
+          }
+        }
+        test_list->ApplyBatch(operations);
+        break;
+      }
+      default: {
+        size_t index = generator() % (size + 1);
+        std::vector<int64_t> values(generator() % 20, value);
+        test_list->Insert(index, values.begin(), values.end());
+        elements.insert(elements.begin() + index, values.begin(),
+                        values.end());
+      }
+    }
+    size_t min_index = generator() % (min_elements.size() + 1);
+    if (min_elements.empty() || generator() % 2 == 0) {
+      min_list.Insert(min_index, value);
+      min_elements.insert(min_elements.begin() + min_index, value);
+    } else {
+      min_index %= min_elements.size();
+      EXPECT_EQ(min_list.Extract(min_index), min_elements[min_index]);
+      min_elements.erase(min_elements.begin() + min_index);
+    }
+
+    ASSERT_EQ(test_list->Size(), elements.size());
+    size_t first = generator() % (elements.size() + 1);
+    size_t last = generator() % (elements.size() + 1);
+    if (first > last) {
+      std::swap(first, last);
+    }
+    int64_t sum = std::accumulate(elements.begin() + first,
+                                  elements.begin() + last, int64_t(0));
+    ASSERT_EQ(test_list->RangeAggregate(first, last), sum);
+    int64_t prefix_sum = 0;
+    size_t reaching_index = 0;
+    while (reaching_index < elements.size() &&
+           (prefix_sum += elements[reaching_index]) < sum) {
+      ++reaching_index;
+    }
+    ASSERT_EQ(test_list->FindPrefixReaching(sum), reaching_index);
+    first = generator() % (min_elements.size() + 1);
+    last = generator() % (min_elements.size() + 1);
+    if (first > last) {
+      std::swap(first, last);
+    }
+    int64_t min = std::numeric_limits<int64_t>::max();
+    for (size_t i = first; i < last; ++i) {
+      min = std::min(min, min_elements[i]);
+    }
+    ASSERT_EQ(min_list.RangeAggregate(first, last), min);
+  }
+
+  test_list->Rebuild(rebuilt_file_name, 0.7);
+  delete test_list;
+  test_list = new SumList(rebuilt_file_name, OpenMode::READ_WRITE);
+  for (size_t i = 0; i <= elements.size(); i += 7) {
+    EXPECT_EQ(test_list->RangeAggregate(0, i),
+              std::accumulate(elements.begin(), elements.begin() + i,
+                              int64_t(0)));
+  }
+  // Non-const operator[] is disabled, reading goes through the const one.
+  for (size_t i = 0; i < elements.size(); ++i) {
+    ASSERT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+
+  EXPECT_EQ(std::filesystem::remove(data_file_name), true);
+  EXPECT_EQ(std::filesystem::remove(rebuilt_file_name), true);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Sorted mode tests                                                          //
+////////////////////////////////////////////////////////////////////////////////
+
+TEST(sorted_tests, bounds_match_std) {
+  std::string data_file_name = "sorted_test_data";
+  auto* test_list = new BTreeList<int, 3>(data_file_name,
+                                         StorageBackend::ANONYMOUS_MEMORY);
+  BTreeList<int, 4> descending_list("sorted_descending_test_data",
+                                    StorageBackend::ANONYMOUS_MEMORY);
+  std::vector<int> elements;
+  std::vector<int> descending_elements;
+  boost::minstd_rand generator(43);
+  auto index_in = [](const std::vector<int> &v,
+                     std::vector<int>::const_iterator it) {
+    return static_cast<size_t>(it - v.begin());
+  };
+  for (int step = 0; step < 3000; ++step) {
+    int value = static_cast<int>(generator() % 300);
+    auto it = std::upper_bound(elements.begin(), elements.end(), value);
+    ASSERT_EQ(test_list->InsertSorted(value), index_in(elements, it));
+    elements.insert(it, value);
+    it = std::upper_bound(descending_elements.begin(),
+                          descending_elements.end(), value,
+                          std::greater<int>());
+    ASSERT_EQ(descending_list.InsertSorted(value, std::greater<int>()),
+              index_in(descending_elements, it));
+    descending_elements.insert(it, value);
+    if (generator() % 4 == 0) {
+      size_t index = generator() % elements.size();
+      test_list->Extract(index);
+      elements.erase(elements.begin() + index);
+    }
+
+    int key = static_cast<int>(generator() % 320) - 10;
+    auto range = std::equal_range(elements.begin(), elements.end(), key);
+    ASSERT_EQ(test_list->LowerBound(key), index_in(elements, range.first));
+    ASSERT_EQ(test_list->UpperBound(key), index_in(elements, range.second));
+    std::pair<size_t, size_t> list_range = test_list->EqualRange(key);
+    ASSERT_EQ(list_range.first, index_in(elements, range.first));
+    ASSERT_EQ(list_range.second, index_in(elements, range.second));
+    range = std::equal_range(descending_elements.begin(),
+                             descending_elements.end(), key,
+                             std::greater<int>());
+    list_range = descending_list.EqualRange(key, std::greater<int>());
+    ASSERT_EQ(list_range.first, index_in(descending_elements, range.first));
+    ASSERT_EQ(list_range.second, index_in(descending_elements, range.second));
+  }
+  for (size_t i = 0; i < elements.size(); ++i) {
+    ASSERT_EQ((*test_list)[i], elements[i]);
+  }
+  delete test_list;
+}
@@ -0,0 +1,104 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../lib/b_tree_list.hpp"
+#include "list_type_dispatch.hpp"
+
+// Checks list file after crash without rebuilding it. Exit code is 0 if file
+// is valid and 2 if errors are found.
+//
+// Usage: b_tree_list_verifier --file=PATH --element_size=N --t=N
+//                             [--threads=N] [--memory_budget=MB]
+//   --threads=N        threads checking subtrees (all cores if 0, default)
+//   --memory_budget=MB keep at most MB megabytes of file mapped (no limit
+//                      if 0, default)
+//
+// List file is opened read-only.
+
+struct VerifierParams {
+  std::string file;
+  size_t element_size = 0;
+  size_t t = 0;
+  unsigned threads = 0;
+  size_t memory_budget = 0;
+};
+
+VerifierParams ParseParams(int argc, char** argv) {
+  VerifierParams params;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq_pos = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq_pos == std::string::npos) {
+      throw std::invalid_argument("expected --key=value, got " + arg);
+    }
+    std::string key = arg.substr(2, eq_pos - 2);
+    std::string value = arg.substr(eq_pos + 1);
+    if (key == "file") {
+      params.file = value;
+    } else if (key == "element_size") {
+      params.element_size = std::stoull(value);
+    } else if (key == "t") {
+      params.t = std::stoull(value);
+    } else if (key == "threads") {
+      params.threads = std::stoul(value);
+    } else if (key == "memory_budget") {
+      params.memory_budget = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown parameter " + key);
+    }
+  }
+  if (params.file.empty() || params.element_size == 0 || params.t == 0) {
+    throw std::invalid_argument("--file, --element_size and --t are required");
+  }
+  return params;
+}
+
+void PrintReport(const IntegrityReport &report, double seconds) {
+  std::cout << "nodes\t" << report.nodes_cnt << "\nerrors\t"
+            << report.errors_cnt << "\nseconds\t" << seconds << "\n";
+  if (report.IsValid()) {
+    return;
+  }
+  std::cout << "\nkind\tcount\n";
+  for (size_t i = 0; i < integrity_error_kinds_cnt; ++i) {
+    if (report.errors_by_kind[i] != 0) {
+      std::cout << integrity_error_kind_names[i] << "\t"
+                << report.errors_by_kind[i] << "\n";
+    }
+  }
+  std::cout << "\nkind\tblock\tstored\tactual\n";
+  for (const IntegrityError &error: report.errors) {
+    std::cout << integrity_error_kind_names[static_cast<size_t>(error.kind)]
+              << "\t" << error.pos << "\t" << error.stored << "\t"
+              << error.actual << "\n";
+  }
+}
+
+int main(int argc, char** argv) {
+  VerifierParams params = ParseParams(argc, argv);
+  bool valid_flag = false;
+  bool dispatched_flag = DispatchListType(
+      params.element_size, params.t,
+      [&params, &valid_flag]<typename ListTypeT>(ListTypeT) {
+        BTreeList<typename ListTypeT::ElementType, ListTypeT::t> list(
+            params.file, OpenMode::READ_ONLY);
+        list.SetMemoryBudget(params.memory_budget << 20);
+        auto start = std::chrono::steady_clock::now();
+        IntegrityReport report = list.Verify(params.threads);
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        PrintReport(report, seconds);
+        valid_flag = report.IsValid();
+      });
+  if (!dispatched_flag) {
+    std::cerr << "unsupported list type: element size " << params.element_size
+              << ", T " << params.t << "\n";
+    return 1;
+  }
+  return valid_flag ? 0 : 2;
+}
@@ -0,0 +1,56 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#ifndef B_TREE_LIST_TOOLS__LIST_TYPE_DISPATCH_HPP_
+#define B_TREE_LIST_TOOLS__LIST_TYPE_DISPATCH_HPP_
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// List file does not store its element type, so tools take element size and
+// T from command line and instantiate list for them. Only layout of element
+// matters for tools, so element is a byte array.
+
+template <size_t Size>
+struct RawElement {
+  std::array<char, Size> bytes;
+};
+
+template <typename _ElementType, size_t _T>
+struct ListType {
+  using ElementType = _ElementType;
+  constexpr static size_t t = _T;
+};
+
+using DispatchedElementSizes = std::index_sequence<1, 2, 4, 8, 16, 32, 64,
+                                                   128, 256>;
+using DispatchedTs = std::index_sequence<3, 64, 200>;
+
+template <size_t T, typename Function, size_t... ElementSizes>
+bool DispatchElementSize(size_t element_size,
+                         Function &function,
+                         std::index_sequence<ElementSizes...>) {
+  return ((element_size == ElementSizes &&
+           (function(ListType<RawElement<ElementSizes>, T>{}), true)) || ...);
+}
+
+template <typename Function, size_t... Ts>
+bool DispatchT(size_t element_size,
+               size_t t,
+               Function &function,
+               std::index_sequence<Ts...>) {
+  return ((t == Ts && DispatchElementSize<Ts>(element_size, function,
+                                              DispatchedElementSizes{})) ||
+          ...);
+}
+
+// Calls function(ListType<RawElement<element_size>, t>{}). Returns false if
+// this list type is not instantiated.
+template <typename Function>
+bool DispatchListType(size_t element_size, size_t t, Function function) {
+  return DispatchT(element_size, t, function, DispatchedTs{});
+}
+
+#endif //B_TREE_LIST_TOOLS__LIST_TYPE_DISPATCH_HPP_
@@ -0,0 +1,136 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../lib/b_tree_list.hpp"
+#include "list_type_dispatch.hpp"
+
+// Shows which tree levels and index ranges of list file are in page cache
+// and how file is laid out on disk.
+//
+// Usage: b_tree_list_residency --file=PATH --element_size=N --t=N
+//                              [--ranges=N] [--extents=1]
+//   --ranges=N   number of equal index ranges of leaves (16)
+//   --extents=1  print every file extent, not only their count
+//
+// List file is opened read-only.
+
+struct ResidencyParams {
+  std::string file;
+  size_t element_size = 0;
+  size_t t = 0;
+  size_t ranges = 16;
+  bool extents_flag = false;
+};
+
+ResidencyParams ParseParams(int argc, char** argv) {
+  ResidencyParams params;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq_pos = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq_pos == std::string::npos) {
+      throw std::invalid_argument("expected --key=value, got " + arg);
+    }
+    std::string key = arg.substr(2, eq_pos - 2);
+    std::string value = arg.substr(eq_pos + 1);
+    if (key == "file") {
+      params.file = value;
+    } else if (key == "element_size") {
+      params.element_size = std::stoull(value);
+    } else if (key == "t") {
+      params.t = std::stoull(value);
+    } else if (key == "ranges") {
+      params.ranges = std::stoull(value);
+    } else if (key == "extents") {
+      params.extents_flag = value != "0";
+    } else {
+      throw std::invalid_argument("unknown parameter " + key);
+    }
+  }
+  if (params.file.empty() || params.element_size == 0 || params.t == 0) {
+    throw std::invalid_argument("--file, --element_size and --t are required");
+  }
+  return params;
+}
+
+double Percent(size_t part, size_t whole) {
+  return whole == 0 ? 0. : 100. * static_cast<double>(part) /
+                           static_cast<double>(whole);
+}
+
+void PrintResidency(const ResidencyMap &residency_map,
+                    const ResidencyParams &params) {
+  std::cout << "level\tnodes\tpages\tresident_pages\tresident_percent\n";
+  for (size_t i = 0; i < residency_map.levels.size(); ++i) {
+    const LevelResidency &level = residency_map.levels[i];
+    std::cout << i << "\t" << level.nodes_cnt << "\t" << level.pages_cnt
+              << "\t" << level.resident_pages_cnt
+              << "\t" << Percent(level.resident_pages_cnt, level.pages_cnt)
+              << "\n";
+  }
+
+  std::cout << "\nfirst\tlast\tleaves\tpages\tresident_pages"
+               "\tresident_percent\n";
+  for (const RangeResidency &range: residency_map.ranges) {
+    std::cout << range.first << "\t" << range.last << "\t" << range.leaves_cnt
+              << "\t" << range.pages_cnt << "\t" << range.resident_pages_cnt
+              << "\t" << Percent(range.resident_pages_cnt, range.pages_cnt)
+              << "\n";
+  }
+
+  std::cout << "\nfile_pages\t" << residency_map.file_pages_cnt
+            << "\nfile_resident_pages\t"
+            << residency_map.file_resident_pages_cnt << "\n";
+  if (!residency_map.extents_flag) {
+    std::cout << "extents\tunsupported\n";
+    return;
+  }
+  // Extent continues the previous one on disk if it starts where it ends.
+  size_t discontinuities_cnt = 0;
+  for (size_t i = 1; i < residency_map.extents.size(); ++i) {
+    const FileExtent &prev = residency_map.extents[i - 1];
+    if (prev.physical_offset + prev.length !=
+        residency_map.extents[i].physical_offset) {
+      ++discontinuities_cnt;
+    }
+  }
+  std::cout << "extents\t" << residency_map.extents.size()
+            << "\ndiscontinuities\t" << discontinuities_cnt << "\n";
+  if (params.extents_flag) {
+    std::cout << "\nlogical\tphysical\tlength\tflags\n";
+    for (const FileExtent &extent: residency_map.extents) {
+      std::cout << extent.logical_offset << "\t" << extent.physical_offset
+                << "\t" << extent.length << "\t0x" << std::hex << extent.flags
+                << std::dec << "\n";
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  ResidencyParams params = ParseParams(argc, argv);
+  bool pages_flag = false;
+  bool dispatched_flag = DispatchListType(
+      params.element_size, params.t,
+      [&params, &pages_flag]<typename ListTypeT>(ListTypeT) {
+        BTreeList<typename ListTypeT::ElementType, ListTypeT::t> list(
+            params.file, OpenMode::READ_ONLY);
+        ResidencyMap residency_map = list.Residency(params.ranges);
+        pages_flag = residency_map.pages_flag;
+        if (pages_flag) {
+          PrintResidency(residency_map, params);
+        }
+      });
+  if (!dispatched_flag) {
+    std::cerr << "unsupported list type: element size " << params.element_size
+              << ", T " << params.t << "\n";
+    return 1;
+  }
+  if (!pages_flag) {
+    std::cerr << "can not take page residency (mincore failed)\n";
+    return 1;
+  }
+  return 0;
+}
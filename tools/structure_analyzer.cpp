@@ -0,0 +1,122 @@
+//
+// Created by gogagum on 19.10.2026.
+//
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include "../lib/b_tree_list.hpp"
+#include "list_type_dispatch.hpp"
+
+// Shows height, node fill and fragmentation of list file, so it can be
+// decided if the file is worth compacting.
+//
+// Usage: b_tree_list_analyzer --file=PATH --element_size=N --t=N
+//
+// List file is opened read-only.
+
+struct AnalyzerParams {
+  std::string file;
+  size_t element_size = 0;
+  size_t t = 0;
+};
+
+AnalyzerParams ParseParams(int argc, char** argv) {
+  AnalyzerParams params;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    size_t eq_pos = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq_pos == std::string::npos) {
+      throw std::invalid_argument("expected --key=value, got " + arg);
+    }
+    std::string key = arg.substr(2, eq_pos - 2);
+    std::string value = arg.substr(eq_pos + 1);
+    if (key == "file") {
+      params.file = value;
+    } else if (key == "element_size") {
+      params.element_size = std::stoull(value);
+    } else if (key == "t") {
+      params.t = std::stoull(value);
+    } else {
+      throw std::invalid_argument("unknown parameter " + key);
+    }
+  }
+  if (params.file.empty() || params.element_size == 0 || params.t == 0) {
+    throw std::invalid_argument("--file, --element_size and --t are required");
+  }
+  return params;
+}
+
+double Percent(size_t part, size_t whole) {
+  return whole == 0 ? 0. : 100. * static_cast<double>(part) /
+                           static_cast<double>(whole);
+}
+
+void PrintReport(const StructureReport &report, size_t t) {
+  std::cout << "size\t" << report.size << "\nheight\t" << report.height
+            << "\n\nlevel\tnodes\telements\n";
+  for (size_t i = 0; i < report.levels.size(); ++i) {
+    std::cout << i << "\t" << report.levels[i].nodes_cnt << "\t"
+              << report.levels[i].elements_cnt << "\n";
+  }
+
+  // Bucket bounds in elements, as in StructureReport::fill_histogram.
+  std::cout << "\nfill_from\tfill_to\tnodes\n";
+  std::cout << "0\t" << t - 2 << "\t" << report.underfull_nodes_cnt << "\n";
+  for (size_t i = 0; i < fill_buckets_cnt; ++i) {
+    size_t from = t - 1 + (i * t + fill_buckets_cnt - 1) / fill_buckets_cnt;
+    size_t to = t - 1 + ((i + 1) * t + fill_buckets_cnt - 1) /
+                        fill_buckets_cnt;
+    if (from == to) {
+      continue;
+    }
+    std::cout << from << "\t" << to - 1 << "\t" << report.fill_histogram[i]
+              << "\n";
+  }
+  std::cout << 2 * t - 1 << "\t-\t" << report.overfull_nodes_cnt << "\n"
+            << "average_fill_percent\t" << 100. * report.average_fill << "\n";
+
+  const BlocksUsage &blocks = report.blocks;
+  std::cout << "\nblock_size\t" << blocks.block_size
+            << "\nfile_size\t" << blocks.file_size
+            << "\nblocks\t" << blocks.blocks_cnt
+            << "\nnode_blocks\t" << report.nodes_cnt
+            << "\nraw_blocks\t" << report.raw_blocks_cnt
+            << "\nfree_blocks\t" << blocks.free_blocks_cnt
+            << "\nfree_runs\t" << blocks.free_runs_cnt
+            << "\nlargest_free_run\t" << blocks.largest_free_run
+            << "\ntail_blocks\t" << report.tail_blocks_cnt
+            << "\naverage_parent_child_distance\t"
+            << report.average_parent_child_distance << "\n";
+
+  std::cout << "\nrebuild_blocks\t" << report.rebuild_blocks_cnt
+            << "\nrebuild_file_size\t" << report.rebuild_file_size
+            << "\nrebuild_saved_percent\t"
+            << Percent(blocks.file_size - std::min(blocks.file_size,
+                                                   report.rebuild_file_size),
+                       blocks.file_size)
+            << "\npacked_blocks\t" << report.packed_blocks_cnt
+            << "\npacked_file_size\t" << report.packed_file_size
+            << "\npacked_saved_percent\t"
+            << Percent(blocks.file_size - std::min(blocks.file_size,
+                                                   report.packed_file_size),
+                       blocks.file_size)
+            << "\n";
+}
+
+int main(int argc, char** argv) {
+  AnalyzerParams params = ParseParams(argc, argv);
+  bool dispatched_flag = DispatchListType(
+      params.element_size, params.t,
+      [&params]<typename ListTypeT>(ListTypeT) {
+        BTreeList<typename ListTypeT::ElementType, ListTypeT::t> list(
+            params.file, OpenMode::READ_ONLY);
+        PrintReport(list.AnalyzeStructure(), ListTypeT::t);
+      });
+  if (!dispatched_flag) {
+    std::cerr << "unsupported list type: element size " << params.element_size
+              << ", T " << params.t << "\n";
+    return 1;
+  }
+  return 0;
+}